@@ -0,0 +1,73 @@
+#pragma once
+
+#include "duktape.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// A Duktape heap allocator that keeps track of how many bytes are currently allocated,
+// so benchmarks can report memory use per object.
+struct BenchAllocStats {
+	BenchAllocStats() : live_bytes(0), allocs(0) {}
+
+	size_t live_bytes;
+	size_t allocs;
+};
+
+namespace bench_alloc_detail {
+	union Header {
+		size_t size;
+		double align_;
+	};
+
+	inline void* alloc(void* udata, duk_size_t size) {
+		if (size == 0)
+			return NULL;
+
+		Header* h = (Header*) malloc(sizeof(Header) + size);
+		if (h == NULL)
+			return NULL;
+
+		h->size = size;
+		BenchAllocStats* stats = (BenchAllocStats*) udata;
+		stats->live_bytes += size;
+		stats->allocs++;
+		return h + 1;
+	}
+
+	inline void free_(void* udata, void* ptr) {
+		if (ptr == NULL)
+			return;
+
+		Header* h = ((Header*) ptr) - 1;
+		BenchAllocStats* stats = (BenchAllocStats*) udata;
+		stats->live_bytes -= h->size;
+		free(h);
+	}
+
+	inline void* realloc_(void* udata, void* ptr, duk_size_t size) {
+		if (ptr == NULL)
+			return alloc(udata, size);
+		if (size == 0) {
+			free_(udata, ptr);
+			return NULL;
+		}
+
+		Header* h = ((Header*) ptr) - 1;
+		size_t old_size = h->size;
+		Header* new_h = (Header*) realloc(h, sizeof(Header) + size);
+		if (new_h == NULL)
+			return NULL;
+
+		BenchAllocStats* stats = (BenchAllocStats*) udata;
+		stats->live_bytes = stats->live_bytes - old_size + size;
+		stats->allocs++;
+		new_h->size = size;
+		return new_h + 1;
+	}
+}
+
+inline duk_context* bench_create_counted_heap(BenchAllocStats* stats)
+{
+	return duk_create_heap(bench_alloc_detail::alloc, bench_alloc_detail::realloc_, bench_alloc_detail::free_, stats, NULL);
+}
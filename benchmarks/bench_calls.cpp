@@ -0,0 +1,50 @@
+#include "bench_util.h"
+#include <dukglue/dukglue.h>
+
+// Calls script functions from C++.
+void bench_calls()
+{
+	const size_t N = 1000000;
+	duk_context* ctx = duk_create_heap_default();
+
+	bench_eval(ctx, "function tick() {}");
+	bench_eval(ctx, "function onHit(damage, weapon) { return damage * 2 + weapon.length; }");
+
+	// (the DukValues must be released before the heap is destroyed)
+	{
+		duk_get_global_string(ctx, "tick");
+		DukValue tick = DukValue::take_from_stack(ctx);
+		duk_get_global_string(ctx, "onHit");
+		DukValue on_hit = DukValue::take_from_stack(ctx);
+
+		const std::string weapon = "sword";
+
+		bench_run("tick() dukglue_pcall", N, [&]() {
+			for (size_t i = 0; i < N; i++)
+				dukglue_pcall<void>(ctx, tick);
+		});
+
+		dukglue::PreparedCall<void()> prepared_tick(ctx, tick);
+		bench_run("tick() PreparedCall", N, [&]() {
+			for (size_t i = 0; i < N; i++)
+				prepared_tick();
+		});
+
+		int sum = 0;
+		bench_run("onHit(int, std::string) dukglue_pcall", N, [&]() {
+			for (size_t i = 0; i < N; i++)
+				sum += dukglue_pcall<int>(ctx, on_hit, static_cast<int>(i & 0xFF), weapon);
+		});
+
+		dukglue::PreparedCall<int(int, const std::string&)> prepared_on_hit(ctx, on_hit);
+		bench_run("onHit(int, std::string) PreparedCall", N, [&]() {
+			for (size_t i = 0; i < N; i++)
+				sum += prepared_on_hit(static_cast<int>(i & 0xFF), weapon);
+		});
+
+		if (sum == 42)
+			std::cout << "";  // keep sum alive
+	}
+
+	duk_destroy_heap(ctx);
+}
@@ -0,0 +1,70 @@
+#include "bench_util.h"
+#include <dukglue/dukglue.h>
+
+#include <string.h>
+
+static int add_one(int a) {
+	return a + 1;
+}
+
+static void do_nothing() {
+}
+
+static int add_two(int a, int b) {
+	return a + b;
+}
+
+static int length_of(const char* str) {
+	return (int) strlen(str);
+}
+
+static bool negate(bool b) {
+	return !b;
+}
+
+// what an overload set looks like written by hand
+static duk_ret_t add_shim(duk_context* ctx) {
+	const duk_idx_t nargs = duk_get_top(ctx);
+	if (nargs == 1 && duk_is_boolean(ctx, 0))
+		duk_push_boolean(ctx, !duk_get_boolean(ctx, 0));
+	else if (nargs == 1 && duk_is_string(ctx, 0))
+		duk_push_int(ctx, (int) strlen(duk_get_string(ctx, 0)));
+	else if (nargs == 1 && duk_is_number(ctx, 0))
+		duk_push_int(ctx, duk_get_int(ctx, 0) + 1);
+	else if (nargs == 2 && duk_is_number(ctx, 0) && duk_is_number(ctx, 1))
+		duk_push_int(ctx, duk_get_int(ctx, 0) + duk_get_int(ctx, 1));
+	else
+		return DUK_RET_TYPE_ERROR;
+	return 1;
+}
+
+void bench_functions()
+{
+	const size_t N = 5000000;
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_function(ctx, add_one, "add_one_runtime");
+	dukglue_register_function_magic(ctx, add_one, "add_one_magic");
+	dukglue_register_function_compiletime<decltype(add_one), add_one>(ctx, add_one, "add_one_compiletime");
+
+	dukglue_register_function(ctx, do_nothing, "do_nothing_runtime");
+	dukglue_register_function_magic(ctx, do_nothing, "do_nothing_magic");
+	dukglue_register_function_compiletime<decltype(do_nothing), do_nothing>(ctx, do_nothing, "do_nothing_compiletime");
+
+	// the number / number candidate is last, so both are the worst case
+	dukglue_register_function(ctx, dukglue::overloads(&negate, &length_of, &add_one, &add_two), "add_overloaded");
+	duk_push_c_function(ctx, add_shim, DUK_VARARGS);
+	duk_put_global_string(ctx, "add_shim");
+
+	bench_script_loop(ctx, "empty script loop (baseline)", N, "");
+	bench_script_loop(ctx, "do_nothing() runtime (property lookup)", N, "do_nothing_runtime()");
+	bench_script_loop(ctx, "do_nothing() magic", N, "do_nothing_magic()");
+	bench_script_loop(ctx, "do_nothing() compiletime", N, "do_nothing_compiletime()");
+	bench_script_loop(ctx, "add_one(i) runtime (property lookup)", N, "add_one_runtime(i)");
+	bench_script_loop(ctx, "add_one(i) magic", N, "add_one_magic(i)");
+	bench_script_loop(ctx, "add_one(i) compiletime", N, "add_one_compiletime(i)");
+	bench_script_loop(ctx, "add(i, 1) overloaded (4th of 4 candidates)", N, "add_overloaded(i, 1)");
+	bench_script_loop(ctx, "add(i, 1) hand-written varargs shim", N, "add_shim(i, 1)");
+
+	duk_destroy_heap(ctx);
+}
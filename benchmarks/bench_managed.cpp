@@ -0,0 +1,78 @@
+#include "bench_util.h"
+#include "bench_alloc.h"
+#include <dukglue/dukglue.h>
+
+#include <vector>
+
+namespace {
+
+class Color {
+public:
+	Color(float r, float g, float b) : r_(r), g_(g), b_(b) {}
+
+	float sum() const { return r_ + g_ + b_; }
+
+private:
+	float r_, g_, b_;
+};
+
+template <typename Allocator>
+void bench_churn(const char* name, size_t count)
+{
+	BenchAllocStats stats;
+	duk_context* ctx = bench_create_counted_heap(&stats);
+	dukglue_register_constructor_managed<Color, float, float, float>(ctx, "Color", Allocator());
+	dukglue_register_method(ctx, &Color::sum, "sum");
+
+	const std::string label = std::string(name) + ": new Color() x 10M";
+	bench_script_loop(ctx, label.c_str(), count, "new Color(i, 1, 2)");
+
+	// Duktape allocations per object (HeapAllocator and PoolAllocator objects live outside the Duktape heap)
+	const size_t N = 100000;
+	bench_eval(ctx, "var colors = new Array(" + std::to_string(N) + "); colors[0] = new Color(0, 1, 2);");
+	duk_gc(ctx, 0);
+	const size_t allocs_before = stats.allocs;
+	bench_eval(ctx, "for (var i = 1; i < " + std::to_string(N) + "; i++) { colors[i] = new Color(i, 1, 2); }");
+	std::cout << "    Duktape allocations per object: " << (double) (stats.allocs - allocs_before) / (N - 1) << std::endl;
+
+	bench_script_loop(ctx, (std::string(name) + ": colors[i % 100k].sum() x 10M").c_str(), count,
+		("colors[i % " + std::to_string(N) + "].sum()").c_str());
+
+	duk_destroy_heap(ctx);
+}
+
+
+// Just the allocator policies, without the script side
+template <typename Allocator>
+void bench_policy(const char* name, size_t count)
+{
+	duk_context* ctx = duk_create_heap_default();
+	std::vector<Color*> objs(64);
+	std::vector<void*> owners(64);
+	void* data = Allocator::prepare(ctx);
+
+	bench_run(name, count, [&]() {
+		for (size_t i = 0; i < count; i += objs.size()) {
+			for (size_t j = 0; j < objs.size(); j++)
+				objs[j] = Allocator::template create<Color>(data, &owners[j], float(i), 1.0f, 2.0f);
+			for (size_t j = 0; j < objs.size(); j++)
+				Allocator::destroy(objs[j], owners[j]);
+		}
+	});
+
+	duk_destroy_heap(ctx);
+}
+
+}
+
+// Creating and dropping managed objects from script (each one is finalized right away)
+void bench_managed()
+{
+	const size_t count = 10000000;
+	bench_churn<dukglue::HeapAllocator>("HeapAllocator", count);
+	bench_churn<dukglue::PoolAllocator>("PoolAllocator", count);
+	bench_churn<dukglue::InlineStorage>("InlineStorage", count);
+
+	bench_policy<dukglue::HeapAllocator>("create + destroy x 10M, HeapAllocator", count);
+	bench_policy<dukglue::PoolAllocator>("create + destroy x 10M, PoolAllocator", count);
+}
@@ -0,0 +1,56 @@
+#include "bench_util.h"
+#include <dukglue/dukglue.h>
+
+namespace {
+
+class Counter {
+public:
+	Counter() : value_(0) {}
+
+	void inc() {
+		value_++;
+	}
+
+	int add(int a) {
+		value_ += a;
+		return value_;
+	}
+
+	duk_ret_t addAll(duk_context* ctx) {
+		for (duk_idx_t i = 0; i < duk_get_top(ctx); i++)
+			value_ += duk_get_int(ctx, i);
+		return 0;
+	}
+
+private:
+	int value_;
+};
+
+}
+
+void bench_methods()
+{
+	const size_t N = 5000000;
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_constructor<Counter>(ctx, "Counter");
+	dukglue_register_method(ctx, &Counter::inc, "incRuntime");
+	dukglue_register_method_magic(ctx, &Counter::inc, "incMagic");
+	dukglue_register_method_compiletime<decltype(&Counter::inc), &Counter::inc>(ctx, &Counter::inc, "incCompiletime");
+	dukglue_register_method(ctx, &Counter::add, "addRuntime");
+	dukglue_register_method_magic(ctx, &Counter::add, "addMagic");
+	dukglue_register_method_varargs(ctx, &Counter::addAll, "addAllRuntime");
+	dukglue_register_method_varargs_magic(ctx, &Counter::addAll, "addAllMagic");
+
+	bench_eval(ctx, "var counter = new Counter();");
+
+	bench_script_loop(ctx, "counter.inc() runtime (method_holder)", N, "counter.incRuntime()");
+	bench_script_loop(ctx, "counter.inc() magic", N, "counter.incMagic()");
+	bench_script_loop(ctx, "counter.inc() compiletime", N, "counter.incCompiletime()");
+	bench_script_loop(ctx, "counter.add(1) runtime (method_holder)", N, "counter.addRuntime(1)");
+	bench_script_loop(ctx, "counter.add(1) magic", N, "counter.addMagic(1)");
+	bench_script_loop(ctx, "counter.addAll(1, 2) varargs runtime", N, "counter.addAllRuntime(1, 2)");
+	bench_script_loop(ctx, "counter.addAll(1, 2) varargs magic", N, "counter.addAllMagic(1, 2)");
+
+	duk_destroy_heap(ctx);
+}
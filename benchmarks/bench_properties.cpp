@@ -0,0 +1,122 @@
+#include "bench_util.h"
+#include "bench_alloc.h"
+#include <dukglue/dukglue.h>
+
+namespace {
+
+class Particle {
+public:
+	Particle() : x(0), y(0) {}
+
+	float getX() const {
+		return x;
+	}
+	void setX(float v) {
+		x = v;
+	}
+
+	float x;
+	float y;
+};
+
+// 100 properties, each with its own getter and setter (get<0>, set<0>, get<1>, ...)
+class Wide {
+public:
+	Wide() {
+		for (int i = 0; i < 100; i++)
+			values[i] = i;
+	}
+
+	template <int N>
+	int get() const {
+		return values[N];
+	}
+
+	template <int N>
+	void set(int v) {
+		values[N] = v;
+	}
+
+	int values[100];
+};
+
+template <int N>
+struct RegisterWide {
+	static void run(duk_context* ctx, bool shared) {
+		const std::string name = "p" + std::to_string(N);
+		if (shared)
+			dukglue_register_property_shared(ctx, &Wide::get<N>, &Wide::set<N>, name.c_str());
+		else
+			dukglue_register_property(ctx, &Wide::get<N>, &Wide::set<N>, name.c_str());
+		RegisterWide<N - 1>::run(ctx, shared);
+	}
+};
+
+template <>
+struct RegisterWide<-1> {
+	static void run(duk_context* ctx, bool shared) {}
+};
+
+// Duktape heap bytes used by registering Wide's 100 properties.
+// Regular properties also allocate a MethodHolder per accessor with new,
+// which the counted heap doesn't see, so that is added separately.
+void report_wide_memory(bool shared)
+{
+	BenchAllocStats stats;
+	duk_context* ctx = bench_create_counted_heap(&stats);
+
+	// create the prototype (and dukglue's per-context state) first
+	dukglue_register_constructor<Wide>(ctx, "Wide");
+	duk_gc(ctx, 0);
+
+	const size_t before = stats.live_bytes;
+	RegisterWide<99>::run(ctx, shared);
+	duk_gc(ctx, 0);
+	const size_t heap_bytes = stats.live_bytes - before;
+
+	typedef dukglue::detail::MethodInfo<true, Wide, int>::MethodHolder GetterHolder;
+	typedef dukglue::detail::MethodInfo<false, Wide, void, int>::MethodHolder SetterHolder;
+	const size_t native_bytes = shared ? 0 : 100 * (sizeof(GetterHolder) + sizeof(SetterHolder));
+
+	std::cout << "  " << std::left << std::setw(48) << (shared ? "100 properties, shared accessors" : "100 properties, regular")
+		<< std::right << std::setw(10) << heap_bytes << " heap bytes"
+		<< std::setw(8) << native_bytes << " native bytes ("
+		<< std::setprecision(1) << std::fixed << (double) (heap_bytes + native_bytes) / 100 << " per property)" << std::endl;
+
+	bench_eval(ctx, "var wide = new Wide(); var sum = 0; for (var i = 0; i < 100; i++) sum += wide['p' + i];");
+	duk_destroy_heap(ctx);
+}
+
+}
+
+void bench_properties()
+{
+	const size_t N = 5000000;
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_constructor<Particle>(ctx, "Particle");
+	dukglue_register_property(ctx, &Particle::getX, &Particle::setX, "xProperty");
+	dukglue_register_property_shared(ctx, &Particle::getX, &Particle::setX, "xShared");
+	dukglue_register_field(ctx, &Particle::x, "xField");
+	dukglue_register_field_compiletime<decltype(&Particle::x), &Particle::x>(ctx, "xFieldCompiletime");
+
+	Particle particle;
+	dukglue_register_global(ctx, &particle, "p");
+	bench_eval(ctx, "var plain = { x: 0 }; var sum = 0;");
+
+	bench_script_loop(ctx, "read plain.x (script object, baseline)", N, "sum += plain.x");
+	bench_script_loop(ctx, "read p.x getter/setter property", N, "sum += p.xProperty");
+	bench_script_loop(ctx, "read p.x shared getter/setter property", N, "sum += p.xShared");
+	bench_script_loop(ctx, "read p.x field", N, "sum += p.xField");
+	bench_script_loop(ctx, "read p.x field compiletime", N, "sum += p.xFieldCompiletime");
+	bench_script_loop(ctx, "write p.x getter/setter property", N, "p.xProperty = i");
+	bench_script_loop(ctx, "write p.x shared getter/setter property", N, "p.xShared = i");
+	bench_script_loop(ctx, "write p.x field", N, "p.xField = i");
+	bench_script_loop(ctx, "write p.x field compiletime", N, "p.xFieldCompiletime = i");
+
+	dukglue_invalidate_object(ctx, &particle);
+	duk_destroy_heap(ctx);
+
+	report_wide_memory(false);
+	report_wide_memory(true);
+}
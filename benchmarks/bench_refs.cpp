@@ -0,0 +1,133 @@
+#include "bench_util.h"
+#include <dukglue/dukglue.h>
+
+#include <vector>
+
+namespace {
+
+class Plain {
+public:
+	int value;
+};
+
+class Hooked : public DukRefHook {
+public:
+	int value;
+};
+
+template <typename T>
+void bench_refs_at(const char* label, size_t n)
+{
+	std::vector<T> objs(n);
+	duk_context* ctx = duk_create_heap_default();
+
+	std::string prefix = std::string(label) + " x " + std::to_string(n) + ": ";
+
+	bench_run((prefix + "register").c_str(), n, [&]() {
+		for (size_t i = 0; i < n; i++) {
+			dukglue_push(ctx, &objs[i]);
+			duk_pop(ctx);
+		}
+	});
+
+	bench_run((prefix + "find_and_push").c_str(), n, [&]() {
+		for (size_t i = 0; i < n; i++) {
+			dukglue_push(ctx, &objs[i]);
+			duk_pop(ctx);
+		}
+	});
+
+	bench_run((prefix + "invalidate").c_str(), n, [&]() {
+		for (size_t i = 0; i < n; i++)
+			dukglue_invalidate_object(ctx, &objs[i]);
+	});
+
+	duk_destroy_heap(ctx);
+}
+
+
+// n objects that are each pushed once and then dropped by script,
+// with and without dukglue_set_weak_refs
+void bench_transient_at(bool weak, size_t n)
+{
+	std::vector<Plain> objs(n);
+	duk_context* ctx = duk_create_heap_default();
+	if (weak)
+		dukglue_set_weak_refs<Plain>(ctx);
+
+	std::string name = std::string(weak ? "weak" : "strong") + " transient x " + std::to_string(n) + ": push";
+	bench_run(name.c_str(), n, [&]() {
+		for (size_t i = 0; i < n; i++) {
+			dukglue_push(ctx, &objs[i]);
+			duk_pop(ctx);
+		}
+		duk_gc(ctx, 0);
+	});
+
+	std::cout << "    registered objects left: " << dukglue::detail::ContextState::get(ctx)->refs.size() << std::endl;
+	duk_destroy_heap(ctx);
+}
+
+
+// Invalidating n objects one at a time vs. with the bulk invalidation functions
+void bench_bulk_invalidate_at(size_t n)
+{
+	std::vector<Plain> objs(n);
+	duk_context* ctx = duk_create_heap_default();
+
+	auto push_all = [&]() {
+		for (size_t i = 0; i < n; i++) {
+			dukglue_push(ctx, &objs[i]);
+			duk_pop(ctx);
+		}
+	};
+
+	const std::string prefix = "invalidate x " + std::to_string(n) + ": ";
+
+	push_all();
+	bench_run((prefix + "per object").c_str(), n, [&]() {
+		for (size_t i = 0; i < n; i++)
+			dukglue_invalidate_object(ctx, &objs[i]);
+	});
+
+	push_all();
+	bench_run((prefix + "dukglue_invalidate_objects").c_str(), n, [&]() {
+		dukglue_invalidate_objects(ctx, objs.data(), n);
+	});
+
+	push_all();
+	bench_run((prefix + "dukglue_invalidate_class").c_str(), n, [&]() {
+		dukglue_invalidate_class<Plain>(ctx);
+	});
+
+	dukglue_set_epoch(ctx, 1);
+	push_all();
+	bench_run((prefix + "dukglue_invalidate_epoch").c_str(), n, [&]() {
+		dukglue_invalidate_epoch(ctx, 1);
+	});
+
+	duk_destroy_heap(ctx);
+}
+
+}
+
+// Native object registry at different numbers of live objects.
+void bench_refs()
+{
+	bench_refs_at<Plain>("plain", 10000);
+	bench_refs_at<Hooked>("hooked", 10000);
+	bench_refs_at<Plain>("plain", 1000000);
+	bench_refs_at<Hooked>("hooked", 1000000);
+
+	bench_transient_at(false, 1000000);
+	bench_transient_at(true, 1000000);
+
+	bench_bulk_invalidate_at(500000);
+}
+
+// Same as bench_refs, with 10M live objects (needs a few GB of memory).
+void bench_refs_10m()
+{
+	bench_refs_at<Plain>("plain", 10000000);
+	bench_refs_at<Hooked>("hooked", 10000000);
+}
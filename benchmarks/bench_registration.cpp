@@ -0,0 +1,80 @@
+#include "bench_util.h"
+#include <dukglue/dukglue.h>
+
+#include <typeindex>
+#include <vector>
+
+namespace {
+
+// 10,000 distinct synthetic classes, Synthetic<0> ... Synthetic<9999>
+// (collected in blocks of 100 to keep the template recursion shallow).
+// Only their type_index is needed - registering anything on a class
+// (a method, a constructor, a property) starts by creating its prototype.
+template <int N>
+class Synthetic {};
+
+template <int Block, int I>
+struct CollectBlock {
+	static void run(std::vector<std::type_index>& out) {
+		out.push_back(typeid(Synthetic<Block * 100 + I>));
+		CollectBlock<Block, I - 1>::run(out);
+	}
+};
+
+template <int Block>
+struct CollectBlock<Block, -1> {
+	static void run(std::vector<std::type_index>& out) {}
+};
+
+template <int Block>
+struct CollectTypes {
+	static void run(std::vector<std::type_index>& out) {
+		CollectBlock<Block, 99>::run(out);
+		CollectTypes<Block - 1>::run(out);
+	}
+};
+
+template <>
+struct CollectTypes<-1> {
+	static void run(std::vector<std::type_index>& out) {}
+};
+
+void register_all(duk_context* ctx, const std::vector<std::type_index>& types, size_t count)
+{
+	using namespace dukglue::detail;
+
+	for (size_t i = 0; i < count; i++) {
+		ProtoManager::push_prototype(ctx, types[i]);
+		duk_pop(ctx);
+	}
+}
+
+}
+
+// Context startup cost with a large class catalog.
+void bench_registration()
+{
+	std::vector<std::type_index> types;
+	CollectTypes<99>::run(types);
+
+	// The time per class should stay flat as the catalog grows (nothing per type may scale with
+	// the number of types). Smallest first: type ids are handed out in order of first use.
+	const size_t counts[] = { 1000, 2500, 5000, 10000 };
+	for (size_t count : counts) {
+		duk_context* heap = duk_create_heap_default();
+		bench_run(("register " + std::to_string(count) + " classes").c_str(), count, [&]() {
+			register_all(heap, types, count);
+		});
+		duk_destroy_heap(heap);
+	}
+
+	duk_context* ctx = duk_create_heap_default();
+	register_all(ctx, types, types.size());
+
+	// registering more things on a class only needs to find its prototype
+	bench_run("find 10k registered classes", types.size(), [&]() {
+		register_all(ctx, types, types.size());
+	});
+
+	duk_destroy_heap(ctx);
+}
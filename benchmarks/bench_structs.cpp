@@ -0,0 +1,161 @@
+#include "bench_util.h"
+#include <dukglue/dukglue.h>
+
+namespace {
+
+struct Vec3 {
+	float x, y, z;
+};
+
+// the same struct, converted by hand with duk_get/put_prop_string
+struct Vec3Manual {
+	float x, y, z;
+};
+
+struct Particle {
+	float position_x, position_y, velocity_x, velocity_y;
+	float lifetime, size, rotation, opacity;
+};
+
+struct ParticleManual {
+	float position_x, position_y, velocity_x, velocity_y;
+	float lifetime, size, rotation, opacity;
+};
+
+}
+
+DUKGLUE_STRUCT(Vec3, x, y, z)
+DUKGLUE_STRUCT(Particle, position_x, position_y, velocity_x, velocity_y, lifetime, size, rotation, opacity)
+
+namespace dukglue {
+	namespace types {
+		template<>
+		struct DukType<Vec3Manual> {
+			typedef std::true_type IsValueType;
+
+			template<typename FullT>
+			static Vec3Manual read(duk_context* ctx, duk_idx_t arg_idx) {
+				arg_idx = duk_normalize_index(ctx, arg_idx);
+				Vec3Manual v;
+				duk_get_prop_string(ctx, arg_idx, "x");
+				v.x = static_cast<float>(duk_require_number(ctx, -1));
+				duk_get_prop_string(ctx, arg_idx, "y");
+				v.y = static_cast<float>(duk_require_number(ctx, -1));
+				duk_get_prop_string(ctx, arg_idx, "z");
+				v.z = static_cast<float>(duk_require_number(ctx, -1));
+				duk_pop_3(ctx);
+				return v;
+			}
+
+			template<typename FullT>
+			static void push(duk_context* ctx, const Vec3Manual& v) {
+				duk_push_object(ctx);
+				duk_push_number(ctx, v.x);
+				duk_put_prop_string(ctx, -2, "x");
+				duk_push_number(ctx, v.y);
+				duk_put_prop_string(ctx, -2, "y");
+				duk_push_number(ctx, v.z);
+				duk_put_prop_string(ctx, -2, "z");
+			}
+		};
+
+		template<>
+		struct DukType<ParticleManual> {
+			typedef std::true_type IsValueType;
+
+			template<typename FullT>
+			static ParticleManual read(duk_context* ctx, duk_idx_t arg_idx) {
+				arg_idx = duk_normalize_index(ctx, arg_idx);
+				ParticleManual p;
+				p.position_x = read_field(ctx, arg_idx, "position_x");
+				p.position_y = read_field(ctx, arg_idx, "position_y");
+				p.velocity_x = read_field(ctx, arg_idx, "velocity_x");
+				p.velocity_y = read_field(ctx, arg_idx, "velocity_y");
+				p.lifetime = read_field(ctx, arg_idx, "lifetime");
+				p.size = read_field(ctx, arg_idx, "size");
+				p.rotation = read_field(ctx, arg_idx, "rotation");
+				p.opacity = read_field(ctx, arg_idx, "opacity");
+				return p;
+			}
+
+			template<typename FullT>
+			static void push(duk_context* ctx, const ParticleManual& p) {
+				duk_push_object(ctx);
+				push_field(ctx, "position_x", p.position_x);
+				push_field(ctx, "position_y", p.position_y);
+				push_field(ctx, "velocity_x", p.velocity_x);
+				push_field(ctx, "velocity_y", p.velocity_y);
+				push_field(ctx, "lifetime", p.lifetime);
+				push_field(ctx, "size", p.size);
+				push_field(ctx, "rotation", p.rotation);
+				push_field(ctx, "opacity", p.opacity);
+			}
+
+		private:
+			static float read_field(duk_context* ctx, duk_idx_t obj_idx, const char* name) {
+				duk_get_prop_string(ctx, obj_idx, name);
+				float value = static_cast<float>(duk_require_number(ctx, -1));
+				duk_pop(ctx);
+				return value;
+			}
+
+			static void push_field(duk_context* ctx, const char* name, float value) {
+				duk_push_number(ctx, value);
+				duk_put_prop_string(ctx, -2, name);
+			}
+		};
+	}
+}
+
+namespace {
+
+Vec3 scale(const Vec3& v) {
+	return Vec3{ v.x * 2, v.y * 2, v.z * 2 };
+}
+
+Vec3Manual scale_manual(const Vec3Manual& v) {
+	return Vec3Manual{ v.x * 2, v.y * 2, v.z * 2 };
+}
+
+template<typename V>
+void bench_push_read(duk_context* ctx, const char* push_name, const char* read_name, size_t count)
+{
+	V v = {};
+	bench_run(push_name, count, [&]() {
+		for (size_t i = 0; i < count; i++) {
+			dukglue_push(ctx, v);
+			duk_pop(ctx);
+		}
+	});
+
+	dukglue_push(ctx, v);
+	bench_run(read_name, count, [&]() {
+		V out;
+		for (size_t i = 0; i < count; i++)
+			dukglue_read(ctx, -1, &out);
+	});
+	duk_pop(ctx);
+}
+
+}
+
+// Converts small structs between native and script.
+void bench_structs()
+{
+	const size_t N = 1000000;
+	duk_context* ctx = duk_create_heap_default();
+
+	bench_push_read<Vec3Manual>(ctx, "push Vec3 (duk_put_prop_string)", "read Vec3 (duk_get_prop_string)", N);
+	bench_push_read<Vec3>(ctx, "push Vec3 (DUKGLUE_STRUCT)", "read Vec3 (DUKGLUE_STRUCT)", N);
+	bench_push_read<ParticleManual>(ctx, "push Particle, 8 fields (duk_put_prop_string)", "read Particle, 8 fields (duk_get_prop_string)", N);
+	bench_push_read<Particle>(ctx, "push Particle, 8 fields (DUKGLUE_STRUCT)", "read Particle, 8 fields (DUKGLUE_STRUCT)", N);
+
+	dukglue_register_function(ctx, &scale_manual, "scaleManual");
+	dukglue_register_function(ctx, &scale, "scale");
+	bench_eval(ctx, "var v = { x: 1, y: 2, z: 3 };");
+
+	bench_script_loop(ctx, "scaleManual(v) (duk_*_prop_string)", N, "scaleManual(v)");
+	bench_script_loop(ctx, "scale(v) (DUKGLUE_STRUCT)", N, "scale(v)");
+
+	duk_destroy_heap(ctx);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "duktape.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <stdlib.h>
+
+// Prints the total time and the time per item.
+inline void bench_report(const char* name, size_t items, double secs)
+{
+	std::cout << "  " << std::left << std::setw(48) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(2) << (secs * 1000.0) << " ms"
+		<< std::setw(12) << std::setprecision(1) << (secs * 1e9 / items) << " ns/item" << std::endl;
+}
+
+// Runs func() once and prints the total time and the time per item.
+// Returns the total time in seconds.
+template <typename Func>
+double bench_run(const char* name, size_t items, Func func)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	func();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double secs = std::chrono::duration<double>(end - start).count();
+	bench_report(name, items, secs);
+	return secs;
+}
+
+// Evaluates code, aborting the benchmark run if it throws.
+inline void bench_eval(duk_context* ctx, const std::string& code)
+{
+	if (duk_peval_string(ctx, code.c_str()) != 0) {
+		std::cerr << "Error running '" << code << "': " << duk_safe_to_string(ctx, -1) << std::endl;
+		abort();
+	}
+	duk_pop(ctx);
+}
+
+// Times a script loop calling expr N times ('i' is the loop counter).
+inline double bench_script_loop(duk_context* ctx, const char* name, size_t iterations, const char* expr)
+{
+	std::stringstream ss;
+	ss << "(function() { for (var i = 0; i < " << iterations << "; i++) { " << expr << "; } })();";
+	const std::string code = ss.str();
+
+	return bench_run(name, iterations, [&]() { bench_eval(ctx, code); });
+}
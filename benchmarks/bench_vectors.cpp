@@ -0,0 +1,200 @@
+#include "bench_util.h"
+#include <dukglue/dukglue.h>
+
+#include <vector>
+
+namespace {
+
+double sum_floats(const std::vector<float>& values)
+{
+	double sum = 0;
+	for (float v : values)
+		sum += v;
+	return sum;
+}
+
+double sum_floats_scratch(std::vector<float>& values)
+{
+	double sum = 0;
+	for (float v : values)
+		sum += v;
+	return sum;
+}
+
+size_t count_names(const std::vector<std::string>& names)
+{
+	return names.size();
+}
+
+size_t count_names_scratch(std::vector<std::string>& names)
+{
+	return names.size();
+}
+
+size_t frame_size_vector(const std::vector<uint8_t>& frame)
+{
+	return frame.size();
+}
+
+size_t frame_size_span(DukSpan<uint8_t> frame)
+{
+	return frame.size();
+}
+
+float first_float(DukSpan<const float> values)
+{
+	return values.size() > 0 ? values[0] : 0;
+}
+
+std::shared_ptr< std::vector<uint8_t> > gFrame;
+
+class Entity {
+public:
+	virtual ~Entity() {}
+	int id;
+};
+
+std::vector<Entity*> gEntities;
+
+std::vector<Entity*> query_entities()
+{
+	return gEntities;
+}
+
+std::vector<std::string> gNames;
+
+std::vector<std::string> query_names()
+{
+	return gNames;
+}
+
+std::vector<uint8_t> get_frame_vector()
+{
+	return *gFrame;
+}
+
+DukSharedBuffer<uint8_t> get_frame_shared()
+{
+	return DukSharedBuffer<uint8_t>(gFrame);
+}
+
+}
+
+// Round-trips a 1M element std::vector<float> between C++ and script.
+void bench_vectors()
+{
+	const size_t N = 1000000;
+	const int RUNS = 10;
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_function(ctx, &sum_floats, "sumFloats");
+	dukglue_register_function(ctx, &sum_floats_scratch, "sumFloatsScratch");
+	dukglue_register_function(ctx, &count_names, "countNames");
+	dukglue_register_function(ctx, &count_names_scratch, "countNamesScratch");
+
+	std::vector<float> values(N);
+	for (size_t i = 0; i < N; i++)
+		values[i] = static_cast<float>(i) * 0.5f;
+
+	bench_run("push std::vector<float> (1M elements)", N * RUNS, [&]() {
+		for (int run = 0; run < RUNS; run++) {
+			dukglue_push(ctx, values);
+			duk_pop(ctx);
+		}
+	});
+
+	dukglue_push(ctx, values);
+	bench_run("read std::vector<float> (1M elements, pushed by dukglue)", N * RUNS, [&]() {
+		std::vector<float> out;
+		for (int run = 0; run < RUNS; run++)
+			dukglue_read(ctx, -1, &out);
+	});
+
+	bench_run("dukglue_read_into std::vector<float> (1M elements, reused)", N * RUNS, [&]() {
+		std::vector<float> out;
+		for (int run = 0; run < RUNS; run++)
+			dukglue_read_into(ctx, -1, out);
+	});
+	duk_pop(ctx);
+
+	// a small per-frame result, read many times
+	const int FRAMES_READ = 100000;
+	bench_eval(ctx, "var visible = ['player', 'enemy_with_a_long_name_0', 'enemy_with_a_long_name_1', 'pickup'];");
+	duk_get_global_string(ctx, "visible");
+	bench_run("read std::vector<std::string> (4 strings)", FRAMES_READ, [&]() {
+		std::vector<std::string> out;
+		for (int run = 0; run < FRAMES_READ; run++)
+			dukglue_read(ctx, -1, &out);
+	});
+	bench_run("dukglue_read_into std::vector<std::string> (4 strings, reused)", FRAMES_READ, [&]() {
+		std::vector<std::string> out;
+		for (int run = 0; run < FRAMES_READ; run++)
+			dukglue_read_into(ctx, -1, out);
+	});
+	duk_pop(ctx);
+
+	// the same, as an argument (const std::vector& builds a new vector per call, std::vector& refills one)
+	bench_script_loop(ctx, "countNames(visible), const ref", FRAMES_READ, "countNames(visible)");
+	bench_script_loop(ctx, "countNamesScratch(visible), non-const ref", FRAMES_READ, "countNamesScratch(visible)");
+
+	bench_eval(ctx, "var f32 = new Float32Array(" + std::to_string(N) + "); for (var i = 0; i < f32.length; i++) f32[i] = i * 0.5;");
+	bench_eval(ctx, "var arr = new Array(" + std::to_string(N) + "); for (var i = 0; i < arr.length; i++) arr[i] = i * 0.5;");
+
+	bench_script_loop(ctx, "sumFloats(Float32Array) (1M elements)", RUNS, "sumFloats(f32)");
+	bench_script_loop(ctx, "sumFloats(Array) (1M elements)", RUNS, "sumFloats(arr)");
+	bench_script_loop(ctx, "sumFloatsScratch(Float32Array) (1M elements)", RUNS, "sumFloatsScratch(f32)");
+
+	// 4 MB frames passed through bindings
+	const size_t FRAME_SIZE = 4 * 1024 * 1024;
+	const int FRAMES = 200;
+	gFrame = std::make_shared< std::vector<uint8_t> >(FRAME_SIZE, 7);
+
+	dukglue_register_function(ctx, &frame_size_vector, "frameSizeVector");
+	dukglue_register_function(ctx, &frame_size_span, "frameSizeSpan");
+	dukglue_register_function(ctx, &get_frame_vector, "getFrameVector");
+	dukglue_register_function(ctx, &get_frame_shared, "getFrameShared");
+	bench_eval(ctx, "var frame = new Uint8Array(" + std::to_string(FRAME_SIZE) + ");");
+
+	bench_script_loop(ctx, "4 MB Uint8Array -> std::vector<uint8_t> arg", FRAMES, "frameSizeVector(frame)");
+	bench_script_loop(ctx, "4 MB Uint8Array -> DukSpan<uint8_t> arg", FRAMES, "frameSizeSpan(frame)");
+
+	// per-call cost of checking a TypedArray's element type
+	dukglue_register_function(ctx, &first_float, "firstFloat");
+	bench_script_loop(ctx, "Float32Array -> DukSpan<const float> arg", FRAMES_READ, "firstFloat(f32)");
+	bench_script_loop(ctx, "4 MB std::vector<uint8_t> return", FRAMES, "getFrameVector()");
+	bench_script_loop(ctx, "4 MB DukSharedBuffer<uint8_t> return", FRAMES, "getFrameShared()");
+
+	// 50k results from a "spatial query"
+	const size_t ENTITIES = 50000;
+	const int QUERIES = 20;
+	std::vector<Entity> entities(ENTITIES);
+	for (size_t i = 0; i < ENTITIES; i++) {
+		entities[i].id = static_cast<int>(i);
+		gEntities.push_back(&entities[i]);
+		gNames.push_back("entity_" + std::to_string(i));
+	}
+
+	dukglue_register_constructor<Entity>(ctx, "Entity");
+	dukglue_register_function(ctx, &query_entities, "queryEntities");
+	dukglue_register_function(ctx, &query_names, "queryNames");
+
+	// (only the query is timed, not invalidating the objects afterwards)
+	double query_secs = 0;
+	for (int q = 0; q < QUERIES; q++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		bench_eval(ctx, "queryEntities()");
+		query_secs += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		dukglue_invalidate_objects(ctx, entities.data(), entities.size());
+	}
+	bench_report("50k std::vector<Entity*> return (new script objects)", QUERIES, query_secs);
+	bench_eval(ctx, "queryEntities()");
+	bench_script_loop(ctx, "50k std::vector<Entity*> return (registered)", QUERIES, "queryEntities()");
+	bench_script_loop(ctx, "50k std::vector<std::string> return", QUERIES, "queryNames()");
+	dukglue_invalidate_objects(ctx, entities.data(), entities.size());
+
+	duk_destroy_heap(ctx);
+	gFrame.reset();
+	gEntities.clear();
+	gNames.clear();
+}
@@ -0,0 +1,158 @@
+#include "bench_util.h"
+#include "bench_alloc.h"
+#include <dukglue/dukglue.h>
+
+#include <vector>
+
+namespace {
+
+class Thing {
+public:
+	Thing() : value_(1) {}
+
+	int value() const {
+		return value_;
+	}
+
+private:
+	int value_;
+};
+
+std::vector<Thing>* things = NULL;
+
+Thing* get_thing(int i) {
+	return &things->at(i);
+}
+
+int read_thing(Thing* thing) {
+	return thing->value();
+}
+
+int read_two_things(Thing* a, Thing* b) {
+	return a->value() + b->value();
+}
+
+// 8-level deep class hierarchy
+template <int N>
+class Deep : public Deep<N - 1> {};
+
+template <>
+class Deep<0> {
+public:
+	virtual ~Deep() {}
+	int value() const { return 1; }
+};
+
+template <int N>
+struct RegisterDeep {
+	static void run(duk_context* ctx) {
+		dukglue_set_base_class<Deep<N - 1>, Deep<N> >(ctx);
+		RegisterDeep<N - 1>::run(ctx);
+	}
+};
+
+template <>
+struct RegisterDeep<0> {
+	static void run(duk_context* ctx) {}
+};
+
+Deep<8>* get_deep() {
+	static Deep<8> deep;
+	return &deep;
+}
+
+void take_object(DukValue value) {
+}
+
+int read_deep_root(Deep<0>* deep) {
+	return deep->value();
+}
+
+// Lots of unrelated registered classes, so prototype lookups are not trivially cheap.
+template <int N>
+struct Filler {};
+
+template <int N>
+struct RegisterFillers {
+	static void run(duk_context* ctx) {
+		dukglue::detail::ProtoManager::push_prototype< Filler<N> >(ctx);
+		duk_pop(ctx);
+		RegisterFillers<N - 1>::run(ctx);
+	}
+};
+
+template <>
+struct RegisterFillers<0> {
+	static void run(duk_context* ctx) {}
+};
+
+}
+
+// Memory per wrapper and native argument reads with 1M live wrappers.
+void bench_wrappers()
+{
+	const size_t N = 1000000;
+	std::vector<Thing> storage(N);
+	things = &storage;
+
+	BenchAllocStats stats;
+	duk_context* ctx = bench_create_counted_heap(&stats);
+
+	dukglue_register_function(ctx, get_thing, "get_thing");
+	dukglue_register_function(ctx, read_thing, "read_thing");
+	dukglue_register_function(ctx, read_two_things, "read_two_things");
+
+	// make sure the prototype and the array are allocated before measuring
+	bench_eval(ctx, "var things = new Array(" + std::to_string(N) + "); things[0] = get_thing(0);");
+	duk_gc(ctx, 0);
+
+	// (native headers live in the context's object pool, outside the Duktape heap)
+	const dukglue::detail::ObjectPool* pool = dukglue::detail::ContextState::get(ctx)->object_pool();
+	const size_t before = stats.live_bytes + pool->reserved_bytes();
+	bench_script_loop(ctx, "create 1M wrappers", N - 1, "things[i + 1] = get_thing(i + 1)");
+	duk_gc(ctx, 0);
+	const size_t after = stats.live_bytes + pool->reserved_bytes();
+	std::cout << "  memory per wrapper (incl. registry and header): " << (double) (after - before) / (N - 1) << " bytes" << std::endl;
+
+	bench_script_loop(ctx, "read_thing(things[i])", N, "read_thing(things[i])");
+	bench_script_loop(ctx, "read_two_things(things[i], things[0])", N, "read_two_things(things[i], things[0])");
+
+	// casting to a base class 8 levels up
+	RegisterDeep<8>::run(ctx);
+	dukglue_register_function(ctx, get_deep, "get_deep");
+	dukglue_register_function(ctx, read_deep_root, "read_deep_root");
+	bench_eval(ctx, "var deep = get_deep();");
+	bench_script_loop(ctx, "read_deep_root(deep) (8 levels)", N, "read_deep_root(deep)");
+
+	// the cast itself, without the call around it
+	const dukglue::detail::TypeInfo* deep_info = dukglue::detail::ProtoManager::push_prototype< Deep<8> >(ctx);
+	duk_pop(ctx);
+	bench_run("TypeInfo::cast to a base 8 levels up", N * 10, [&]() {
+		void* volatile obj = get_deep();
+		for (size_t i = 0; i < N * 10; i++)
+			obj = deep_info->cast< Deep<0> >(obj);
+	});
+
+	// DukValue arguments stash (and release) a reference to the object
+	dukglue_register_function(ctx, take_object, "take_object");
+	bench_eval(ctx, "var plain = {};");
+	bench_script_loop(ctx, "take_object(plain) (DukValue)", N, "take_object(plain)");
+
+	duk_destroy_heap(ctx);
+
+	// pushing fresh wrappers needs the prototype for the object's type
+	ctx = duk_create_heap_default();
+	dukglue_register_function(ctx, get_thing, "get_thing");
+	RegisterFillers<256>::run(ctx);
+	bench_eval(ctx, "var things = new Array(" + std::to_string(N) + ");");
+	bench_script_loop(ctx, "create 1M wrappers (256 classes registered)", N, "things[i] = get_thing(i)");
+	bench_run("prototype lookup (256 classes registered)", N, [&]() {
+		for (size_t i = 0; i < N; i++) {
+			dukglue::detail::ProtoManager::push_prototype< Filler<128> >(ctx);
+			duk_pop(ctx);
+		}
+	});
+	duk_destroy_heap(ctx);
+
+	things = NULL;
+}
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <string.h>
+
+void bench_functions();
+void bench_methods();
+void bench_properties();
+void bench_wrappers();
+void bench_registration();
+void bench_refs();
+void bench_managed();
+void bench_refs_10m();
+void bench_vectors();
+void bench_structs();
+void bench_calls();
+
+struct Benchmark {
+	const char* name;
+	void(*func)();
+};
+
+static const Benchmark benchmarks[] = {
+	{ "functions", bench_functions },
+	{ "methods", bench_methods },
+	{ "properties", bench_properties },
+	{ "wrappers", bench_wrappers },
+	{ "registration", bench_registration },
+	{ "refs", bench_refs },
+	{ "refs_10m", bench_refs_10m },
+	{ "managed", bench_managed },
+	{ "vectors", bench_vectors },
+	{ "structs", bench_structs },
+	{ "calls", bench_calls },
+};
+
+// Usage: dukglue_bench [name...]
+// Runs every benchmark (except the "_10m" ones) if no names are given.
+int main(int argc, char** argv) {
+	for (const Benchmark& bench : benchmarks) {
+		bool run = (argc <= 1 && strstr(bench.name, "_10m") == NULL);
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(argv[i], bench.name) == 0)
+				run = true;
+		}
+
+		if (run) {
+			std::cout << bench.name << ":" << std::endl;
+			bench.func();
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <duktape.h>
+
+#include "detail_context_state.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Allocator policies for managed constructors (see dukglue_register_constructor_managed).
+// A policy has three static functions:
+
+//   static void* prepare(duk_context* ctx);
+
+//   template<class Cls, typename... Args>
+//   static Cls* create(void* data, void** owner, Args&&... args);
+
+//   template<class Cls>
+//   static void destroy(Cls* obj, void* owner);
+
+// prepare() is called once, when the constructor is registered, and its result is passed to every
+// create() call for that constructor (so per-context allocators don't need to look anything up).
+// create() constructs a Cls, and can set *owner to anything it needs to destroy the object later
+// (it is stored in the object's native header). destroy() is called from the object's finalizer,
+// which may run while the heap is being destroyed, so it should not use the context.
+
+// InlineStorage is special: it is not an allocator, the constructor gives it the memory to use.
+
+namespace dukglue
+{
+	// new / delete (the default).
+	struct HeapAllocator
+	{
+		static void* prepare(duk_context* ctx)
+		{
+			return nullptr;
+		}
+
+		template<class Cls, typename... Args>
+		static Cls* create(void* data, void** owner, Args&&... args)
+		{
+			return new Cls(std::forward<Args>(args)...);
+		}
+
+		template<class Cls>
+		static void destroy(Cls* obj, void* owner)
+		{
+			delete obj;
+		}
+	};
+
+	// Allocates from a size-class pool that belongs to the context (see detail_object_pool.h),
+	// so creating and finalizing small objects is a free list pop/push instead of a trip through
+	// the global allocator. The pool is not thread safe, like the rest of a Duktape heap.
+	// Classes that are too big or over-aligned for the pool fall back to new / delete.
+	struct PoolAllocator
+	{
+		template<class Cls>
+		struct IsPooled : std::integral_constant<bool,
+			sizeof(Cls) <= detail::ObjectPool::MAX_SIZE && alignof(Cls) <= detail::ObjectPool::GRANULARITY> {};
+
+		static void* prepare(duk_context* ctx)
+		{
+			return detail::ContextState::get(ctx)->object_pool();
+		}
+
+		template<class Cls, typename... Args>
+		static typename std::enable_if<IsPooled<Cls>::value, Cls*>::type create(void* data, void** owner, Args&&... args)
+		{
+			detail::ObjectPool* pool = static_cast<detail::ObjectPool*>(data);
+
+			// gives the memory back if the constructor throws
+			struct Guard {
+				detail::ObjectPool* pool;
+				void* mem;
+				~Guard() {
+					if (mem != nullptr)
+						pool->deallocate(mem, sizeof(Cls));
+				}
+			} guard = { pool, pool->allocate(sizeof(Cls)) };
+
+			Cls* obj = new (guard.mem) Cls(std::forward<Args>(args)...);
+			guard.mem = nullptr;
+
+			*owner = pool;
+			return obj;
+		}
+
+		template<class Cls>
+		static typename std::enable_if<IsPooled<Cls>::value>::type destroy(Cls* obj, void* owner)
+		{
+			obj->~Cls();
+			static_cast<detail::ObjectPool*>(owner)->deallocate(obj, sizeof(Cls));
+		}
+
+		template<class Cls, typename... Args>
+		static typename std::enable_if<!IsPooled<Cls>::value, Cls*>::type create(void* data, void** owner, Args&&... args)
+		{
+			return HeapAllocator::create<Cls>(data, owner, std::forward<Args>(args)...);
+		}
+
+		template<class Cls>
+		static typename std::enable_if<!IsPooled<Cls>::value>::type destroy(Cls* obj, void* owner)
+		{
+			HeapAllocator::destroy(obj, owner);
+		}
+	};
+
+	// Constructs the object inside the script object's native header buffer (see NativeHeaderExt::create_with_storage),
+	// so a script object and its native object are a single Duktape allocation, and the native object
+	// is freed along with the script object. Good for small value types (vectors, colors, rects).
+	// The finalizer only runs the destructor.
+	// Don't keep pointers to these objects around in C++: they are only valid while the script object is alive.
+	struct InlineStorage
+	{
+		static void* prepare(duk_context* ctx)
+		{
+			return nullptr;
+		}
+
+		// (data is the storage for the object)
+		template<class Cls, typename... Args>
+		static Cls* create(void* data, void** owner, Args&&... args)
+		{
+			return new (data) Cls(std::forward<Args>(args)...);
+		}
+
+		template<class Cls>
+		static void destroy(Cls* obj, void* owner)
+		{
+			obj->~Cls();
+		}
+	};
+}
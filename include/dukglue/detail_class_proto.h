@@ -1,30 +1,36 @@
 #pragma once
 
 #include "detail_typeinfo.h"
+#include "detail_native_header.h"
+#include "detail_context_state.h"
 #include <assert.h>
 
+#include <typeindex>
+
 namespace dukglue {
   namespace detail {
 
 		struct ProtoManager
 		{
     public:
+			// Pushes the prototype for Cls (creating it if necessary) and
+			// returns the TypeInfo object it owns.
 			template <typename Cls>
-			static void push_prototype(duk_context* ctx)
+			static TypeInfo* push_prototype(duk_context* ctx)
 			{
-				push_prototype(ctx, TypeInfo(typeid(Cls)));
+				return push_prototype(ctx, std::type_index(typeid(Cls)));
 			}
 
-			static void push_prototype(duk_context* ctx, const TypeInfo& check_info)
+			static TypeInfo* push_prototype(duk_context* ctx, const std::type_index& type)
 			{
-				if (!find_and_push_prototype(ctx, check_info)) {
+				TypeInfo* info = find_and_push_prototype(ctx, type);
+				if (info == nullptr) {
 					// nope, need to create our prototype object
 					duk_push_object(ctx);
 
 					// add reference to this class' info object so we can do type checking
 					// when trying to pass this object into method calls
-					typedef dukglue::detail::TypeInfo TypeInfo;
-					TypeInfo* info = new TypeInfo(check_info);
+					info = new TypeInfo(std::type_index(type));
 
 					duk_push_pointer(ctx, info);
 					duk_put_prop_string(ctx, -2, "\xFF" "type_info");
@@ -47,16 +53,23 @@ namespace dukglue {
 					// register it in the stash
 					register_prototype(ctx, info);
 				}
+
+				return info;
 			}
 
+			// Creates a new script object for obj (with the appropriate prototype and
+			// native header) and pushes it. Returns the new object's native header
+			// (a NativeHeaderExt if flags is non-zero, see NativeHeader::create).
 			template<typename Cls>
-			static void make_script_object(duk_context* ctx, Cls* obj)
+			static NativeHeader* make_script_object(duk_context* ctx, Cls* obj, uint32_t flags = 0)
 			{
 				assert(obj != NULL);
 
 				duk_push_object(ctx);
-				duk_push_pointer(ctx, obj);
-				duk_put_prop_string(ctx, -2, "\xFF" "obj_ptr");
+				TypeInfo* info;
+
+				// the header points to the most-derived object, which is what info (the run-time type) describes
+				void* ptr = most_derived_ptr(obj);
 
 				// push the appropriate prototype
 #ifdef DUKGLUE_INFER_BASE_CLASS
@@ -79,20 +92,131 @@ namespace dukglue {
 				// dukglue_set_base_class() to be called, so it is opt-in via an ifdef.
 
 				// does a prototype exist for the run-time type? if so, push it
-				if (!find_and_push_prototype(ctx, TypeInfo(typeid(*obj)))) {
+				info = find_and_push_prototype(ctx, typeid(*obj));
+				if (info == nullptr) {
 					// nope, find or create the prototype for the compile-time type
-					// and push that
-					push_prototype<Cls>(ctx);
+					// and push that (obj is then stored as a Cls*, not as the most-derived object)
+					info = push_prototype<Cls>(ctx);
+					ptr = obj;
 				}
 #else
 				// always use the prototype for the run-time type
-				push_prototype(ctx, TypeInfo(typeid(*obj)));
+				info = push_prototype(ctx, typeid(*obj));
 #endif
 
 				duk_set_prototype(ctx, -2);
+
+				return NativeHeader::create(ctx, -1, ptr, info, flags);
+			}
+
+			// The prototype used for the last object made by make_script_object(ctx, obj, hint),
+			// so making many objects of the same run-time type in a row resolves the prototype once.
+			struct ProtoHint
+			{
+				ProtoHint() : type(nullptr), heapptr(nullptr), info(nullptr), most_derived(true) {}
+
+				const std::type_info* type;
+				void* heapptr;  // kept alive by the prototypes array
+				const TypeInfo* info;
+				bool most_derived;  // header->obj is the most-derived object (see DUKGLUE_INFER_BASE_CLASS)
+			};
+
+			// Same as make_script_object(ctx, obj), but reuses hint's prototype if obj has the same
+			// run-time type as the previous object, and updates hint otherwise.
+			template<typename Cls>
+			static NativeHeader* make_script_object(duk_context* ctx, Cls* obj, ProtoHint& hint)
+			{
+				const std::type_info& type = typeid(*obj);
+				if (hint.type == nullptr || *hint.type != type) {
+					NativeHeader* header = make_script_object<Cls>(ctx, obj);
+
+					duk_get_prototype(ctx, -1);
+					hint.heapptr = duk_get_heapptr(ctx, -1);
+					duk_pop(ctx);
+
+					hint.type = &type;
+					hint.info = header->type_info;
+					hint.most_derived = (header->obj == most_derived_ptr(obj));
+					return header;
+				}
+
+				duk_push_object(ctx);
+				duk_push_heapptr(ctx, hint.heapptr);
+				duk_set_prototype(ctx, -2);
+
+				return NativeHeader::create(ctx, -1, hint.most_derived ? most_derived_ptr(obj) : static_cast<void*>(obj), hint.info);
+			}
+
+			// Copies the properties of the native prototype at from_idx (and of the native prototypes
+			// it inherits from) onto the prototype at to_idx, skipping any names to_idx already has
+			// (directly or through its own prototype chain). Used for secondary base classes, since
+			// a script object can only have one prototype chain.
+			// Does not affect the stack.
+			static void copy_prototype_chain(duk_context* ctx, duk_idx_t from_idx, duk_idx_t to_idx)
+			{
+				from_idx = duk_normalize_index(ctx, from_idx);
+				to_idx = duk_normalize_index(ctx, to_idx);
+
+				duk_dup(ctx, from_idx);
+				while (duk_has_prop_string(ctx, -1, "\xFF" "type_info")) {
+					duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY | DUK_ENUM_INCLUDE_NONENUMERABLE);
+					while (duk_next(ctx, -1, 0)) {
+						// [proto] [enum] [key]
+						duk_dup(ctx, -1);
+						if (duk_has_prop(ctx, to_idx)) {
+							duk_pop(ctx);  // pop key
+							continue;
+						}
+
+						duk_dup(ctx, -1);
+						duk_get_prop_desc(ctx, -4, 0);  // [proto] [enum] [key] [desc]
+						define_from_descriptor(ctx, to_idx);
+					}
+					duk_pop(ctx);  // pop enum
+
+					duk_get_prototype(ctx, -1);
+					duk_remove(ctx, -2);
+				}
+				duk_pop(ctx);
 			}
 
 		private:
+			// Stack: ... [key] [desc]  ->  ...
+			static void define_from_descriptor(duk_context* ctx, duk_idx_t obj_idx)
+			{
+				duk_uint_t flags = DUK_DEFPROP_HAVE_ENUMERABLE | DUK_DEFPROP_HAVE_CONFIGURABLE;
+
+				duk_get_prop_string(ctx, -1, "enumerable");
+				if (duk_to_boolean(ctx, -1))
+					flags |= DUK_DEFPROP_ENUMERABLE;
+				duk_pop(ctx);
+
+				duk_get_prop_string(ctx, -1, "configurable");
+				if (duk_to_boolean(ctx, -1))
+					flags |= DUK_DEFPROP_CONFIGURABLE;
+				duk_pop(ctx);
+
+				if (duk_has_prop_string(ctx, -1, "get") || duk_has_prop_string(ctx, -1, "set")) {
+					// accessor property: [key] [desc] -> [key] [desc] [getter] [setter]
+					duk_get_prop_string(ctx, -1, "get");
+					duk_get_prop_string(ctx, -2, "set");
+					flags |= DUK_DEFPROP_HAVE_GETTER | DUK_DEFPROP_HAVE_SETTER;
+				} else {
+					// data property: [key] [desc] -> [key] [desc] [value]
+					duk_get_prop_string(ctx, -1, "writable");
+					if (duk_to_boolean(ctx, -1))
+						flags |= DUK_DEFPROP_WRITABLE;
+					duk_pop(ctx);
+
+					duk_get_prop_string(ctx, -1, "value");
+					flags |= DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_HAVE_WRITABLE;
+				}
+
+				// move the descriptor out of the way: [key] [value...]
+				duk_remove(ctx, (flags & DUK_DEFPROP_HAVE_VALUE) ? -2 : -3);
+				duk_def_prop(ctx, obj_idx, flags);
+			}
+
 			static duk_ret_t type_info_finalizer(duk_context* ctx)
 			{
 				duk_get_prop_string(ctx, 0, "\xFF" "type_info");
@@ -106,94 +230,37 @@ namespace dukglue {
 				return 0;
 			}
 
-			// puts heap_stash["dukglue_prototypes"] on the stack,
-			// or creates it if it doesn't exist
-			static void push_prototypes_array(duk_context* ctx)
-			{
-				static const char* DUKGLUE_PROTOTYPES = "dukglue_prototypes";
-
-				duk_push_heap_stash(ctx);
-
-				// does the prototype array already exist?
-				if (!duk_has_prop_string(ctx, -1, DUKGLUE_PROTOTYPES)) {
-					// nope, we need to create it
-					duk_push_array(ctx);
-					duk_put_prop_string(ctx, -2, DUKGLUE_PROTOTYPES);
-				}
-
-				duk_get_prop_string(ctx, -1, DUKGLUE_PROTOTYPES);
-
-				// remove the heap stash from the stack
-				duk_remove(ctx, -2);
-			}
-
 			// Stack: ... [proto]  ->  ... [proto]
 			static void register_prototype(duk_context* ctx, const TypeInfo* info) {
-				// 1. We assume info is not in the prototype array already
-				// 2. Duktape has no efficient "shift array indices" operation (at least publicly)
-				// 3. This method doesn't need to be fast, it's only called during registration
-
-				// Work from high to low in the prototypes array, shifting as we go,
-				// until we find the spot for info.
-
-				push_prototypes_array(ctx);
-				duk_size_t i = duk_get_length(ctx, -1);
-				while (i > 0) {
-					duk_get_prop_index(ctx, -1, i - 1);
-
-					duk_get_prop_string(ctx, -1, "\xFF" "type_info");
-					const TypeInfo* chk_info = static_cast<TypeInfo*>(duk_require_pointer(ctx, -1));
-					duk_pop(ctx);  // pop type_info
-
-					if (*chk_info > *info) {
-						duk_put_prop_index(ctx, -2, i);
-						i--;
-					} else {
-						duk_pop(ctx);  // pop prototypes_array[i]
-						break;
-					}
-				}
-
-				//std::cout << "Registering prototype for " << typeid(Cls).name() << " at " << i << std::endl;
+				// We assume info is not registered already.
+				// Lookups go through the native cache (see find_and_push_prototype), so the
+				// prototypes array is only here to keep prototypes reachable and doesn't need
+				// to be sorted - registering a class is an append plus a hash insert.
+				ContextState* state = ContextState::get(ctx);
 
+				duk_push_heapptr(ctx, state->prototypes_array);
 				duk_dup(ctx, -2);  // copy proto to top
-				duk_put_prop_index(ctx, -2, i);
+				duk_put_prop_index(ctx, -2, static_cast<duk_uarridx_t>(duk_get_length(ctx, -2)));
 				duk_pop(ctx);  // pop prototypes_array
-			}
-
-			static bool find_and_push_prototype(duk_context* ctx, const TypeInfo& search_info) {
-				push_prototypes_array(ctx);
-
-				// these are ints and not duk_size_t to deal with negative indices
-				int min = 0;
-				int max = duk_get_length(ctx, -1) - 1;
-
-				while (min <= max) {
-					int mid = (max - min) / 2 + min;
-
-					duk_get_prop_index(ctx, -1, mid);
 
-					duk_get_prop_string(ctx, -1, "\xFF" "type_info");
-					TypeInfo* mid_info = static_cast<TypeInfo*>(duk_require_pointer(ctx, -1));
-					duk_pop(ctx);  // pop type_info pointer
+				// the prototypes array keeps proto reachable, so its heap pointer stays valid
+				ContextState::ProtoEntry entry = { duk_get_heapptr(ctx, -1), const_cast<TypeInfo*>(info) };
+				state->proto_cache[info->index()] = entry;
+			}
 
-					if (*mid_info == search_info) {
-						// found it
-						duk_remove(ctx, -2);  // pop prototypes_array
-						return true;
-					}
-					else if (*mid_info < search_info) {
-						min = mid + 1;
-					}
-					else {
-						max = mid - 1;
-					}
+			// Pushes the prototype for type and returns its TypeInfo,
+			// or returns NULL (and pushes nothing) if it has not been created yet.
+			// Every registered prototype is in the native cache (ContextState::proto_cache),
+			// so this is one hash lookup and never walks the prototypes array.
+			static TypeInfo* find_and_push_prototype(duk_context* ctx, const std::type_index& type) {
+				const ContextState::ProtoCache& cache = ContextState::get(ctx)->proto_cache;
 
-					duk_pop(ctx);  // pop prototypes_array[mid]
-				}
+				const auto it = cache.find(type);
+				if (it == cache.end())
+					return nullptr;
 
-				duk_pop(ctx);  // pop prototypes_array
-				return false;
+				duk_push_heapptr(ctx, it->second.heapptr);
+				return it->second.info;
 			}
 
     };
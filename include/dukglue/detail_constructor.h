@@ -2,11 +2,53 @@
 
 #include "detail_stack.h"
 #include "detail_traits.h"
+#include "allocators.h"
 
 namespace dukglue {
   namespace detail {
 
-    template<bool managed, typename Cls, typename... Ts>
+    // Stored in a fixed buffer at \xFFmanaged on the prototype of objects created by a managed
+    // constructor (see dukglue_register_constructor_managed), so the constructor gets both
+    // with a single property lookup.
+    struct ManagedConstructorData
+    {
+      const TypeInfo* info;
+      void* alloc_data;  // Allocator::prepare()
+    };
+
+    // Constructs a Cls with Allocator and gives the script object at the top of the stack a header for it.
+    template<typename Cls, typename Allocator, typename... Args>
+    static NativeHeader* construct_native_object(duk_context* ctx, const TypeInfo* info, uint32_t flags,
+      void* alloc_data, std::tuple<Args...>&& args, std::false_type /* inline storage */)
+    {
+      void* owner = nullptr;
+      Cls* obj = dukglue::detail::apply_constructor<Cls, Allocator>(alloc_data, &owner, std::move(args));
+
+      // make the new script object keep the pointer to the new object instance
+      // (unmanaged objects get a plain header, unless their class uses weak refs)
+      if (flags == 0 && owner == nullptr)
+        return NativeHeader::create(ctx, -1, obj, info);
+
+      NativeHeaderExt* header = NativeHeaderExt::create(ctx, -1, obj, info, flags);
+      header->owner = owner;
+      return header;
+    }
+
+    // InlineStorage: the object goes into the header's buffer, so make that first
+    // (until the object is constructed, header->obj is NULL, so the finalizer does nothing)
+    template<typename Cls, typename Allocator, typename... Args>
+    static NativeHeader* construct_native_object(duk_context* ctx, const TypeInfo* info, uint32_t flags,
+      void* alloc_data, std::tuple<Args...>&& args, std::true_type /* inline storage */)
+    {
+      void* storage = nullptr;
+      void* owner = nullptr;
+      NativeHeaderExt* header = NativeHeaderExt::create_with_storage<Cls>(ctx, -1, info, flags | NativeHeader::INLINE, &storage);
+      header->obj = dukglue::detail::apply_constructor<Cls, Allocator>(storage, &owner, std::move(args));
+      return header;
+    }
+
+    // (unmanaged objects are deleted by the application, so they always use HeapAllocator)
+    template<bool managed, typename Cls, typename Allocator, typename... Ts>
     static duk_ret_t call_native_constructor(duk_context* ctx)
     {
       if (!duk_is_constructor_call(ctx)) {
@@ -14,40 +56,49 @@ namespace dukglue {
         return DUK_RET_TYPE_ERROR;
       }
 
-      // construct the new instance
-      auto constructor_args = dukglue::detail::get_stack_values<Ts...>(ctx);
-      Cls* obj = dukglue::detail::apply_constructor<Cls>(std::move(constructor_args));
-
       duk_push_this(ctx);
 
-      // make the new script object keep the pointer to the new object instance
-      duk_push_pointer(ctx, obj);
-      duk_put_prop_string(ctx, -2, "\xFF" "obj_ptr");
+      const TypeInfo* info;
+      void* alloc_data = nullptr;
+      if (managed) {
+        duk_get_prop_string(ctx, -1, "\xFF" "managed");
+        const ManagedConstructorData* data = static_cast<const ManagedConstructorData*>(duk_require_buffer(ctx, -1, NULL));
+        info = data->info;
+        alloc_data = data->alloc_data;
+      } else {
+        // (type_info comes from the class prototype, which is this's prototype)
+        duk_get_prop_string(ctx, -1, "\xFF" "type_info");
+        info = static_cast<const TypeInfo*>(duk_require_pointer(ctx, -1));
+      }
+      duk_pop(ctx);
+
+      // construct the new instance
+      // (arguments are still at the bottom of the stack, below this)
+      auto constructor_args = dukglue::detail::get_stack_values<Ts...>(ctx);
+      NativeHeader* header = construct_native_object<Cls, Allocator>(ctx, info, managed ? NativeHeader::MANAGED : 0,
+        alloc_data, std::move(constructor_args), std::is_same<Allocator, dukglue::InlineStorage>());
 
       // register it
 	  if (!managed)
-		dukglue::detail::RefManager::register_native_object(ctx, obj);
+		dukglue::detail::RefManager::register_native_object(ctx, header->obj, get_ref_hook(static_cast<Cls*>(header->obj)), header);
 
       duk_pop(ctx); // pop this
 
       return 0;
     }
 
-	template <typename Cls>
+	template <typename Cls, typename Allocator>
 	static duk_ret_t managed_finalizer(duk_context* ctx)
 	{
-		duk_get_prop_string(ctx, 0, "\xFF" "obj_ptr");
-		Cls* obj = (Cls*) duk_require_pointer(ctx, -1);
-		duk_pop(ctx);  // pop obj_ptr
-
-		if (obj != NULL) {
-			delete obj;
+		// (this also runs for the prototype holding the finalizer, which has no header)
+		NativeHeaderExt* ext = NULL;
+		NativeHeader* header = NativeHeader::get_own(ctx, 0, &ext);
 
-			// for safety, set the pointer to undefined
-			duk_push_undefined(ctx);
-			duk_put_prop_string(ctx, 0, "\xFF" "obj_ptr");
-		}
+		if (ext != NULL && ext->obj != NULL && (ext->flags & NativeHeader::MANAGED))
+			Allocator::destroy(static_cast<Cls*>(ext->obj), ext->owner);
 
+		// (this removes the header, so the object is only destroyed once)
+		RefManager::release_native_header(ctx, 0, header, ext);
 		return 0;
 	}
 
@@ -55,18 +106,35 @@ namespace dukglue {
 	static duk_ret_t call_native_deleter(duk_context* ctx)
 	{
 		duk_push_this(ctx);
-		duk_get_prop_string(ctx, -1, "\xFF" "obj_ptr");
+		NativeHeaderExt* ext = NULL;
+		NativeHeader* header = NativeHeader::get(ctx, -1, &ext);
+		duk_pop(ctx);
 
-		if (!duk_is_pointer(ctx, -1)) {
+		if (header == NULL || header->obj == NULL) {
 			duk_error(ctx, DUK_RET_REFERENCE_ERROR, "Object has already been invalidated; cannot delete.");
 			return DUK_RET_REFERENCE_ERROR;
 		}
 
-		Cls* obj = static_cast<Cls*>(duk_require_pointer(ctx, -1));
+		Cls* obj = header->type_info->cast<Cls>(header->obj);
+		if (obj == NULL)
+			duk_error(ctx, DUK_RET_TYPE_ERROR, "Wrong type of native object; cannot delete.");
+
+		if (ext != NULL && (ext->flags & NativeHeader::MANAGED)) {
+			// only the managed finalizer knows how the object was allocated, so let it free the object now
+			// (it frees the header, so it does nothing when it runs again later)
+			duk_push_this(ctx);
+			duk_get_finalizer(ctx, -1);
+			duk_swap_top(ctx, -2);
+			duk_call(ctx, 1);
+			duk_pop(ctx);
+			return 0;
+		}
+
+		// (first, in case obj was not registered in this context - invalidating it frees the header)
+		header->obj = NULL;
 		dukglue_invalidate_object(ctx, obj);
 		delete obj;
 
-		duk_pop_2(ctx);
 		return 0;
 	}
   }
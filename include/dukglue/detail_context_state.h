@@ -0,0 +1,275 @@
+#pragma once
+
+#include <duktape.h>
+
+#include "detail_typeinfo.h"
+#include "detail_ref_registry.h"
+#include "detail_object_pool.h"
+
+#include <atomic>
+#include <mutex>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+namespace dukglue
+{
+	namespace detail
+	{
+		// Everything dukglue keeps per Duktape heap, in one native block:
+		// the native object registry (see detail_refs.h), the prototype cache (see detail_class_proto.h),
+		// interned DUKGLUE_STRUCT property names (see dukstruct.h), the pool for dukglue::PoolAllocator
+		// and heap pointers to the script arrays that keep registered objects, prototypes, interned names
+		// and DukValue references alive (those arrays still live in the heap stash).
+
+		// Getting the state for a context is one heap stash push (no property lookups) plus
+		// a thread-local single-entry cache check, falling back to a mutex-guarded registry
+		// when switching between heaps.
+
+		// The state is created the first time it is needed, and destroyed by the finalizer of
+		// a sentinel object in the heap stash (which runs when the heap is destroyed).
+		struct ContextState
+		{
+			// native type -> prototype. The prototypes themselves are kept alive by
+			// prototypes_array; this only holds borrowed heap pointers.
+			struct ProtoEntry {
+				void* heapptr;
+				TypeInfo* info;
+			};
+			typedef std::unordered_map<std::type_index, ProtoEntry> ProtoCache;
+
+			RefRegistry refs;  // native object -> slot in ref_array
+			void* ref_array;  // heap_stash.dukglue_ref_array
+
+			ProtoCache proto_cache;
+			void* prototypes_array;  // heap_stash.dukglue_prototypes
+
+			void* dukvalue_ref_array;  // heap_stash.dukglue_dukvalue_refs
+
+			void* native_finalizer;  // heap_stash.dukglue_native_finalizer (see RefManager::push_native_object_finalizer)
+
+			// Object.prototype.toString as it was when the state was created, or NULL if it wasn't a function
+			// (heap_stash.dukglue_object_to_string, see TypedArray::is_typed_array)
+			void* object_to_string;
+
+			// DUKGLUE_STRUCT id -> interned property names (see dukstruct.h).
+			// Borrowed heap pointers, the strings are kept alive by interned_keys_array.
+			std::vector< std::vector<void*> > struct_keys;
+			void* interned_keys_array;  // heap_stash.dukglue_interned_keys
+
+			uint32_t epoch;  // tag for newly registered objects (see dukglue_set_epoch)
+
+			// for native headers (see detail_native_header.h) and dukglue::PoolAllocator
+			inline ObjectPool* object_pool() {
+				return pool_;
+			}
+
+			// Returns ctx's object pool, for freeing things from finalizers. Unlike find(), this still
+			// works while the heap is being destroyed after the state is gone (the pool outlives the state
+			// until everything allocated from it has been freed, see ObjectPool::release).
+			static ObjectPool* find_object_pool(duk_context* ctx)
+			{
+				ContextState* state = find(ctx);
+				if (state != nullptr)
+					return state->pool_;
+
+				duk_push_heap_stash(ctx);
+				duk_get_prop_string(ctx, -1, "dukglue_object_pool");
+				ObjectPool* pool = static_cast<ObjectPool*>(duk_get_pointer(ctx, -1));
+				duk_pop_2(ctx);
+				return pool;
+			}
+
+			// Returns the state for ctx's heap, creating it if necessary.
+			static ContextState* get(duk_context* ctx)
+			{
+				void* key = stash_key(ctx);
+				ContextState* state = lookup(key);
+				if (state == nullptr)
+					state = create(ctx, key);
+
+				return state;
+			}
+
+			// Returns the state for ctx's heap, or NULL if it has not been created yet
+			// (or has already been destroyed). Use this where creating the state would
+			// be pointless, e.g. when freeing things from a finalizer.
+			static ContextState* find(duk_context* ctx)
+			{
+				return lookup(stash_key(ctx));
+			}
+
+		private:
+			ContextState() : ref_array(nullptr), prototypes_array(nullptr), dukvalue_ref_array(nullptr), native_finalizer(nullptr), object_to_string(nullptr), interned_keys_array(nullptr), epoch(0), key_(nullptr), pool_(nullptr) {}
+
+			~ContextState() {
+				// (the pool may outlive us, see ObjectPool::release)
+				pool_->release();
+			}
+
+			void* key_;
+			ObjectPool* pool_;
+
+			// Frees the native headers of registered objects that have no finalizer to do it
+			// (defined in detail_native_header.h). Called just before the state is destroyed.
+			static void release_native_headers(duk_context* ctx, ContextState* state);
+
+			struct Registry {
+				Registry() : generation(1) {}
+
+				std::mutex mutex;
+				std::unordered_map<void*, ContextState*> states;
+
+				// bumped whenever a state is destroyed, so thread-local caches can't
+				// hand out a destroyed state (even if a new heap reuses the same address)
+				std::atomic<unsigned int> generation;
+			};
+
+			struct LocalCache {
+				void* key;
+				ContextState* state;
+				unsigned int generation;
+			};
+
+			static Registry& registry()
+			{
+				static Registry r;
+				return r;
+			}
+
+			static LocalCache& local_cache()
+			{
+				static thread_local LocalCache cache = { nullptr, nullptr, 0 };
+				return cache;
+			}
+
+			// the heap stash is unique to each heap (and shared by all of its threads),
+			// so its address identifies the heap
+			static inline void* stash_key(duk_context* ctx)
+			{
+				duk_push_heap_stash(ctx);
+				void* key = duk_get_heapptr(ctx, -1);
+				duk_pop(ctx);
+				return key;
+			}
+
+			static ContextState* lookup(void* key)
+			{
+				Registry& reg = registry();
+				LocalCache& cache = local_cache();
+
+				const unsigned int generation = reg.generation.load(std::memory_order_acquire);
+				if (cache.key == key && cache.generation == generation)
+					return cache.state;
+
+				ContextState* state = nullptr;
+				{
+					std::lock_guard<std::mutex> lock(reg.mutex);
+					auto it = reg.states.find(key);
+					if (it != reg.states.end())
+						state = it->second;
+				}
+
+				if (state != nullptr) {
+					cache.key = key;
+					cache.state = state;
+					cache.generation = generation;
+				}
+
+				return state;
+			}
+
+			static ContextState* create(duk_context* ctx, void* key)
+			{
+				ContextState* state = new ContextState();
+				state->key_ = key;
+				state->pool_ = new ObjectPool();
+
+				duk_push_heap_stash(ctx);
+
+				duk_push_pointer(ctx, state->pool_);
+				duk_put_prop_string(ctx, -2, "dukglue_object_pool");
+
+				state->ref_array = push_stash_array(ctx, "dukglue_ref_array", false);
+				state->prototypes_array = push_stash_array(ctx, "dukglue_prototypes", false);
+				state->dukvalue_ref_array = push_stash_array(ctx, "dukglue_dukvalue_refs", true);
+				state->interned_keys_array = push_stash_array(ctx, "dukglue_interned_keys", false);
+
+				duk_get_global_string(ctx, "Object");
+				if (duk_is_object(ctx, -1)) {
+					duk_get_prop_string(ctx, -1, "prototype");
+					duk_get_prop_string(ctx, -1, "toString");
+					if (duk_is_function(ctx, -1)) {
+						state->object_to_string = duk_get_heapptr(ctx, -1);
+						duk_dup_top(ctx);
+						duk_put_prop_string(ctx, -5, "dukglue_object_to_string");
+					}
+					duk_pop_2(ctx);
+				}
+				duk_pop(ctx);
+
+				// sentinel object - frees the state when the heap is destroyed
+				duk_push_object(ctx);
+				duk_push_pointer(ctx, state);
+				duk_put_prop_string(ctx, -2, "ptr");
+				duk_push_c_function(ctx, state_finalizer, 1);
+				duk_set_finalizer(ctx, -2);
+				duk_put_prop_string(ctx, -2, "dukglue_state");
+
+				duk_pop(ctx);  // pop heap stash
+
+				std::lock_guard<std::mutex> lock(registry().mutex);
+				registry().states[key] = state;
+				return state;
+			}
+
+			// Stack: ... [heap_stash]  ->  ... [heap_stash]
+			// Creates heap_stash[name] (if it does not exist yet) and returns its heap pointer.
+			// Free-list arrays start with arr[0] = 0 (empty free list).
+			static void* push_stash_array(duk_context* ctx, const char* name, bool free_list)
+			{
+				if (!duk_get_prop_string(ctx, -1, name)) {
+					duk_pop(ctx);
+					duk_push_array(ctx);
+
+					if (free_list) {
+						duk_push_int(ctx, 0);
+						duk_put_prop_index(ctx, -2, 0);
+					}
+
+					duk_dup_top(ctx);
+					duk_put_prop_string(ctx, -3, name);
+				}
+
+				void* ptr = duk_get_heapptr(ctx, -1);
+				duk_pop(ctx);
+				return ptr;
+			}
+
+			static duk_ret_t state_finalizer(duk_context* ctx)
+			{
+				duk_get_prop_string(ctx, 0, "ptr");
+				ContextState* state = static_cast<ContextState*>(duk_get_pointer(ctx, -1));
+				duk_pop(ctx);
+
+				if (state != nullptr) {
+					release_native_headers(ctx, state);
+
+					Registry& reg = registry();
+					{
+						std::lock_guard<std::mutex> lock(reg.mutex);
+						reg.states.erase(state->key_);
+						reg.generation.fetch_add(1, std::memory_order_acq_rel);
+					}
+					delete state;
+
+					// in case this finalizer runs again
+					duk_push_pointer(ctx, nullptr);
+					duk_put_prop_string(ctx, 0, "ptr");
+				}
+
+				return 0;
+			}
+		};
+	}
+}
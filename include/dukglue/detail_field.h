@@ -0,0 +1,173 @@
+#pragma once
+
+#include "detail_method.h"
+#include "detail_magic_table.h"
+
+#include <type_traits>
+
+namespace dukglue
+{
+	namespace detail
+	{
+		// Accessors for data members registered with dukglue_register_field (see register_property.h).
+		// There is no MethodHolder and no argument tuple: the getter pushes obj->*field directly,
+		// and the setter reads argument 0 straight into obj->*field.
+
+		// How a field is pushed and read depends on its type:
+		//   - value types (int, float, std::string, your own DukType specializations, ...) and
+		//     pointers to native objects are pushed and read like method return values / arguments
+		//   - native objects embedded in the class ("Vec3 position;") are pushed as a script object
+		//     that refers to the member itself, so script can modify it in place (obj.position.x = 1).
+		//     These script objects are not put in the native object registry (an embedded object at
+		//     offset 0 has the same address as its parent), so every read gives a new script object.
+		//     It holds a reference to the parent's script object, so a parent owned by script
+		//     (dukglue_register_constructor_managed) isn't collected while the field is still in use.
+		//     Once the parent is invalidated (or deleted from script), using the field throws just like
+		//     using the parent would (see NativeHeader::EMBEDDED).
+		//     Assigning to an embedded field copy-assigns from the native object on the right.
+		template<class Cls, typename FieldT>
+		struct FieldInfo
+		{
+			typedef FieldT Cls::*FieldType;
+			typedef typename dukglue::types::Bare<FieldT>::type BareType;
+
+			typedef std::integral_constant<bool, dukglue::types::DukType<BareType>::IsValueType::value
+				|| std::is_pointer<FieldT>::value> IsDirect;
+
+			typedef std::is_const<FieldT> IsReadOnly;
+
+			static inline void push_field(duk_context* ctx, Cls* obj, FieldType field)
+			{
+				push_field(ctx, obj, field, IsDirect());
+			}
+
+			static inline void read_field(duk_context* ctx, Cls* obj, FieldType field)
+			{
+				// the script string is only kept alive for the duration of the call
+				static_assert(!std::is_same<BareType, const char*>::value,
+					"const char* fields can only be registered read-only");
+
+				read_field(ctx, obj, field, IsDirect());
+			}
+
+			// field pointer stored in MagicTable<FieldType>
+			struct FieldMagic
+			{
+				static duk_ret_t get(duk_context* ctx)
+				{
+					const FieldType field = MagicTable<FieldType>::get(duk_get_current_magic(ctx));
+					push_field(ctx, get_native_this<Cls>(ctx), field);
+					return 1;
+				}
+
+				static duk_ret_t set(duk_context* ctx)
+				{
+					const FieldType field = MagicTable<FieldType>::get(duk_get_current_magic(ctx));
+					read_field(ctx, get_native_this<Cls>(ctx), field);
+					return 0;
+				}
+			};
+
+			// field pointer as a template argument, so the member offset is a constant
+			template<FieldType field>
+			struct FieldCompiletime
+			{
+				static duk_ret_t get(duk_context* ctx)
+				{
+					push_field(ctx, get_native_this<Cls>(ctx), field);
+					return 1;
+				}
+
+				static duk_ret_t set(duk_context* ctx)
+				{
+					read_field(ctx, get_native_this<Cls>(ctx), field);
+					return 0;
+				}
+			};
+
+			// Defines the accessor property name (Accessors::get / Accessors::set, both with magic)
+			// on the prototype at proto_idx. Read-only fields (and const fields, which can't be assigned
+			// so Accessors::set must not be instantiated for them) get a setter that throws instead.
+			template<typename Accessors, bool readOnly>
+			static void define_property(duk_context* ctx, duk_idx_t proto_idx, const char* name, duk_int_t magic)
+			{
+				proto_idx = duk_normalize_index(ctx, proto_idx);
+
+				duk_push_string(ctx, name);
+
+				duk_push_c_function(ctx, Accessors::get, 0);
+				duk_set_magic(ctx, -1, magic);
+
+				duk_push_c_function(ctx, setter<Accessors>(std::integral_constant<bool, readOnly || IsReadOnly::value>()), 1);
+				duk_set_magic(ctx, -1, magic);
+
+				duk_uint_t flags = DUK_DEFPROP_HAVE_GETTER
+					| DUK_DEFPROP_HAVE_SETTER
+					| DUK_DEFPROP_HAVE_CONFIGURABLE /* set not configurable (from JS) */
+					| DUK_DEFPROP_FORCE /* allow overriding built-ins and previously defined properties */;
+
+				duk_def_prop(ctx, proto_idx, flags);
+			}
+
+		private:
+			static inline void push_field(duk_context* ctx, Cls* obj, FieldType field, std::true_type /* direct */)
+			{
+				dukglue::types::DukType<BareType>::template push<FieldT>(ctx, obj->*field);
+			}
+
+			// (only called from getters, where this is the parent)
+			static inline void push_field(duk_context* ctx, Cls* obj, FieldType field, std::false_type /* embedded */)
+			{
+				typedef typename std::remove_const<FieldT>::type MutableT;
+				ProtoManager::make_script_object<MutableT>(ctx, const_cast<MutableT*>(&(obj->*field)), NativeHeader::EMBEDDED);
+
+				// not registered, so this is what frees its native header
+				RefManager::push_native_object_finalizer(ctx);
+				duk_set_finalizer(ctx, -2);
+
+				// keep the parent alive, and let the header check that it's still valid
+				duk_push_this(ctx);
+				duk_put_prop_string(ctx, -2, "\xFF" "parent");
+			}
+
+			static inline void read_field(duk_context* ctx, Cls* obj, FieldType field, std::true_type /* direct */)
+			{
+				using namespace dukglue::types;
+				obj->*field = DukType<BareType>::template read<typename ArgStorage<FieldT>::type>(ctx, 0);
+			}
+
+			static inline void read_field(duk_context* ctx, Cls* obj, FieldType field, std::false_type /* embedded */)
+			{
+				obj->*field = dukglue::types::DukType<BareType>::template read<BareType&>(ctx, 0);
+			}
+
+			template<typename Accessors>
+			static inline duk_c_function setter(std::false_type /* read-only */)
+			{
+				return Accessors::set;
+			}
+
+			template<typename Accessors>
+			static inline duk_c_function setter(std::true_type /* read-only */)
+			{
+				return throw_read_only;
+			}
+
+			static duk_ret_t throw_read_only(duk_context* ctx)
+			{
+				duk_error(ctx, DUK_ERR_TYPE_ERROR, "Property is read-only.");
+			}
+		};
+
+		// FieldPointer<int Point::*>::Cls == Point, FieldPointer<int Point::*>::FieldT == int
+		template<typename T>
+		struct FieldPointer;
+
+		template<class C, typename F>
+		struct FieldPointer<F C::*>
+		{
+			typedef C Cls;
+			typedef F FieldT;
+		};
+	}
+}
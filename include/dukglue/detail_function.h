@@ -1,6 +1,9 @@
 #pragma once
 
 #include "detail_stack.h"
+#include "detail_magic_table.h"
+
+#include <utility>
 
 namespace dukglue
 {
@@ -25,7 +28,7 @@ namespace dukglue
 				static duk_ret_t call_native_function(duk_context* ctx)
 				{
                     auto bakedArgs = dukglue::detail::get_stack_values<Ts...>(ctx);
-					actually_call(ctx, bakedArgs);
+					actually_call(ctx, std::move(bakedArgs));
 					return std::is_void<RetType>::value ? 0 : 1;
 				}
 
@@ -33,22 +36,22 @@ namespace dukglue
 				// this mess is to support functions with void return values
 
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, std::tuple<BakedTs...>&& args)
 				{
 					// ArgStorage has some static_asserts in it that validate value types,
 					// so we typedef it to force ArgStorage<RetType> to compile and run the asserts
 					typedef typename dukglue::types::ArgStorage<RetType>::type ValidateReturnType;
 
-					RetType return_val = dukglue::detail::apply_fp(funcToCall, args);
+					RetType return_val = dukglue::detail::apply_fp(funcToCall, std::move(args));
 
 					using namespace dukglue::types;
 					DukType<typename Bare<RetType>::type>::template push<RetType>(ctx, std::move(return_val));
 				}
 
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, std::tuple<BakedTs...>&& args)
 				{
-					dukglue::detail::apply_fp(funcToCall, args);
+					dukglue::detail::apply_fp(funcToCall, std::move(args));
 				}
 			};
 
@@ -77,22 +80,52 @@ namespace dukglue
 
 				// this mess is to support functions with void return values
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, RetType(*funcToCall)(Ts...), const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, RetType(*funcToCall)(Ts...), std::tuple<BakedTs...>&& args)
 				{
 					// ArgStorage has some static_asserts in it that validate value types,
 					// so we typedef it to force ArgStorage<RetType> to compile and run the asserts
 					typedef typename dukglue::types::ArgStorage<RetType>::type ValidateReturnType;
 
-					RetType return_val = dukglue::detail::apply_fp(funcToCall, args);
+					RetType return_val = dukglue::detail::apply_fp(funcToCall, std::move(args));
 
 					using namespace dukglue::types;
 					DukType<typename Bare<RetType>::type>::template push<RetType>(ctx, std::move(return_val));
 				}
 
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, RetType(*funcToCall)(Ts...), const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, RetType(*funcToCall)(Ts...), std::tuple<BakedTs...>&& args)
+				{
+					dukglue::detail::apply_fp(funcToCall, std::move(args));
+				}
+			};
+
+			struct FuncMagic
+			{
+				// Pull the function to call out of MagicTable<FuncType>, indexed by
+				// the Duktape function's magic value. Unlike FuncRuntime, this does
+				// not touch the current function object at all.
+				static duk_ret_t call_native_function(duk_context* ctx)
+				{
+					FuncType funcToCall = MagicTable<FuncType>::get(duk_get_current_magic(ctx));
+
+					FuncRuntime::actually_call(ctx, funcToCall, dukglue::detail::get_stack_values<Ts...>(ctx));
+					return std::is_void<RetType>::value ? 0 : 1;
+				}
+			};
+
+			// Like FuncMagic, but the table entry also holds default values for the last
+			// arguments (see dukglue::defaults).
+			template<typename... DefaultTs>
+			struct FuncDefaults
+			{
+				typedef std::pair<FuncType, std::tuple<DefaultTs...> > Bound;
+
+				static duk_ret_t call_native_function(duk_context* ctx)
 				{
-					dukglue::detail::apply_fp(funcToCall, args);
+					const Bound& bound = MagicTable<Bound>::get(duk_get_current_magic(ctx));
+
+					FuncRuntime::actually_call(ctx, bound.first, dukglue::detail::get_stack_values<Ts...>(ctx, bound.second));
+					return std::is_void<RetType>::value ? 0 : 1;
 				}
 			};
 		};
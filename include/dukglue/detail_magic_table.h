@@ -0,0 +1,128 @@
+#pragma once
+
+#include <duktape.h>
+
+#include <mutex>
+
+namespace dukglue
+{
+	namespace detail
+	{
+		// Duktape lets every C function carry a 16-bit "magic" value, which can be read
+		// back with duk_get_current_magic() without touching any properties.
+		// MagicTable<T> is an append-only table of T values addressed by that magic value,
+		// so a native function can recover its "bound" data (a function pointer, a method
+		// pointer, ...) with a single array index instead of a hidden property lookup.
+
+		// The table is process-wide and shared by all Duktape heaps. Entries are never
+		// removed, and interning the same value twice returns the same slot, so registering
+		// the same function into many contexts does not grow the table.
+		// Each T gets its own table, so the 65536 slot limit is per signature.
+
+		// Registration (intern) is guarded by a mutex. Lookups are not - a slot is fully
+		// written before its magic value is handed to Duktape, and chunks never move.
+		template<typename T>
+		class MagicTable
+		{
+		public:
+			// Returns the magic value for value, adding it to the table if necessary.
+			// Throws a RangeError through Duktape if the table is full.
+			static duk_int_t intern(duk_context* ctx, const T& value)
+			{
+				unsigned int idx = MAX_SLOTS;
+				{
+					Storage& s = storage();
+					std::lock_guard<std::mutex> lock(s.mutex);
+
+					for (unsigned int i = 0; i < s.size && idx == MAX_SLOTS; i++) {
+						if (at(s, i) == value)
+							idx = i;
+					}
+
+					if (idx == MAX_SLOTS)
+						idx = append(s, value);
+				}
+
+				return to_magic(ctx, idx);
+			}
+
+			// Same as intern, but always creates a new slot.
+			// Useful for values that can't (or shouldn't) be compared.
+			static duk_int_t add(duk_context* ctx, const T& value)
+			{
+				unsigned int idx;
+				{
+					Storage& s = storage();
+					std::lock_guard<std::mutex> lock(s.mutex);
+					idx = append(s, value);
+				}
+
+				return to_magic(ctx, idx);
+			}
+
+			static inline const T& get(duk_int_t magic)
+			{
+				const unsigned int idx = static_cast<unsigned int>(magic) & 0xFFFF;
+				return storage().chunks[idx >> CHUNK_BITS][idx & (CHUNK_SIZE - 1)];
+			}
+
+		private:
+			static const unsigned int CHUNK_BITS = 8;
+			static const unsigned int CHUNK_SIZE = 1 << CHUNK_BITS;
+			static const unsigned int MAX_SLOTS = 0x10000;
+
+			struct Storage {
+				Storage() : size(0) {
+					for (unsigned int i = 0; i < MAX_SLOTS / CHUNK_SIZE; i++)
+						chunks[i] = nullptr;
+				}
+
+				~Storage() {
+					for (unsigned int i = 0; i < MAX_SLOTS / CHUNK_SIZE; i++)
+						delete[] chunks[i];
+				}
+
+				std::mutex mutex;
+				unsigned int size;
+				T* chunks[MAX_SLOTS / CHUNK_SIZE];
+			};
+
+			static Storage& storage()
+			{
+				static Storage s;
+				return s;
+			}
+
+			static inline T& at(Storage& s, unsigned int idx)
+			{
+				return s.chunks[idx >> CHUNK_BITS][idx & (CHUNK_SIZE - 1)];
+			}
+
+			// magic is stored by Duktape as a signed 16-bit integer
+			// (the error is raised here, after the mutex has been released,
+			// since duk_error may longjmp past the lock_guard)
+			static duk_int_t to_magic(duk_context* ctx, unsigned int idx)
+			{
+				if (idx >= MAX_SLOTS)
+					duk_error(ctx, DUK_ERR_RANGE_ERROR, "Too many native functions with the same signature (max %d)", (int) MAX_SLOTS);
+
+				return idx < 0x8000 ? static_cast<duk_int_t>(idx) : static_cast<duk_int_t>(idx) - 0x10000;
+			}
+
+			// returns MAX_SLOTS if the table is full
+			static unsigned int append(Storage& s, const T& value)
+			{
+				if (s.size >= MAX_SLOTS)
+					return MAX_SLOTS;
+
+				const unsigned int idx = s.size;
+				if (s.chunks[idx >> CHUNK_BITS] == nullptr)
+					s.chunks[idx >> CHUNK_BITS] = new T[CHUNK_SIZE]();
+
+				at(s, idx) = value;
+				s.size++;
+				return idx;
+			}
+		};
+	}
+}
@@ -1,11 +1,32 @@
 #pragma once
 
 #include "detail_stack.h"
+#include "detail_magic_table.h"
+#include "detail_shared_accessor.h"
+
+#include <utility>
 
 namespace dukglue
 {
 	namespace detail
 	{
+		// Returns the native object 'this' refers to (this.\xFFnative->obj), as a Cls*.
+		// Throws a ReferenceError if 'this' is not a native object, has been invalidated,
+		// or is not a Cls (e.g. a method was called on an unrelated native object).
+		template<class Cls>
+		inline Cls* get_native_this(duk_context* ctx)
+		{
+			duk_push_this(ctx);
+			NativeHeader* header = NativeHeader::get(ctx, -1);
+			duk_pop(ctx);
+
+			Cls* obj = (header != nullptr) ? header->type_info->cast<Cls>(header->obj) : nullptr;
+			if (obj == nullptr)
+				duk_error(ctx, DUK_RET_REFERENCE_ERROR, "Invalid native object for 'this'");
+
+			return obj;
+		}
+
 		template<bool isConst, class Cls, typename RetType, typename... Ts>
 		struct MethodInfo
 		{
@@ -25,44 +46,33 @@ namespace dukglue
 			{
 				static duk_ret_t call_native_method(duk_context* ctx)
 				{
-					// get this.obj_ptr
-					duk_push_this(ctx);
-					duk_get_prop_string(ctx, -1, "\xFF" "obj_ptr");
-					void* obj_void = duk_require_pointer(ctx, -1);
-					if (obj_void == nullptr) {
-						duk_error(ctx, DUK_RET_REFERENCE_ERROR, "Native object missing.");
-						return DUK_RET_REFERENCE_ERROR;
-					}
-
-					duk_pop_2(ctx);
-
-					// (should always be valid unless someone is intentionally messing with this.obj_ptr...)
-					Cls* obj = static_cast<Cls*>(obj_void);
+					// (should always be valid unless someone is intentionally messing with this.\xFFnative...)
+					Cls* obj = get_native_this<Cls>(ctx);
 
 					// read arguments and call function
                     auto bakedArgs = dukglue::detail::get_stack_values<Ts...>(ctx);
-					actually_call(ctx, obj, bakedArgs);
+					actually_call(ctx, obj, std::move(bakedArgs));
 					return std::is_void<RetType>::value ? 0 : 1;
 				}
 
 				// this mess is to support functions with void return values
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, Cls* obj, const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, Cls* obj, std::tuple<BakedTs...>&& args)
 				{
 					// ArgStorage has some static_asserts in it that validate value types,
 					// so we typedef it to force ArgStorage<RetType> to compile and run the asserts
 					typedef typename dukglue::types::ArgStorage<RetType>::type ValidateReturnType;
 
-					RetType return_val = dukglue::detail::apply_method<Cls, RetType, Ts...>(methodToCall, obj, args);
+					RetType return_val = dukglue::detail::apply_method<Cls, RetType, Ts...>(methodToCall, obj, std::move(args));
 
 					using namespace dukglue::types;
 					DukType<typename Bare<RetType>::type>::template push<RetType>(ctx, std::move(return_val));
 				}
 
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, Cls* obj, const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, Cls* obj, std::tuple<BakedTs...>&& args)
 				{
-					dukglue::detail::apply_method(methodToCall, obj, args);
+					dukglue::detail::apply_method(methodToCall, obj, std::move(args));
 				}
 			};
 
@@ -83,16 +93,8 @@ namespace dukglue
 
 				static duk_ret_t call_native_method(duk_context* ctx)
 				{
-					// get this.obj_ptr
-					duk_push_this(ctx);
-					duk_get_prop_string(ctx, -1, "\xFF" "obj_ptr");
-					void* obj_void = duk_get_pointer(ctx, -1);
-					if (obj_void == nullptr) {
-						duk_error(ctx, DUK_RET_REFERENCE_ERROR, "Invalid native object for 'this'");
-						return DUK_RET_REFERENCE_ERROR;
-					}
-
-					duk_pop_2(ctx); // pop this.obj_ptr and this
+					// (should always be valid unless someone is intentionally messing with this.\xFFnative...)
+					Cls* obj = get_native_this<Cls>(ctx);
 
 					// get current_function.method_info
 					duk_push_current_function(ctx);
@@ -105,34 +107,90 @@ namespace dukglue
 
 					duk_pop_2(ctx);
 
-					// (should always be valid unless someone is intentionally messing with this.obj_ptr...)
-					Cls* obj = static_cast<Cls*>(obj_void);
 					MethodHolder* method_holder = static_cast<MethodHolder*>(method_holder_void);
 
 					// read arguments and call method
                     auto bakedArgs = dukglue::detail::get_stack_values<Ts...>(ctx);
-					actually_call(ctx, method_holder->method, obj, bakedArgs);
+					actually_call(ctx, method_holder->method, obj, std::move(bakedArgs));
 					return std::is_void<RetType>::value ? 0 : 1;
 				}
 
 				// this mess is to support functions with void return values
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, MethodType method, Cls* obj, const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<!std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, MethodType method, Cls* obj, std::tuple<BakedTs...>&& args)
 				{
 					// ArgStorage has some static_asserts in it that validate value types,
 					// so we typedef it to force ArgStorage<RetType> to compile and run the asserts
 					typedef typename dukglue::types::ArgStorage<RetType>::type ValidateReturnType;
 
-					RetType return_val = dukglue::detail::apply_method<Cls, RetType, Ts...>(method, obj, args);
+					RetType return_val = dukglue::detail::apply_method<Cls, RetType, Ts...>(method, obj, std::move(args));
 
 					using namespace dukglue::types;
 					DukType<typename Bare<RetType>::type>::template push<RetType>(ctx, std::move(return_val));
 				}
 
 				template<typename Dummy = RetType, typename... BakedTs>
-				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, MethodType method, Cls* obj, const std::tuple<BakedTs...>& args)
+				static typename std::enable_if<std::is_void<Dummy>::value>::type actually_call(duk_context* ctx, MethodType method, Cls* obj, std::tuple<BakedTs...>&& args)
 				{
-					dukglue::detail::apply_method(method, obj, args);
+					dukglue::detail::apply_method(method, obj, std::move(args));
+				}
+			};
+
+			// Same as MethodRuntime, but the method pointer is kept in MagicTable<MethodType>
+			// and found through the function's magic value. No MethodHolder is allocated,
+			// so the function object needs no "method_holder" property and no finalizer.
+			struct MethodMagic
+			{
+				static duk_ret_t call_native_method(duk_context* ctx)
+				{
+					// (should always be valid unless someone is intentionally messing with this.\xFFnative...)
+					Cls* obj = get_native_this<Cls>(ctx);
+
+					MethodType method = MagicTable<MethodType>::get(duk_get_current_magic(ctx));
+
+					// read arguments and call method
+					auto bakedArgs = dukglue::detail::get_stack_values<Ts...>(ctx);
+					MethodRuntime::actually_call(ctx, method, obj, std::move(bakedArgs));
+					return std::is_void<RetType>::value ? 0 : 1;
+				}
+			};
+
+			// Like MethodMagic, but the table entry also holds default values for the last
+			// arguments (see dukglue::defaults).
+			template<typename... DefaultTs>
+			struct MethodDefaults
+			{
+				typedef std::pair<MethodType, std::tuple<DefaultTs...> > Bound;
+
+				static duk_ret_t call_native_method(duk_context* ctx)
+				{
+					// (should always be valid unless someone is intentionally messing with this.\xFFnative...)
+					Cls* obj = get_native_this<Cls>(ctx);
+
+					const Bound& bound = MagicTable<Bound>::get(duk_get_current_magic(ctx));
+
+					// read arguments and call method
+					auto bakedArgs = dukglue::detail::get_stack_values<Ts...>(ctx, bound.second);
+					MethodRuntime::actually_call(ctx, bound.first, obj, std::move(bakedArgs));
+					return std::is_void<RetType>::value ? 0 : 1;
+				}
+			};
+
+			// Property accessor shared by several properties (see detail_shared_accessor.h).
+			// The property key is passed after the arguments, and selects the method pointer.
+			struct MethodShared
+			{
+				static duk_ret_t call_native_method(duk_context* ctx)
+				{
+					// (should always be valid unless someone is intentionally messing with this.\xFFnative...)
+					Cls* obj = get_native_this<Cls>(ctx);
+
+					MethodType method = MagicTable<MethodType>::get(SharedAccessor::current_magic(ctx, sizeof...(Ts)));
+
+					// read arguments and call method
+					auto bakedArgs = dukglue::detail::get_stack_values<Ts...>(ctx);
+					MethodRuntime::actually_call(ctx, method, obj, std::move(bakedArgs));
+					return std::is_void<RetType>::value ? 0 : 1;
 				}
 			};
 		};
@@ -150,16 +208,8 @@ namespace dukglue
 
 			static duk_ret_t call_native_method(duk_context* ctx)
 			{
-				// get this.obj_ptr
-				duk_push_this(ctx);
-				duk_get_prop_string(ctx, -1, "\xFF" "obj_ptr");
-				void* obj_void = duk_get_pointer(ctx, -1);
-				if (obj_void == nullptr) {
-					duk_error(ctx, DUK_RET_REFERENCE_ERROR, "Invalid native object for 'this'");
-					return DUK_RET_REFERENCE_ERROR;
-				}
-
-				duk_pop_2(ctx);  // pop this.obj_ptr and this
+				// (should always be valid unless someone is intentionally messing with this.\xFFnative...)
+				Cls* obj = get_native_this<Cls>(ctx);
 
 				// get current_function.method_info
 				duk_push_current_function(ctx);
@@ -172,12 +222,21 @@ namespace dukglue
 
 				duk_pop_2(ctx);
 
-				// (should always be valid unless someone is intentionally messing with this.obj_ptr...)
-				Cls* obj = static_cast<Cls*>(obj_void);
 				MethodHolderVariadic* method_holder = static_cast<MethodHolderVariadic*>(method_holder_void);
 
 				return (*obj.*method_holder->method)(ctx);
 			}
+
+			// method pointer comes from MagicTable instead of current_function.method_holder
+			static duk_ret_t call_native_method_magic(duk_context* ctx)
+			{
+				// (should always be valid unless someone is intentionally messing with this.\xFFnative...)
+				Cls* obj = get_native_this<Cls>(ctx);
+
+				typename MethodInfoVariadic::MethodType method = MagicTable<typename MethodInfoVariadic::MethodType>::get(duk_get_current_magic(ctx));
+
+				return (*obj.*method)(ctx);
+			}
 		};
 	}
 }
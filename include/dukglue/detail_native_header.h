@@ -0,0 +1,305 @@
+#pragma once
+
+#include "detail_typeinfo.h"
+#include "detail_context_state.h"
+
+#include <duktape.h>
+#include <stdint.h>
+#include <new>
+
+namespace dukglue
+{
+	namespace detail
+	{
+		struct NativeHeaderExt;
+
+		// Every script object that wraps a native object carries exactly one NativeHeader,
+		// pointed to by script_object.\xFFnative. This replaces the old \xFFobj_ptr property
+		// (plus the \xFFtype_info lookup through the prototype chain, plus \xFFshared_ptr for
+		// shared_ptr objects): reading a native argument is now one property lookup instead
+		// of two or three.
+
+		// Headers are allocated from the context's ObjectPool (see ContextState::object_pool),
+		// so a wrapper costs one pointer property (which doesn't grow its property table) plus
+		// a 16 byte pool entry, with no extra Duktape allocation.
+
+		// Whoever frees a header also sets \xFFnative to NULL, so a script object never refers
+		// to a freed header:
+		//  - plain headers of registered objects are freed when the object is invalidated
+		//    (see invalidate), or when the heap is destroyed (see ContextState::release_native_headers);
+		//    these wrappers don't need a finalizer, which keeps dropping them as cheap as before.
+		//  - every other header is freed by its wrapper's finalizer (see RefManager::release_native_header):
+		//    the managed finalizer, the shared_ptr finalizer, the weak ref finalizer, or the one
+		//    embedded field wrappers get (see RefManager::push_native_object_finalizer).
+		// If the pool is still in use when the heap is destroyed, it outlives the ContextState
+		// (see ObjectPool::release) until the last of those finalizers has run. A wrapper whose
+		// finalizer is replaced from script (Duktape.fin) leaks its header.
+
+		// Plain wrappers (most of them) only get the two pointers below. Wrappers that own
+		// their object, or are registered weakly, get a NativeHeaderExt instead, which adds
+		// the ownership data; the low bit of the \xFFnative pointer tells the two apart.
+		struct NativeHeader
+		{
+			// (only NativeHeaderExt has flags)
+			enum Flags : uint32_t {
+				// the native object belongs to the script object (see dukglue_register_constructor_managed)
+				MANAGED = 1 << 0,
+
+				// owner points to a heap-allocated std::shared_ptr<T> (see DukType< std::shared_ptr<T> >)
+				SHARED_PTR = 1 << 1,
+
+				// the script object is registered weakly (not pinned in ref_array), at ref_slot
+				// (see dukglue_set_weak_refs and RefManager::release_native_header)
+				WEAK = 1 << 2,
+
+				// obj is stored in this pool entry, right after the header (see create_with_storage)
+				INLINE = 1 << 3,
+
+				// obj is a member of the native object of the script object in \xFFparent, so it is only
+				// valid while that is (see FieldInfo::push_field and get)
+				EMBEDDED = 1 << 4,
+			};
+
+			void* obj;  // the native object; NULL if the object has been invalidated
+			const TypeInfo* type_info;  // the type obj points to (used for type checking)
+
+			// Create a new header for obj and attach it to the script object at obj_idx.
+			// The header is a NativeHeaderExt if flags is non-zero or type_info uses weak refs.
+			// Does not affect the stack.
+			static NativeHeader* create(duk_context* ctx, duk_idx_t obj_idx, void* obj, const TypeInfo* type_info, uint32_t flags = 0);
+
+			// Returns the header for the script object at idx,
+			// or NULL if the value at idx is not a native object.
+			// If the object is embedded in a parent that has been invalidated, header->obj is NULL.
+			// Does not affect the stack.
+			static NativeHeader* get(duk_context* ctx, duk_idx_t idx)
+			{
+				void* tagged = get_tagged(ctx, idx);
+				if (reinterpret_cast<uintptr_t>(tagged) & EXT_TAG)
+					check_parent(ctx, idx, untag(tagged));
+
+				return untag(tagged);
+			}
+
+			// Same as get(ctx, idx), but also sets ext to the header's ownership data
+			// (NULL if this is a plain header).
+			static NativeHeader* get(duk_context* ctx, duk_idx_t idx, NativeHeaderExt** ext);
+
+			// Same as get(ctx, idx, ext), but NULL if the script object at idx only inherits a header
+			// (e.g. Object.create(wrapper)). For finalizers, which are inherited the same way.
+			static NativeHeader* get_own(duk_context* ctx, duk_idx_t idx, NativeHeaderExt** ext);
+
+			// Frees header (get_own(ctx, idx, &ext)) and removes it from the script object at idx.
+			// Does not affect the stack.
+			static void release(duk_context* ctx, duk_idx_t idx, NativeHeader* header, NativeHeaderExt* ext);
+
+			// Invalidates the registered script object at idx: sets header->obj to NULL, and frees
+			// the header right away if it is a plain one (the others are freed by their finalizers).
+			// Does not affect the stack.
+			static void invalidate(duk_context* ctx, ContextState* state, duk_idx_t idx);
+
+		protected:
+			static const uintptr_t EXT_TAG = 1;  // (pool entries are at least pointer-aligned)
+
+			static inline void* get_tagged(duk_context* ctx, duk_idx_t idx)
+			{
+				duk_get_prop_string(ctx, idx, "\xFF" "native");
+				void* tagged = duk_get_pointer(ctx, -1);
+				duk_pop(ctx);
+				return tagged;
+			}
+
+			static inline NativeHeader* untag(void* tagged)
+			{
+				return reinterpret_cast<NativeHeader*>(reinterpret_cast<uintptr_t>(tagged) & ~EXT_TAG);
+			}
+
+			// If header (an extended one) is EMBEDDED, invalidates it if its parent has been invalidated
+			// (or deleted from script). Checked on every access, since nothing tells the embedded objects
+			// when that happens.
+			static void check_parent(duk_context* ctx, duk_idx_t idx, NativeHeader* header);
+
+			// Allocates size bytes for a header (from the pool if it fits) and attaches it to obj_idx.
+			static void* attach(duk_context* ctx, duk_idx_t obj_idx, size_t size, bool ext)
+			{
+				obj_idx = duk_normalize_index(ctx, obj_idx);
+
+				void* mem = (size <= ObjectPool::MAX_SIZE)
+					? ContextState::get(ctx)->object_pool()->allocate(size)
+					: ::operator new(size);
+
+				duk_push_pointer(ctx, reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(mem) | (ext ? EXT_TAG : 0)));
+				duk_put_prop_string(ctx, obj_idx, "\xFF" "native");
+				return mem;
+			}
+		};
+
+		// A NativeHeader with ownership data, for managed, shared_ptr and weakly registered wrappers.
+		struct NativeHeaderExt : NativeHeader
+		{
+			void* owner;  // ownership data, depends on flags
+			uint32_t flags;
+			union {
+				uint32_t ref_slot;  // registry slot, if flags & WEAK
+				uint32_t inline_size;  // size of the object after the header, if flags & INLINE (never registered)
+			};
+
+			// Create a new extended header for obj and attach it to the script object at obj_idx.
+			// Does not affect the stack.
+			static NativeHeaderExt* create(duk_context* ctx, duk_idx_t obj_idx, void* obj, const TypeInfo* type_info, uint32_t flags)
+			{
+				return init(attach(ctx, obj_idx, sizeof(NativeHeaderExt), true), obj, type_info, flags);
+			}
+
+			// Like create(), but with uninitialized room for a T right after the header, in the same
+			// pool entry (see dukglue::InlineStorage). Sets storage to that memory; header->obj is NULL
+			// until the caller constructs something there.
+			template<typename T>
+			static NativeHeaderExt* create_with_storage(duk_context* ctx, duk_idx_t obj_idx, const TypeInfo* type_info, uint32_t flags, void** storage)
+			{
+				// sizeof(NativeHeaderExt) is a multiple of its alignment, so this keeps T aligned
+				// (pool entries are aligned for pointers, which is all NativeHeaderExt needs)
+				static_assert(alignof(T) <= alignof(NativeHeaderExt), "Over-aligned types can't be stored inline");
+
+				NativeHeaderExt* header = init(attach(ctx, obj_idx, sizeof(NativeHeaderExt) + sizeof(T), true), nullptr, type_info, flags | INLINE);
+				header->inline_size = sizeof(T);
+				*storage = header + 1;
+				return header;
+			}
+
+			// Returns the extended header for the script object at idx,
+			// or NULL if the value at idx is not a native object or only has a plain header.
+			// Does not affect the stack.
+			static NativeHeaderExt* get(duk_context* ctx, duk_idx_t idx)
+			{
+				NativeHeaderExt* ext = nullptr;
+				NativeHeader::get(ctx, idx, &ext);
+				return ext;
+			}
+
+			// size of the pool entry
+			inline size_t alloc_size() const {
+				return sizeof(NativeHeaderExt) + ((flags & INLINE) ? inline_size : 0);
+			}
+
+		private:
+			static NativeHeaderExt* init(void* mem, void* obj, const TypeInfo* type_info, uint32_t flags)
+			{
+				NativeHeaderExt* header = static_cast<NativeHeaderExt*>(mem);
+				header->obj = obj;
+				header->type_info = type_info;
+				header->owner = nullptr;
+				header->flags = flags;
+				header->ref_slot = 0;
+				return header;
+			}
+		};
+
+		inline NativeHeader* NativeHeader::create(duk_context* ctx, duk_idx_t obj_idx, void* obj, const TypeInfo* type_info, uint32_t flags)
+		{
+			if (flags != 0 || type_info->weak_refs())
+				return NativeHeaderExt::create(ctx, obj_idx, obj, type_info, flags);
+
+			NativeHeader* header = static_cast<NativeHeader*>(attach(ctx, obj_idx, sizeof(NativeHeader), false));
+			header->obj = obj;
+			header->type_info = type_info;
+			return header;
+		}
+
+		inline NativeHeader* NativeHeader::get(duk_context* ctx, duk_idx_t idx, NativeHeaderExt** ext)
+		{
+			void* tagged = get_tagged(ctx, idx);
+			NativeHeader* header = untag(tagged);
+			*ext = nullptr;
+
+			if (reinterpret_cast<uintptr_t>(tagged) & EXT_TAG) {
+				*ext = static_cast<NativeHeaderExt*>(header);
+				check_parent(ctx, idx, header);
+			}
+
+			return header;
+		}
+
+		inline void NativeHeader::check_parent(duk_context* ctx, duk_idx_t idx, NativeHeader* header)
+		{
+			if (!(static_cast<NativeHeaderExt*>(header)->flags & EMBEDDED) || header->obj == nullptr)
+				return;
+
+			// (the parent may be embedded itself)
+			duk_get_prop_string(ctx, idx, "\xFF" "parent");
+			NativeHeader* parent = duk_is_object(ctx, -1) ? get(ctx, -1) : nullptr;
+			duk_pop(ctx);
+
+			// (the parent can't become valid again, so this is permanent)
+			if (parent == nullptr || parent->obj == nullptr)
+				header->obj = nullptr;
+		}
+
+		inline NativeHeader* NativeHeader::get_own(duk_context* ctx, duk_idx_t idx, NativeHeaderExt** ext)
+		{
+			NativeHeader* header = get(ctx, idx, ext);
+			if (header == nullptr)
+				return nullptr;
+
+			// an own header shadows any header further up the prototype chain
+			duk_get_prototype(ctx, idx);
+			void* inherited = duk_is_object(ctx, -1) ? get_tagged(ctx, -1) : nullptr;
+			duk_pop(ctx);
+
+			if (untag(inherited) == header) {
+				*ext = nullptr;
+				return nullptr;
+			}
+
+			return header;
+		}
+
+		inline void NativeHeader::release(duk_context* ctx, duk_idx_t idx, NativeHeader* header, NativeHeaderExt* ext)
+		{
+			idx = duk_normalize_index(ctx, idx);
+
+			// (a NULL pointer rather than no property, so nothing is inherited in its place)
+			duk_push_pointer(ctx, nullptr);
+			duk_put_prop_string(ctx, idx, "\xFF" "native");
+
+			const size_t size = (ext != nullptr) ? ext->alloc_size() : sizeof(NativeHeader);
+			if (size <= ObjectPool::MAX_SIZE)
+				ContextState::find_object_pool(ctx)->deallocate(header, size);
+			else
+				::operator delete(header);
+		}
+
+		inline void NativeHeader::invalidate(duk_context* ctx, ContextState* state, duk_idx_t idx)
+		{
+			NativeHeaderExt* ext = nullptr;
+			NativeHeader* header = get(ctx, idx, &ext);
+			if (ext != nullptr) {
+				ext->obj = nullptr;
+			} else if (header != nullptr) {
+				// same as release(), without looking up the pool again
+				idx = duk_normalize_index(ctx, idx);
+				duk_push_pointer(ctx, nullptr);
+				duk_put_prop_string(ctx, idx, "\xFF" "native");
+				state->object_pool()->deallocate(header, sizeof(NativeHeader));
+			}
+		}
+
+		inline void ContextState::release_native_headers(duk_context* ctx, ContextState* state)
+		{
+			const uint32_t slot_count = state->refs.slot_count();
+			for (uint32_t idx = 0; idx < slot_count; idx++) {
+				const RefRegistry::Slot& slot = state->refs[idx];
+				if (slot.obj == nullptr)
+					continue;
+
+				// (extended headers are freed by their finalizers, which may not have run yet)
+				duk_push_heapptr(ctx, slot.heapptr);
+				NativeHeaderExt* ext = nullptr;
+				NativeHeader* header = NativeHeader::get(ctx, -1, &ext);
+				if (header != nullptr && ext == nullptr)
+					NativeHeader::invalidate(ctx, state, -1);
+				duk_pop(ctx);
+			}
+		}
+	}
+}
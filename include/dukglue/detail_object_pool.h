@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+namespace dukglue
+{
+	namespace detail
+	{
+		// Size-class pool for the native headers of script objects (see detail_native_header.h) and for
+		// small objects created by managed constructors (see dukglue::PoolAllocator).
+		// Not thread safe - there is one pool per Duktape heap (in ContextState), which is only
+		// used by one thread at a time anyway.
+
+		// Sizes are rounded up to a multiple of GRANULARITY, and each size class has its own free list.
+		// Allocating is a free list pop, or bumping a pointer through the current chunk;
+		// deallocating is a free list push. Memory is only given back when the pool is destroyed.
+
+		// The pool is destroyed with its heap's ContextState. Script objects can be finalized after
+		// that while the heap is being destroyed, so if anything is still allocated at that point
+		// the pool is orphaned instead, and deletes itself when the last allocation is freed.
+		class ObjectPool
+		{
+		public:
+			static const size_t GRANULARITY = 16;  // also the alignment of every allocation
+			static const size_t MAX_SIZE = 256;  // larger objects don't go through the pool
+			static const size_t CHUNK_SIZE = 64 * 1024;
+
+			ObjectPool() : bump_(nullptr), bump_end_(nullptr), live_(0), orphaned_(false) {
+				for (size_t i = 0; i < NUM_CLASSES; i++)
+					free_[i] = nullptr;
+			}
+
+			ObjectPool(const ObjectPool&) = delete;
+			ObjectPool& operator=(const ObjectPool&) = delete;
+
+			// size must be at most MAX_SIZE
+			void* allocate(size_t size)
+			{
+				const size_t cls = size_class(size);
+				live_++;
+
+				FreeNode* node = free_[cls];
+				if (node != nullptr) {
+					free_[cls] = node->next;
+					return node;
+				}
+
+				const size_t bytes = (cls + 1) * GRANULARITY;
+				if (bump_ == nullptr || static_cast<size_t>(bump_end_ - bump_) < bytes) {
+					// the rest of the current chunk is wasted, but it's less than MAX_SIZE
+					bump_ = static_cast<char*>(::operator new(CHUNK_SIZE));
+					bump_end_ = bump_ + CHUNK_SIZE;
+					chunks_.push_back(bump_);
+				}
+
+				void* ptr = bump_;
+				bump_ += bytes;
+				return ptr;
+			}
+
+			// size must be the size ptr was allocated with
+			void deallocate(void* ptr, size_t size)
+			{
+				FreeNode* node = static_cast<FreeNode*>(ptr);
+				const size_t cls = size_class(size);
+				node->next = free_[cls];
+				free_[cls] = node;
+
+				live_--;
+				if (orphaned_ && live_ == 0)
+					delete this;
+			}
+
+			// memory taken from the global allocator so far
+			inline size_t reserved_bytes() const {
+				return chunks_.size() * CHUNK_SIZE;
+			}
+
+			// Called instead of delete by the pool's owner.
+			void release()
+			{
+				if (live_ == 0)
+					delete this;
+				else
+					orphaned_ = true;
+			}
+
+		private:
+			static const size_t NUM_CLASSES = MAX_SIZE / GRANULARITY;
+
+			struct FreeNode {
+				FreeNode* next;
+			};
+
+			static inline size_t size_class(size_t size) {
+				return (size == 0) ? 0 : (size - 1) / GRANULARITY;
+			}
+
+			~ObjectPool() {
+				for (void* chunk : chunks_)
+					::operator delete(chunk);
+			}
+
+			FreeNode* free_[NUM_CLASSES];
+			char* bump_;
+			char* bump_end_;
+			std::vector<void*> chunks_;
+
+			size_t live_;  // allocations that have not been freed yet
+			bool orphaned_;
+		};
+	}
+}
@@ -0,0 +1,356 @@
+#pragma once
+
+#include "detail_function.h"
+#include "detail_method.h"
+
+#include <stdint.h>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace dukglue
+{
+	// A set of functions (or methods) registered under one name, see dukglue_register_function
+	// and dukglue_register_method. Make one with dukglue::overloads(...).
+	template<typename... Fs>
+	struct Overloads
+	{
+		std::tuple<Fs...> funcs;
+	};
+
+	// Overloaded C++ names need a cast to pick the overload:
+	//   dukglue::overloads(static_cast<int(*)(int)>(&abs), static_cast<double(*)(double)>(&fabs))
+	template<typename... Fs>
+	inline Overloads<Fs...> overloads(Fs... funcs)
+	{
+		static_assert(sizeof...(Fs) > 0, "Expected at least one function");
+		return Overloads<Fs...>{ std::tuple<Fs...>(funcs...) };
+	}
+
+	namespace types
+	{
+		// The Duktape types (DUK_TYPE_MASK_*) DukType<T>::read can accept, used to pick an overload
+		// before reading any arguments. Specialize this for your own value types to make them
+		// distinguishable - the default for value types is "anything", so reading decides.
+		template<typename T, typename Enable = void>
+		struct DukTypeMask {
+			static const duk_uint_t value = std::is_arithmetic<T>::value ? DUK_TYPE_MASK_NUMBER : 0x3FF;
+		};
+
+		template<>
+		struct DukTypeMask<bool> {
+			static const duk_uint_t value = DUK_TYPE_MASK_BOOLEAN;
+		};
+
+		template<>
+		struct DukTypeMask<std::string> {
+			static const duk_uint_t value = DUK_TYPE_MASK_STRING;
+		};
+
+		template<>
+		struct DukTypeMask<const char*> {
+			static const duk_uint_t value = DUK_TYPE_MASK_STRING;
+		};
+
+		template<>
+		struct DukTypeMask<DukStringView> {
+			static const duk_uint_t value = DUK_TYPE_MASK_STRING;
+		};
+
+#ifdef DUKGLUE_HAS_CXX17
+		template<>
+		struct DukTypeMask<std::string_view> {
+			static const duk_uint_t value = DUK_TYPE_MASK_STRING;
+		};
+#endif
+
+		template<typename T>
+		struct DukTypeMask< std::vector<T> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT;
+		};
+
+		template<typename T>
+		struct DukTypeMask< std::map<std::string, T> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT;
+		};
+
+		template<typename K, typename T>
+		struct DukTypeMask< std::unordered_map<K, T> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT;
+		};
+
+		template<typename T, size_t N>
+		struct DukTypeMask< std::array<T, N> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT;
+		};
+
+		template<typename... Ts>
+		struct DukTypeMask< std::tuple<Ts...> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT;
+		};
+
+		template<typename A, typename B>
+		struct DukTypeMask< std::pair<A, B> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT;
+		};
+
+		template<typename T>
+		struct DukTypeMask< DukSpan<T> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT | DUK_TYPE_MASK_BUFFER;
+		};
+
+		template<typename T>
+		struct DukTypeMask< DukSharedBuffer<T> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT | DUK_TYPE_MASK_BUFFER;
+		};
+
+		template<typename T>
+		struct DukTypeMask< std::shared_ptr<T> > {
+			static const duk_uint_t value = DUK_TYPE_MASK_OBJECT | DUK_TYPE_MASK_NULL;
+		};
+
+#ifdef DUKGLUE_HAS_CXX17
+		template<typename T>
+		struct DukTypeMask< std::optional<T> > {
+			static const duk_uint_t value = ArgTypeMask<T>::value | DUK_TYPE_MASK_UNDEFINED | DUK_TYPE_MASK_NULL;
+		};
+
+		template<>
+		struct DukTypeMask<std::monostate> {
+			static const duk_uint_t value = DUK_TYPE_MASK_UNDEFINED | DUK_TYPE_MASK_NULL;
+		};
+
+		template<typename... Ts>
+		struct DukTypeMask< std::variant<Ts...> > {
+			static const duk_uint_t value = (0 | ... | ArgTypeMask<Ts>::value);
+		};
+#endif
+
+		// FullT is an argument type (int, const std::string&, Dog*, ...)
+		template<typename FullT>
+		struct ArgTypeMask {
+		private:
+			typedef typename Bare<FullT>::type BareType;
+			typedef typename DukType<BareType>::IsValueType IsValueType;
+
+		public:
+			// native objects: pointers can also be null
+			static const duk_uint_t value = IsValueType::value ? DukTypeMask<BareType>::value
+				: (DUK_TYPE_MASK_OBJECT | (std::is_pointer<FullT>::value ? DUK_TYPE_MASK_NULL : 0));
+		};
+	}
+
+	namespace detail
+	{
+		// Overload resolution: candidates are tried in registration order, and the first one
+		// whose arity matches duk_get_top() and whose argument type masks accept the argument types wins.
+		// Trailing std::optional arguments can be left out (they read as std::nullopt), so a candidate
+		// matches any argument count from RequiredArgs up to its arity. Default values (dukglue::defaults)
+		// can't be given to functions in an overload set.
+		// The types of the first OVERLOAD_MASK_ARGS arguments are packed into one 64-bit mask
+		// (10 bits per argument, one bit per DUK_TYPE_*) once per call, and each candidate has a
+		// precomputed mask of the types it accepts, so checking a candidate is a compare and an AND.
+		// Arguments past OVERLOAD_MASK_ARGS are checked one by one.
+		// Native objects only match on "object", so when two candidates differ only in which native
+		// class they take, the first one is picked (and fails to read the argument if it's the wrong class).
+		static const duk_idx_t OVERLOAD_MASK_ARGS = 6;
+		static const int OVERLOAD_TYPE_BITS = 10;  // DUK_TYPE_NONE .. DUK_TYPE_LIGHTFUNC
+
+		// accepted types of Ts (starting at argument I), packed like stack_type_mask
+		template<duk_idx_t I, typename... Ts>
+		struct SignatureMask {
+			static const uint64_t value = 0;
+		};
+
+		template<duk_idx_t I, typename T, typename... Ts>
+		struct SignatureMask<I, T, Ts...> {
+			static const uint64_t value = ((I < OVERLOAD_MASK_ARGS)
+				? (static_cast<uint64_t>(dukglue::types::ArgTypeMask<T>::value) << ((I < OVERLOAD_MASK_ARGS ? I : 0) * OVERLOAD_TYPE_BITS))
+				: 0) | SignatureMask<I + 1, Ts...>::value;
+		};
+
+		// one bit per argument, for the first OVERLOAD_MASK_ARGS arguments
+		inline uint64_t stack_type_mask(duk_context* ctx, duk_idx_t nargs)
+		{
+			uint64_t mask = 0;
+			for (duk_idx_t i = 0; i < nargs && i < OVERLOAD_MASK_ARGS; i++)
+				mask |= static_cast<uint64_t>(1) << (duk_get_type(ctx, i) + i * OVERLOAD_TYPE_BITS);
+			return mask;
+		}
+
+		// arguments that can be left out at the end of a call
+		template<typename T>
+		struct IsOmittableArg : std::false_type {};
+
+#ifdef DUKGLUE_HAS_CXX17
+		template<typename T>
+		struct IsOmittableArg< std::optional<T> > : std::true_type {};
+#endif
+
+		// number of arguments up to (and including) the last one that can't be left out
+		template<typename... Ts>
+		struct RequiredArgs {
+			static const duk_idx_t value = 0;
+		};
+
+		template<typename T, typename... Ts>
+		struct RequiredArgs<T, Ts...> {
+			static const duk_idx_t value = (RequiredArgs<Ts...>::value == 0 && IsOmittableArg<typename dukglue::types::Bare<T>::type>::value)
+				? 0 : 1 + RequiredArgs<Ts...>::value;
+		};
+
+		template<typename... Ts>
+		struct OverloadSignature
+		{
+			static inline bool matches(duk_context* ctx, duk_idx_t nargs, uint64_t stack_mask)
+			{
+				return nargs <= static_cast<duk_idx_t>(sizeof...(Ts))
+					&& nargs >= RequiredArgs<Ts...>::value
+					&& (stack_mask & ~SignatureMask<0, Ts...>::value) == 0
+					&& extra_args_match(ctx, nargs, typename make_indexes<Ts...>::type());
+			}
+
+			// pads left out arguments with undefined, before reading the arguments
+			static inline void fill_missing_args(duk_context* ctx)
+			{
+				if (duk_get_top(ctx) < static_cast<duk_idx_t>(sizeof...(Ts)))
+					duk_set_top(ctx, static_cast<duk_idx_t>(sizeof...(Ts)));
+			}
+
+		private:
+			template<size_t... Indexes>
+			static inline bool extra_args_match(duk_context* ctx, duk_idx_t nargs, index_tuple<Indexes...>)
+			{
+				bool match = true;
+				int unused[] = { 0, (match = match && (static_cast<duk_idx_t>(Indexes) < OVERLOAD_MASK_ARGS
+					|| static_cast<duk_idx_t>(Indexes) >= nargs
+					|| duk_check_type_mask(ctx, static_cast<duk_idx_t>(Indexes), dukglue::types::ArgTypeMask<Ts>::value)), 0)... };
+				(void) unused;
+				return match;
+			}
+		};
+
+		template<typename F>
+		struct OverloadCandidate;
+
+		// functions
+		template<typename RetType, typename... Ts>
+		struct OverloadCandidate<RetType(*)(Ts...)> : OverloadSignature<Ts...>
+		{
+			static duk_ret_t call(duk_context* ctx, RetType(*func)(Ts...))
+			{
+				OverloadSignature<Ts...>::fill_missing_args(ctx);
+				FuncInfoHolder<RetType, Ts...>::FuncRuntime::actually_call(ctx, func, get_stack_values<Ts...>(ctx));
+				return std::is_void<RetType>::value ? 0 : 1;
+			}
+		};
+
+		// varargs functions match anything, so they only make sense as the last candidate
+		template<>
+		struct OverloadCandidate<duk_ret_t(*)(duk_context*)>
+		{
+			static inline bool matches(duk_context* ctx, duk_idx_t nargs, uint64_t stack_mask)
+			{
+				return true;
+			}
+
+			static duk_ret_t call(duk_context* ctx, duk_ret_t(*func)(duk_context*))
+			{
+				return func(ctx);
+			}
+		};
+
+		// methods
+		template<class Cls, typename RetType, typename... Ts>
+		struct OverloadCandidate<RetType(Cls::*)(Ts...)> : OverloadSignature<Ts...>
+		{
+			typedef Cls Class;
+
+			static duk_ret_t call(duk_context* ctx, RetType(Cls::*method)(Ts...))
+			{
+				OverloadSignature<Ts...>::fill_missing_args(ctx);
+				MethodInfo<false, Cls, RetType, Ts...>::MethodRuntime::actually_call(ctx, method, get_native_this<Cls>(ctx), get_stack_values<Ts...>(ctx));
+				return std::is_void<RetType>::value ? 0 : 1;
+			}
+		};
+
+		template<class Cls, typename RetType, typename... Ts>
+		struct OverloadCandidate<RetType(Cls::*)(Ts...) const> : OverloadSignature<Ts...>
+		{
+			typedef Cls Class;
+
+			static duk_ret_t call(duk_context* ctx, RetType(Cls::*method)(Ts...) const)
+			{
+				OverloadSignature<Ts...>::fill_missing_args(ctx);
+				MethodInfo<true, Cls, RetType, Ts...>::MethodRuntime::actually_call(ctx, method, get_native_this<Cls>(ctx), get_stack_values<Ts...>(ctx));
+				return std::is_void<RetType>::value ? 0 : 1;
+			}
+		};
+
+		template<class Cls>
+		struct OverloadCandidate<duk_ret_t(Cls::*)(duk_context*)>
+		{
+			typedef Cls Class;
+
+			static inline bool matches(duk_context* ctx, duk_idx_t nargs, uint64_t stack_mask)
+			{
+				return true;
+			}
+
+			static duk_ret_t call(duk_context* ctx, duk_ret_t(Cls::*method)(duk_context*))
+			{
+				return (get_native_this<Cls>(ctx)->*method)(ctx);
+			}
+		};
+
+		template<class Cls>
+		struct OverloadCandidate<duk_ret_t(Cls::*)(duk_context*) const>
+		{
+			typedef Cls Class;
+
+			static inline bool matches(duk_context* ctx, duk_idx_t nargs, uint64_t stack_mask)
+			{
+				return true;
+			}
+
+			static duk_ret_t call(duk_context* ctx, duk_ret_t(Cls::*method)(duk_context*) const)
+			{
+				return (get_native_this<Cls>(ctx)->*method)(ctx);
+			}
+		};
+
+		// The Duktape C function for a set of overloads. The function pointers are kept in
+		// MagicTable<std::tuple<Fs...>>, like dukglue_register_function_magic.
+		template<typename... Fs>
+		struct OverloadSet
+		{
+			typedef std::tuple<Fs...> Funcs;
+
+			static duk_ret_t call_native_function(duk_context* ctx)
+			{
+				const Funcs& funcs = MagicTable<Funcs>::get(duk_get_current_magic(ctx));
+				const duk_idx_t nargs = duk_get_top(ctx);
+
+				return dispatch(ctx, funcs, nargs, stack_type_mask(ctx, nargs), std::integral_constant<size_t, 0>());
+			}
+
+		private:
+			template<size_t I>
+			static inline duk_ret_t dispatch(duk_context* ctx, const Funcs& funcs, duk_idx_t nargs, uint64_t stack_mask, std::integral_constant<size_t, I>)
+			{
+				typedef OverloadCandidate<typename std::tuple_element<I, Funcs>::type> Candidate;
+
+				if (Candidate::matches(ctx, nargs, stack_mask))
+					return Candidate::call(ctx, std::get<I>(funcs));
+
+				return dispatch(ctx, funcs, nargs, stack_mask, std::integral_constant<size_t, I + 1>());
+			}
+
+			static inline duk_ret_t dispatch(duk_context* ctx, const Funcs& funcs, duk_idx_t nargs, uint64_t stack_mask, std::integral_constant<size_t, sizeof...(Fs)>)
+			{
+				duk_error(ctx, DUK_RET_TYPE_ERROR, "No overload matches the arguments (%d given)", (int) nargs);
+				return DUK_RET_TYPE_ERROR;
+			}
+		};
+	}
+}
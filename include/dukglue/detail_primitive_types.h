@@ -3,14 +3,33 @@
 #include "detail_types.h"
 #include "detail_typeinfo.h"
 #include "dukvalue.h"
+#include "dukstringview.h"
+#include "dukbuffer.h"
+#include "detail_typed_array.h"
+#include "detail_traits.h"  // for index_tuple/make_indexes
 
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <array>
+#include <tuple>
+#include <utility>  // for std::pair
+#include <cmath>  // for std::floor, std::isfinite, std::ldexp
+#include <limits>
 #include <stdint.h>
 #include <memory>  // for std::shared_ptr
 
+#ifdef DUKGLUE_HAS_CXX17
+#include <optional>
+#include <string_view>
+#include <variant>
+#endif
+
 namespace dukglue {
 	namespace types {
+		// the Duktape types an argument of type FullT accepts (see detail_overloads.h)
+		template<typename FullT>
+		struct ArgTypeMask;
 
 #define DUKGLUE_SIMPLE_VALUE_TYPE(TYPE, DUK_IS_FUNC, DUK_GET_FUNC, DUK_PUSH_FUNC, PUSH_VALUE) \
 		template<> \
@@ -58,7 +77,88 @@ namespace dukglue {
 		DUKGLUE_SIMPLE_VALUE_TYPE(float, duk_is_number, duk_get_number, duk_push_number, value)
 		DUKGLUE_SIMPLE_VALUE_TYPE(double, duk_is_number, duk_get_number, duk_push_number, value)
 
-		DUKGLUE_SIMPLE_VALUE_TYPE(std::string, duk_is_string, duk_get_string, duk_push_string, value.c_str())
+		// Reads the value at arg_idx into an existing T, reusing its storage (see dukglue_read_into).
+		// The default assigns a freshly read value. std::string, std::vector and std::map overwrite
+		// their contents in place instead, so a container that is refilled every frame stops
+		// allocating once it has held the largest value it needs to.
+		template<typename T, typename Enable = void>
+		struct DukReadInto {
+			static void read(duk_context* ctx, duk_idx_t arg_idx, T& out) {
+				out = DukType<typename Bare<T>::type>::template read<T>(ctx, arg_idx);
+			}
+		};
+
+		// Strings are read and pushed with an explicit length (duk_get_lstring/duk_push_lstring),
+		// so there is no strlen on either side and embedded NULs survive the round-trip.
+		template<>
+		struct DukType<std::string> {
+			typedef std::true_type IsValueType;
+
+			template<typename FullT>
+			static std::string read(duk_context* ctx, duk_idx_t arg_idx) {
+				if (duk_is_string(ctx, arg_idx)) {
+					duk_size_t len;
+					const char* str = duk_get_lstring(ctx, arg_idx, &len);
+					return std::string(str, len);
+				} else {
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected std::string, got %s", arg_idx, detail::get_type_name(type_idx));
+				}
+			}
+
+			template<typename FullT>
+			static void push(duk_context* ctx, const std::string& value) {
+				duk_push_lstring(ctx, value.data(), value.size());
+			}
+		};
+
+		template<>
+		struct DukReadInto<std::string> {
+			static void read(duk_context* ctx, duk_idx_t arg_idx, std::string& out) {
+				if (!duk_is_string(ctx, arg_idx)) {
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected std::string, got %s", arg_idx, detail::get_type_name(type_idx));
+				}
+
+				duk_size_t len;
+				const char* str = duk_get_lstring(ctx, arg_idx, &len);
+				out.assign(str, len);
+			}
+		};
+
+		// Borrowed strings (DukStringView, std::string_view) point directly into the script string,
+		// so reading them never allocates. The view is only valid for the duration of the native call
+		// (the argument stays on the value stack until the call returns).
+		// They can't be used as dukglue_pcall/dukglue_peval/PreparedCall return types - the result is popped
+		// before the call returns, so the view would dangle (see IsBorrowed).
+#define DUKGLUE_STRING_VIEW_TYPE(TYPE) \
+		template<> \
+		struct DukType<TYPE> { \
+			typedef std::true_type IsValueType; \
+			\
+			template<typename FullT> \
+			static TYPE read(duk_context* ctx, duk_idx_t arg_idx) { \
+				if (duk_is_string(ctx, arg_idx)) { \
+					duk_size_t len; \
+					const char* str = duk_get_lstring(ctx, arg_idx, &len); \
+					return TYPE(str, len); \
+				} else { \
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx); \
+					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected string, got %s", arg_idx, detail::get_type_name(type_idx)); \
+				} \
+			} \
+			\
+			template<typename FullT> \
+			static void push(duk_context* ctx, const TYPE& value) { \
+				duk_push_lstring(ctx, value.data(), value.size()); \
+			} \
+		};
+
+		DUKGLUE_STRING_VIEW_TYPE(DukStringView)
+
+#ifdef DUKGLUE_HAS_CXX17
+		DUKGLUE_STRING_VIEW_TYPE(std::string_view)
+#endif
 
 		// We have to do some magic for const char* to work correctly.
 		// We override the "bare type" and "storage type" to both be const char*.
@@ -135,33 +235,113 @@ namespace dukglue {
 		};
 
 		// std::vector (as value)
+		// Numeric vectors (float, int32_t, uint8_t, ...) are pushed as the matching TypedArray
+		// (Float32Array, Int32Array, Uint8Array, ...) and read from one with a single memcpy,
+		// see detail_typed_array.h. Plain arrays (and other TypedArrays) are read element by element.
 		// TODO - probably leaks memory if duktape is using longjmp and an error is encountered while reading an element
+
+		// Reading into an existing vector (dukglue_read_into): elements are overwritten in place (with DukReadInto, so a vector of strings or
+		// of vectors reuses the elements' storage too), and the vector only reallocates when it grows.
 		template<typename T>
-		struct DukType< std::vector<T> > {
-			typedef std::true_type IsValueType;
+		struct DukReadInto< std::vector<T> > {
+			static void read(duk_context* ctx, duk_idx_t arg_idx, std::vector<T>& vec) {
+				typedef typename detail::TypedArray<T>::Supported HasTypedArray;
 
-			template <typename FullT>
-			static std::vector<T> read(duk_context* ctx, duk_idx_t arg_idx) {
-				if (!duk_is_array(ctx, arg_idx)) {
+				if (read_typed_array(ctx, arg_idx, vec, HasTypedArray()))
+					return;
+
+				if (!duk_is_array(ctx, arg_idx) && !duk_is_buffer_data(ctx, arg_idx)) {
 					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
 					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected array, got %s", arg_idx, detail::get_type_name(type_idx));
 				}
 
-				duk_size_t len = duk_get_length(ctx, arg_idx);
+				const size_t len = duk_get_length(ctx, arg_idx);
 				const duk_idx_t elem_idx = duk_get_top(ctx);
 
-				std::vector<T> vec;
+				if (vec.size() > len)
+					vec.erase(vec.begin() + len, vec.end());
 				vec.reserve(len);
-				for (duk_size_t i = 0; i < len; i++) {
+
+				for (size_t i = 0; i < len; i++) {
 					duk_get_prop_index(ctx, arg_idx, i);
-					vec.push_back(DukType< typename Bare<T>::type >::template read<T>(ctx, elem_idx));
+					if (i < vec.size())
+						read_element(ctx, elem_idx, vec, i, std::is_same<T, bool>());
+					else
+						vec.push_back(DukType< typename Bare<T>::type >::template read<T>(ctx, elem_idx));
 					duk_pop(ctx);
 				}
+			}
+
+		private:
+			static bool read_typed_array(duk_context* ctx, duk_idx_t arg_idx, std::vector<T>& vec, std::true_type) {
+				if (!detail::TypedArray<T>::is_typed_array(ctx, arg_idx))
+					return false;
+
+				duk_size_t size = 0;
+				const void* data = duk_get_buffer_data(ctx, arg_idx, &size);
+
+				vec.resize(size / sizeof(T));
+				if (!vec.empty())
+					memcpy(vec.data(), data, vec.size() * sizeof(T));
+				return true;
+			}
+
+			static bool read_typed_array(duk_context* ctx, duk_idx_t arg_idx, std::vector<T>& vec, std::false_type) {
+				return false;
+			}
+
+			static void read_element(duk_context* ctx, duk_idx_t elem_idx, std::vector<T>& vec, size_t i, std::false_type) {
+				DukReadInto<T>::read(ctx, elem_idx, vec[i]);
+			}
+
+			// std::vector<bool> elements aren't addressable
+			static void read_element(duk_context* ctx, duk_idx_t elem_idx, std::vector<T>& vec, size_t i, std::true_type) {
+				vec[i] = DukType<bool>::template read<bool>(ctx, elem_idx);
+			}
+		};
+
+		template<typename T>
+		struct DukType< std::vector<T> > {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::vector<T> read(duk_context* ctx, duk_idx_t arg_idx) {
+				std::vector<T> vec;
+				DukReadInto< std::vector<T> >::read(ctx, arg_idx, vec);
 				return vec;
 			}
 
 			template <typename FullT>
 			static void push(duk_context* ctx, const std::vector<T>& value) {
+#ifdef DUKGLUE_NO_TYPED_ARRAYS
+				push_array(ctx, value);
+#else
+				push(ctx, value, typename detail::TypedArray<T>::Supported());
+#endif
+			}
+
+		private:
+			static void push(duk_context* ctx, const std::vector<T>& value, std::true_type) {
+				detail::TypedArray<T>::push_copy(ctx, value.data(), value.size());
+			}
+
+			static void push(duk_context* ctx, const std::vector<T>& value, std::false_type) {
+				push_array(ctx, value);
+			}
+
+			// vectors of native object pointers
+			typedef std::integral_constant<bool, std::is_pointer<T>::value
+				&& !DukType<typename Bare<T>::type>::IsValueType::value> IsNativePointer;
+
+			static void push_array(duk_context* ctx, const std::vector<T>& value) {
+				push_array(ctx, value, IsNativePointer());
+			}
+
+			static void push_array(duk_context* ctx, const std::vector<T>& value, std::true_type) {
+				detail::push_native_array(ctx, value.data(), value.size());
+			}
+
+			static void push_array(duk_context* ctx, const std::vector<T>& value, std::false_type) {
 				duk_idx_t obj_idx = duk_push_array(ctx);
 
 				for (size_t i = 0; i < value.size(); i++) {
@@ -171,6 +351,139 @@ namespace dukglue {
 			}
 		};
 
+		// DukSpan (borrowed view of a script buffer, see dukbuffer.h)
+		template<typename T>
+		struct DukType< DukSpan<T> > {
+			typedef std::true_type IsValueType;
+			typedef typename std::remove_const<T>::type ElementType;
+
+			static_assert(detail::TypedArray<ElementType>::Supported::value, "DukSpan elements must be 8/16/32-bit integers, float or double");
+
+			template <typename FullT>
+			static DukSpan<T> read(duk_context* ctx, duk_idx_t arg_idx) {
+				if (!duk_is_buffer_data(ctx, arg_idx)) {
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected buffer, got %s", arg_idx, detail::get_type_name(type_idx));
+				}
+
+				// bytes can be viewed from any buffer, other elements need the matching TypedArray
+				if (sizeof(ElementType) != 1 && !detail::TypedArray<ElementType>::is_typed_array(ctx, arg_idx))
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected %s", arg_idx, detail::TypedArray<ElementType>::constructor_name());
+
+				duk_size_t size = 0;
+				void* data = duk_get_buffer_data(ctx, arg_idx, &size);
+				if (!detail::TypedArray<ElementType>::is_aligned(data))
+					duk_error(ctx, DUK_ERR_RANGE_ERROR, "Argument %d: %s data isn't aligned", arg_idx, detail::TypedArray<ElementType>::constructor_name());
+
+				return DukSpan<T>(static_cast<T*>(data), size / sizeof(T));
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const DukSpan<T>& value) {
+				detail::TypedArray<ElementType>::push_copy(ctx, value.data(), value.size());
+			}
+		};
+
+		// DukSharedBuffer (native memory shared with script, see dukbuffer.h)
+		template<typename T>
+		struct DukType< DukSharedBuffer<T> > {
+			typedef std::true_type IsValueType;
+			typedef typename std::remove_const<T>::type ElementType;
+
+			static_assert(detail::TypedArray<ElementType>::Supported::value, "DukSharedBuffer elements must be 8/16/32-bit integers, float or double");
+
+			template <typename FullT>
+			static DukSharedBuffer<T> read(duk_context* ctx, duk_idx_t arg_idx) {
+				// one we pushed: same memory, same owner
+				if (detail::TypedArray<ElementType>::is_typed_array(ctx, arg_idx)) {
+					duk_size_t size = 0;
+					void* data = duk_get_buffer_data(ctx, arg_idx, &size);
+
+					SharedOwner* owner = get_owner(ctx, arg_idx);
+					if (owner != nullptr && detail::TypedArray<ElementType>::is_aligned(data))
+						return DukSharedBuffer<T>(static_cast<T*>(data), size / sizeof(T), owner->owner);
+				}
+
+				// anything else is copied
+				std::shared_ptr< std::vector<ElementType> > vec = std::make_shared< std::vector<ElementType> >(
+					DukType< std::vector<ElementType> >::template read< std::vector<ElementType> >(ctx, arg_idx));
+				return DukSharedBuffer<T>(vec->data(), vec->size(), vec);
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const DukSharedBuffer<T>& value) {
+				push(ctx, value, std::is_const<T>());
+			}
+
+		private:
+			// Script can't be handed a read-only TypedArray, so const memory is copied (like DukSpan)
+			static void push(duk_context* ctx, const DukSharedBuffer<T>& value, std::true_type) {
+				detail::TypedArray<ElementType>::push_copy(ctx, value.data(), value.size());
+			}
+
+			static void push(duk_context* ctx, const DukSharedBuffer<T>& value, std::false_type) {
+				const duk_size_t size = value.size_bytes();
+
+				duk_push_external_buffer(ctx);
+				duk_config_buffer(ctx, -1, value.data(), size);
+				duk_push_buffer_object(ctx, -1, 0, size, detail::TypedArray<ElementType>::flags);
+
+				if (value.owner()) {
+					SharedOwner* owner = new SharedOwner{ value.owner(), duk_get_heapptr(ctx, -1), duk_get_heapptr(ctx, -2) };
+					duk_push_pointer(ctx, owner);
+					duk_put_prop_string(ctx, -2, "\xFF" "buffer_owner");
+
+					duk_push_c_function(ctx, &owner_finalizer, 1);
+					duk_set_finalizer(ctx, -2);
+				}
+
+				duk_remove(ctx, -2);  // external buffer, now referenced by the TypedArray
+			}
+
+			// what a pushed TypedArray holds on to
+			struct SharedOwner {
+				std::shared_ptr<const void> owner;
+				void* array;  // the TypedArray
+				void* external;  // its external buffer (kept alive by the TypedArray)
+			};
+
+			// The owner of the TypedArray at idx, or NULL if it isn't one we pushed.
+			// (An object whose prototype is one we pushed inherits the owner property and the finalizer,
+			// but not the memory.)
+			static SharedOwner* get_owner(duk_context* ctx, duk_idx_t idx)
+			{
+				duk_get_prop_string(ctx, idx, "\xFF" "buffer_owner");
+				SharedOwner* owner = static_cast<SharedOwner*>(duk_get_pointer(ctx, -1));
+				duk_pop(ctx);
+
+				if (owner != nullptr && owner->array != duk_get_heapptr(ctx, idx))
+					return nullptr;
+				return owner;
+			}
+
+			static duk_ret_t owner_finalizer(duk_context* ctx)
+			{
+				SharedOwner* owner = get_owner(ctx, 0);
+				if (owner == nullptr)
+					return 0;
+
+				// Script can reach the external buffer through objects that can't hold the owner
+				// (.buffer, subarray(), new Uint8Array(view.buffer), Uint8Array.plainOf(view) ...),
+				// so detach it before letting go of the memory: those objects now see an empty buffer
+				// (elements read as 0, writes are ignored) instead of freed memory.
+				duk_push_heapptr(ctx, owner->external);
+				duk_config_buffer(ctx, -1, nullptr, 0);
+				duk_pop(ctx);
+
+				delete owner;
+
+				// finalizers can run multiple times
+				duk_push_pointer(ctx, nullptr);
+				duk_put_prop_string(ctx, 0, "\xFF" "buffer_owner");
+				return 0;
+			}
+		};
+
 		// std::shared_ptr (as value)
 		template<typename T>
 		struct DukType< std::shared_ptr<T> > {
@@ -185,53 +498,48 @@ namespace dukglue {
 
 				if (!duk_is_object(ctx, arg_idx)) {
 					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
-					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected shared_ptr object, got ", arg_idx, detail::get_type_name(type_idx));
+					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected shared_ptr object, got %s", arg_idx, detail::get_type_name(type_idx));
 				}
 
-				duk_get_prop_string(ctx, arg_idx, "\xFF" "type_info");
-				if (!duk_is_pointer(ctx, -1))  // missing type_info, must not be a native object
-					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected shared_ptr object (missing type_info)", arg_idx);
+				dukglue::detail::NativeHeaderExt* ext = nullptr;
+				dukglue::detail::NativeHeader* header = dukglue::detail::NativeHeader::get(ctx, arg_idx, &ext);
+				if (header == nullptr)  // missing native header, must not be a native object
+					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected shared_ptr object (missing native header)", arg_idx);
 
-				// make sure this object can be safely returned as a T*
-				dukglue::detail::TypeInfo* info = static_cast<dukglue::detail::TypeInfo*>(duk_get_pointer(ctx, -1));
-				if (!info->can_cast<T>())
+				// make sure this object can be safely returned as a T* (adjusting the pointer if needed)
+				T* obj = header->type_info->cast<T>(header->obj);
+				if (obj == nullptr && header->obj != nullptr)
 					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: wrong type of shared_ptr object", arg_idx);
-				duk_pop(ctx);  // pop type_info
 
-				duk_get_prop_string(ctx, arg_idx, "\xFF" "shared_ptr");
-				if (!duk_is_pointer(ctx, -1))
+				if (ext == nullptr || !(ext->flags & dukglue::detail::NativeHeader::SHARED_PTR) || ext->owner == nullptr)
 					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: not a shared_ptr object (missing shared_ptr)", arg_idx);
-				void* ptr = duk_get_pointer(ctx, -1);
-				duk_pop(ctx);  // pop pointer to shared_ptr
 
-				return *((std::shared_ptr<T>*) ptr);
+				// share ownership with the stored shared_ptr, but point at the T subobject
+				const std::shared_ptr<void>& owner = *static_cast<std::shared_ptr<void>*>(ext->owner);
+				return std::shared_ptr<T>(owner, obj);
 			}
 
 			static duk_ret_t shared_ptr_finalizer(duk_context* ctx)
 			{
-				duk_get_prop_string(ctx, 0, "\xFF" "shared_ptr");
-				std::shared_ptr<T>* ptr = (std::shared_ptr<T>*) duk_require_pointer(ctx, -1);
-				duk_pop(ctx);  // pop shared_ptr ptr
-
-				if (ptr != NULL) {
-					delete ptr;
-
-					// for safety, set the pointer to undefined
-					// (finalizers can run multiple times)
-					duk_push_undefined(ctx);
-					duk_put_prop_string(ctx, 0, "\xFF" "shared_ptr");
-				}
+				dukglue::detail::NativeHeaderExt* ext = nullptr;
+				dukglue::detail::NativeHeader* header = dukglue::detail::NativeHeader::get_own(ctx, 0, &ext);
+				if (ext != nullptr && (ext->flags & dukglue::detail::NativeHeader::SHARED_PTR))
+					delete static_cast<std::shared_ptr<void>*>(ext->owner);
 
+				// (this removes the header, so the shared_ptr is only deleted once)
+				dukglue::detail::RefManager::release_native_header(ctx, 0, header, ext);
 				return 0;
 			}
 
 			template <typename FullT>
 			static void push(duk_context* ctx, const std::shared_ptr<T>& value) {
-				dukglue::detail::ProtoManager::make_script_object(ctx, value.get());
+				// (a header with flags is always a NativeHeaderExt)
+				dukglue::detail::NativeHeaderExt* header = static_cast<dukglue::detail::NativeHeaderExt*>(
+					dukglue::detail::ProtoManager::make_script_object(ctx, value.get(), dukglue::detail::NativeHeader::SHARED_PTR));
 
-				// create + set shared_ptr
-				duk_push_pointer(ctx, new std::shared_ptr<T>(value));
-				duk_put_prop_string(ctx, -2, "\xFF" "shared_ptr");
+				// create + set shared_ptr (type-erased, since the script object may be read
+				// back as a shared_ptr to any of its registered base classes)
+				header->owner = new std::shared_ptr<void>(value);
 
 				// set shared_ptr finalizer
 				duk_push_c_function(ctx, &shared_ptr_finalizer, 1);
@@ -241,19 +549,195 @@ namespace dukglue {
 
 		// std::map (as value)
 		// TODO - probably leaks memory if duktape is using longjmp and an error is encountered while reading values
+
+		// Reading into an existing map (dukglue_read_into): values whose keys are still present are overwritten in place (with DukReadInto), so a map
+		// refilled from objects with the same keys doesn't allocate. If any keys were removed,
+		// the map is cleared and rebuilt.
+		template<typename T>
+		struct DukReadInto< std::map<std::string, T> > {
+			static void read(duk_context* ctx, duk_idx_t arg_idx, std::map<std::string, T>& map) {
+				if (!duk_is_object(ctx, arg_idx))
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected object.", arg_idx);
+
+				arg_idx = duk_normalize_index(ctx, arg_idx);
+				if (read_props(ctx, arg_idx, map) != map.size()) {
+					map.clear();
+					read_props(ctx, arg_idx, map);
+				}
+			}
+
+		private:
+			// returns the number of properties read
+			static size_t read_props(duk_context* ctx, duk_idx_t arg_idx, std::map<std::string, T>& map) {
+				size_t count = 0;
+				std::string key;
+
+				duk_enum(ctx, arg_idx, DUK_ENUM_OWN_PROPERTIES_ONLY);
+				while (duk_next(ctx, -1, 1)) {
+					duk_size_t len;
+					const char* str = duk_safe_to_lstring(ctx, -2, &len);
+					key.assign(str, len);
+
+					auto it = map.find(key);
+					if (it != map.end())
+						DukReadInto<T>::read(ctx, -1, it->second);
+					else
+						map.emplace(key, DukType<typename Bare<T>::type>::template read<T>(ctx, -1));
+
+					count++;
+					duk_pop_2(ctx);
+				}
+				duk_pop(ctx);  // pop enum object
+				return count;
+			}
+		};
+
+		// Storage for a non-const reference to a container argument (std::string&, std::vector<T>&,
+		// std::map<std::string, T>&, see ArgStorage). The argument is read with DukReadInto into a
+		// container borrowed from a per-thread free list for T, so a function that is called every frame
+		// with the same shape of data keeps reusing the same capacity and stops allocating. The container
+		// goes back on the free list when the call returns (a recursive call borrows another one).
+		// Changes the native function makes to the container are not written back to script.
+		// The container is only taken off the free list once the argument has been read, so a read
+		// error doesn't leak it (Duktape errors skip destructors, unless DUK_USE_CPP_EXCEPTIONS is set).
+		template<typename T>
+		class ScratchArg
+		{
+		public:
+			static ScratchArg read(duk_context* ctx, duk_idx_t arg_idx)
+			{
+				std::vector<T*>& containers = free_list().containers;
+				if (containers.empty())
+					containers.push_back(new T());
+
+				T* container = containers.back();
+				DukReadInto<T>::read(ctx, arg_idx, *container);
+				containers.pop_back();
+				return ScratchArg(container);
+			}
+
+			ScratchArg(ScratchArg&& rhs) : value_(rhs.value_) {
+				rhs.value_ = nullptr;
+			}
+
+			ScratchArg(const ScratchArg&) = delete;
+			ScratchArg& operator=(const ScratchArg&) = delete;
+
+			~ScratchArg() {
+				if (value_ != nullptr)
+					free_list().containers.push_back(value_);
+			}
+
+			inline operator T&() const {
+				return *value_;
+			}
+
+		private:
+			explicit ScratchArg(T* value) : value_(value) {}
+
+			struct FreeList {
+				std::vector<T*> containers;
+
+				~FreeList() {
+					for (T* container : containers)
+						delete container;
+				}
+			};
+
+			static FreeList& free_list() {
+				static thread_local FreeList list;
+				return list;
+			}
+
+			T* value_;
+		};
+
 		template<typename T>
 		struct DukType< std::map<std::string, T> > {
 			typedef std::true_type IsValueType;
 
 			template <typename FullT>
 			static std::map<std::string, T> read(duk_context* ctx, duk_idx_t arg_idx) {
+				std::map<std::string, T> map;
+				DukReadInto< std::map<std::string, T> >::read(ctx, arg_idx, map);
+				return map;
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const std::map<std::string, T>& value) {
+				duk_idx_t obj_idx = duk_push_object(ctx);
+				for (const auto& kv : value) {
+					DukType<typename Bare<T>::type>::template push<T>(ctx, kv.second);
+					duk_put_prop_lstring(ctx, obj_idx, kv.first.data(), kv.first.size());
+				}
+			}
+		};
+
+		// std::unordered_map (as value)
+		// Pushed as an object. Keys can be std::string or integers (object keys are strings in script,
+		// so integer keys are converted back when reading, and a key that isn't an integer is an error).
+		template<typename K, typename Enable = void>
+		struct MapKey;
+
+		template<>
+		struct MapKey<std::string> {
+			static std::string read(duk_context* ctx, duk_idx_t key_idx) {
+				duk_size_t len;
+				const char* str = duk_safe_to_lstring(ctx, key_idx, &len);
+				return std::string(str, len);
+			}
+
+			static void push(duk_context* ctx, const std::string& key) {
+				duk_push_lstring(ctx, key.data(), key.size());
+			}
+		};
+
+		template<typename K>
+		struct MapKey<K, typename std::enable_if<std::is_integral<K>::value && !std::is_same<K, bool>::value>::type> {
+			// The key must be the canonical string for an integer that fits in K ("42", "-3"),
+			// so different keys can't collapse into the same map entry ("", "01", "1e20", "-0", ...).
+			static K read(duk_context* ctx, duk_idx_t key_idx) {
+				key_idx = duk_normalize_index(ctx, key_idx);
+				duk_size_t len;
+				const char* str = duk_safe_to_lstring(ctx, key_idx, &len);
+
+				duk_dup(ctx, key_idx);
+				const double key = duk_to_number(ctx, -1);
+				duk_to_string(ctx, -1);
+				duk_size_t canonical_len;
+				const char* canonical = duk_get_lstring(ctx, -1, &canonical_len);
+				const bool is_canonical = len > 0 && canonical_len == len && memcmp(canonical, str, len) == 0;
+				duk_pop(ctx);
+
+				if (!is_canonical || !std::isfinite(key) || key != std::floor(key))
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Expected integer key, got '%s'", str);
+
+				// (max + 1 is a power of two, so it's exact as a double even for 64-bit keys)
+				if (key < static_cast<double>(std::numeric_limits<K>::min()) || key >= std::ldexp(1.0, std::numeric_limits<K>::digits))
+					duk_error(ctx, DUK_ERR_RANGE_ERROR, "Key '%s' is out of range", str);
+
+				return static_cast<K>(key);
+			}
+
+			static void push(duk_context* ctx, K key) {
+				duk_push_number(ctx, static_cast<duk_double_t>(key));
+			}
+		};
+
+		// TODO - probably leaks memory if duktape is using longjmp and an error is encountered while reading values
+		template<typename K, typename T>
+		struct DukType< std::unordered_map<K, T> > {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::unordered_map<K, T> read(duk_context* ctx, duk_idx_t arg_idx) {
 				if (!duk_is_object(ctx, arg_idx))
 					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected object.", arg_idx);
 
-				std::map<std::string, T> map;
-				duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
+				std::unordered_map<K, T> map;
+				duk_enum(ctx, arg_idx, DUK_ENUM_OWN_PROPERTIES_ONLY);
 				while (duk_next(ctx, -1, 1)) {
-					map[duk_safe_to_string(ctx, -2)] = DukType<typename Bare<T>::type>::template read<T>(ctx, -1);
+					map[MapKey<K>::read(ctx, -2)] = DukType<typename Bare<T>::type>::template read<T>(ctx, -1);
 					duk_pop_2(ctx);
 				}
 				duk_pop(ctx);  // pop enum object
@@ -261,13 +745,290 @@ namespace dukglue {
 			}
 
 			template <typename FullT>
-			static void push(duk_context* ctx, const std::map<std::string, T>& value) {
+			static void push(duk_context* ctx, const std::unordered_map<K, T>& value) {
 				duk_idx_t obj_idx = duk_push_object(ctx);
 				for (const auto& kv : value) {
+					MapKey<K>::push(ctx, kv.first);
 					DukType<typename Bare<T>::type>::template push<T>(ctx, kv.second);
-					duk_put_prop_lstring(ctx, obj_idx, kv.first.data(), kv.first.size());
+					duk_put_prop(ctx, obj_idx);
+				}
+			}
+		};
+
+		// std::array (as value)
+		// Pushed as a plain array (these are usually small: vectors, colors, matrices).
+		// Read from an array (or a TypedArray, with one memcpy if it's the matching one)
+		// that has exactly N elements.
+		template<typename T, size_t N>
+		struct DukType< std::array<T, N> > {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::array<T, N> read(duk_context* ctx, duk_idx_t arg_idx) {
+				if (!duk_is_array(ctx, arg_idx) && !duk_is_buffer_data(ctx, arg_idx)) {
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected array, got %s", arg_idx, detail::get_type_name(type_idx));
+				}
+
+				const duk_size_t len = duk_get_length(ctx, arg_idx);
+				if (len != N)
+					duk_error(ctx, DUK_ERR_RANGE_ERROR, "Argument %d: expected array of length %d, got %d", arg_idx, (int) N, (int) len);
+
+				std::array<T, N> arr;
+				if (read_typed_array(ctx, arg_idx, arr, typename detail::TypedArray<T>::Supported()))
+					return arr;
+
+				const duk_idx_t elem_idx = duk_get_top(ctx);
+				for (size_t i = 0; i < N; i++) {
+					duk_get_prop_index(ctx, arg_idx, i);
+					arr[i] = DukType< typename Bare<T>::type >::template read<T>(ctx, elem_idx);
+					duk_pop(ctx);
 				}
+				return arr;
 			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const std::array<T, N>& value) {
+				duk_idx_t obj_idx = duk_push_array(ctx);
+				for (size_t i = 0; i < N; i++) {
+					DukType< typename Bare<T>::type >::template push<T>(ctx, value[i]);
+					duk_put_prop_index(ctx, obj_idx, i);
+				}
+			}
+
+		private:
+			static bool read_typed_array(duk_context* ctx, duk_idx_t arg_idx, std::array<T, N>& arr, std::true_type) {
+				if (!detail::TypedArray<T>::is_typed_array(ctx, arg_idx))
+					return false;
+
+				duk_size_t size = 0;
+				const void* data = duk_get_buffer_data(ctx, arg_idx, &size);
+				if (size != N * sizeof(T))
+					return false;
+
+				memcpy(arr.data(), data, N * sizeof(T));
+				return true;
+			}
+
+			static bool read_typed_array(duk_context* ctx, duk_idx_t arg_idx, std::array<T, N>& arr, std::false_type) {
+				return false;
+			}
+		};
+
+		// std::tuple and std::pair (as value)
+		// Pushed as a plain array with one element per member, read from an array of the same length.
+		template<typename... Ts>
+		struct DukType< std::tuple<Ts...> > {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::tuple<Ts...> read(duk_context* ctx, duk_idx_t arg_idx) {
+				if (!duk_is_array(ctx, arg_idx)) {
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected array, got %s", arg_idx, detail::get_type_name(type_idx));
+				}
+
+				const duk_size_t len = duk_get_length(ctx, arg_idx);
+				if (len != sizeof...(Ts))
+					duk_error(ctx, DUK_ERR_RANGE_ERROR, "Argument %d: expected array of length %d, got %d", arg_idx, (int) sizeof...(Ts), (int) len);
+
+				return read_elements(ctx, duk_normalize_index(ctx, arg_idx), typename detail::make_indexes<Ts...>::type());
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const std::tuple<Ts...>& value) {
+				push_elements(ctx, value, typename detail::make_indexes<Ts...>::type());
+			}
+
+		private:
+			template<typename T>
+			static T read_element(duk_context* ctx, duk_idx_t arg_idx, size_t i) {
+				duk_get_prop_index(ctx, arg_idx, i);
+				T elem = DukType<typename Bare<T>::type>::template read<T>(ctx, -1);
+				duk_pop(ctx);
+				return elem;
+			}
+
+			template<size_t... Indexes>
+			static std::tuple<Ts...> read_elements(duk_context* ctx, duk_idx_t arg_idx, detail::index_tuple<Indexes...>) {
+				// braced init, so the elements are read in order
+				return std::tuple<Ts...>{ read_element<Ts>(ctx, arg_idx, Indexes)... };
+			}
+
+			template<size_t... Indexes>
+			static void push_elements(duk_context* ctx, const std::tuple<Ts...>& value, detail::index_tuple<Indexes...>) {
+				duk_idx_t obj_idx = duk_push_array(ctx);
+				int unused[] = { 0, (DukType<typename Bare<Ts>::type>::template push<Ts>(ctx, std::get<Indexes>(value)),
+					duk_put_prop_index(ctx, obj_idx, Indexes), 0)... };
+				(void) unused;
+			}
+		};
+
+		template<typename A, typename B>
+		struct DukType< std::pair<A, B> > {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::pair<A, B> read(duk_context* ctx, duk_idx_t arg_idx) {
+				std::tuple<A, B> tup = DukType< std::tuple<A, B> >::template read< std::tuple<A, B> >(ctx, arg_idx);
+				return std::pair<A, B>(std::move(std::get<0>(tup)), std::move(std::get<1>(tup)));
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const std::pair<A, B>& value) {
+				duk_idx_t obj_idx = duk_push_array(ctx);
+				DukType<typename Bare<A>::type>::template push<A>(ctx, value.first);
+				duk_put_prop_index(ctx, obj_idx, 0);
+				DukType<typename Bare<B>::type>::template push<B>(ctx, value.second);
+				duk_put_prop_index(ctx, obj_idx, 1);
+			}
+		};
+
+#ifdef DUKGLUE_HAS_CXX17
+		// std::optional (as value)
+		// An undefined (or missing) argument reads as std::nullopt, and so does null, unless T itself
+		// accepts null (native object pointers, std::shared_ptr, DukValue). Anything else is read as T.
+		// std::nullopt is pushed as undefined.
+		template<typename T>
+		struct DukType< std::optional<T> > {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::optional<T> read(duk_context* ctx, duk_idx_t arg_idx) {
+				if (duk_is_undefined(ctx, arg_idx) || (duk_is_null(ctx, arg_idx) && !(ArgTypeMask<T>::value & DUK_TYPE_MASK_NULL)))
+					return std::nullopt;
+
+				return DukType<typename Bare<T>::type>::template read<typename ArgStorage<T>::type>(ctx, arg_idx);
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const std::optional<T>& value) {
+				if (value)
+					DukType<typename Bare<T>::type>::template push<T>(ctx, *value);
+				else
+					duk_push_undefined(ctx);
+			}
+		};
+
+		// std::monostate (as value), for empty std::variants: undefined or null
+		template<>
+		struct DukType<std::monostate> {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::monostate read(duk_context* ctx, duk_idx_t arg_idx) {
+				if (!duk_is_null_or_undefined(ctx, arg_idx)) {
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected undefined, got %s", arg_idx, detail::get_type_name(type_idx));
+				}
+				return std::monostate();
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, std::monostate) {
+				duk_push_undefined(ctx);
+			}
+		};
+
+		// std::variant (as value)
+		// Pushed as whichever alternative it holds. Read as the first alternative whose accepted
+		// script types (types::DukTypeMask) include the argument's type, so order the alternatives
+		// like overloads: std::variant<int, double> always reads numbers as int, and native object
+		// alternatives only match on "object" (the first one is picked, and fails if it's the wrong class).
+		template<typename... Ts>
+		struct DukType< std::variant<Ts...> > {
+			typedef std::true_type IsValueType;
+
+			template <typename FullT>
+			static std::variant<Ts...> read(duk_context* ctx, duk_idx_t arg_idx) {
+				return read_alternative(ctx, arg_idx, static_cast<duk_uint_t>(1) << duk_get_type(ctx, arg_idx), std::integral_constant<size_t, 0>());
+			}
+
+			template <typename FullT>
+			static void push(duk_context* ctx, const std::variant<Ts...>& value) {
+				std::visit([ctx](const auto& alt) {
+					typedef typename std::decay<decltype(alt)>::type Alt;
+					DukType<typename Bare<Alt>::type>::template push<Alt>(ctx, alt);
+				}, value);
+			}
+
+		private:
+			template<size_t I>
+			static std::variant<Ts...> read_alternative(duk_context* ctx, duk_idx_t arg_idx, duk_uint_t type_mask, std::integral_constant<size_t, I>) {
+				typedef typename std::variant_alternative<I, std::variant<Ts...> >::type Alt;
+
+				if (ArgTypeMask<Alt>::value & type_mask)
+					return std::variant<Ts...>(std::in_place_index<I>, DukType<typename Bare<Alt>::type>::template read<Alt>(ctx, arg_idx));
+
+				return read_alternative(ctx, arg_idx, type_mask, std::integral_constant<size_t, I + 1>());
+			}
+
+			static std::variant<Ts...> read_alternative(duk_context* ctx, duk_idx_t arg_idx, duk_uint_t type_mask, std::integral_constant<size_t, sizeof...(Ts)>) {
+				duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+				duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: no variant alternative accepts %s", arg_idx, detail::get_type_name(type_idx));
+			}
+		};
+#endif
+
+		// True for types whose values point into the script value they were read from (borrowed strings,
+		// DukSpan, const char*), and for containers of them. These are only valid while that value is
+		// on the value stack, so they can't be returned from dukglue_pcall, dukglue_peval or PreparedCall,
+		// which pop the result before returning. T is the type without references or cv-qualifiers.
+		template<typename T>
+		struct IsBorrowed : std::false_type {};
+
+		template<typename... Ts>
+		struct AnyBorrowed : std::false_type {};
+
+		template<typename T, typename... Ts>
+		struct AnyBorrowed<T, Ts...> : std::integral_constant<bool, IsBorrowed<typename std::remove_cv<typename std::remove_reference<T>::type>::type>::value
+			|| AnyBorrowed<Ts...>::value> {};
+
+		template<>
+		struct IsBorrowed<const char*> : std::true_type {};
+
+		template<>
+		struct IsBorrowed<DukStringView> : std::true_type {};
+
+		template<typename T>
+		struct IsBorrowed< DukSpan<T> > : std::true_type {};
+
+		template<typename T>
+		struct IsBorrowed< std::vector<T> > : AnyBorrowed<T> {};
+
+		template<typename T>
+		struct IsBorrowed< std::map<std::string, T> > : AnyBorrowed<T> {};
+
+		template<typename K, typename T>
+		struct IsBorrowed< std::unordered_map<K, T> > : AnyBorrowed<T> {};
+
+		template<typename T, size_t N>
+		struct IsBorrowed< std::array<T, N> > : AnyBorrowed<T> {};
+
+		template<typename A, typename B>
+		struct IsBorrowed< std::pair<A, B> > : AnyBorrowed<A, B> {};
+
+		template<typename... Ts>
+		struct IsBorrowed< std::tuple<Ts...> > : AnyBorrowed<Ts...> {};
+
+#ifdef DUKGLUE_HAS_CXX17
+		template<>
+		struct IsBorrowed<std::string_view> : std::true_type {};
+
+		template<typename T>
+		struct IsBorrowed< std::optional<T> > : AnyBorrowed<T> {};
+
+		template<typename... Ts>
+		struct IsBorrowed< std::variant<Ts...> > : AnyBorrowed<Ts...> {};
+#endif
+
+		// static_asserts that RetT can be returned from a call that pops the result
+		template<typename RetT>
+		struct ValidateOwnedResult {
+			static_assert(!AnyBorrowed<RetT>::value, "Borrowed types (const char*, DukStringView, std::string_view, DukSpan, ...) "
+				"can't be returned from dukglue_pcall, dukglue_peval or PreparedCall - the result is popped, so they would dangle. "
+				"Use std::string, std::vector, ... instead.");
+			typedef RetT type;
 		};
 
 		// std::function
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "dukrefhook.h"
+
+#include <stdint.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace dukglue
+{
+	namespace detail
+	{
+		class TypeInfo;
+
+		// Native side of the native object -> script object registry (see RefManager).
+		// Registered objects live in a contiguous generational slot map: each slot holds the
+		// native pointer and the script object's heap pointer, and every slot has a generation
+		// counter that is bumped when the slot is freed, so a handle (index + generation) can be
+		// checked for staleness with one comparison.
+
+		// Slot i corresponds to ref_array[i] in the heap stash, which keeps the script object alive,
+		// so the heap pointer stays valid for as long as the slot is in use. Freed slots are kept in
+		// a native free list, so registering and invalidating don't touch ref_array's free list.
+
+		// Objects are normally found through an std::unordered_map (pointer -> slot index).
+		// Objects that inherit from DukRefHook keep their handle in the object instead and
+		// are not put in the map at all.
+		struct RefRegistry
+		{
+			static const uint32_t NONE = 0xFFFFFFFF;
+
+			struct Slot {
+				void* obj;  // NULL if the slot is free
+				void* heapptr;
+				const TypeInfo* type_info;  // the script object's (see NativeHeader::type_info)
+				uint32_t generation;
+				uint32_t next;  // next free slot if this slot is free, HOOKED or NONE if it is in use
+				uint32_t epoch;  // see dukglue_set_epoch
+			};
+
+			RefRegistry() : free_head_(NONE), hooked_count_(0) {}
+
+			// Returns the slot index obj is registered at, or NONE.
+			inline uint32_t find(void* obj, const DukRefHook* hook) const
+			{
+				if (hook != nullptr && hook->mOwner == this && hook->mIndex < slots_.size()) {
+					const Slot& slot = slots_[hook->mIndex];
+					if (slot.generation == hook->mGeneration && slot.obj == obj)
+						return hook->mIndex;
+				}
+
+				const auto it = index_.find(obj);
+				return (it == index_.end()) ? NONE : it->second;
+			}
+
+			// Registers obj (replacing any previous registration for obj) and returns its slot index.
+			// Sets replaced to the heap pointer of the previous registration, or NULL.
+			uint32_t insert(void* obj, void* heapptr, const TypeInfo* type_info, uint32_t epoch, DukRefHook* hook, void** replaced)
+			{
+				*replaced = nullptr;
+
+				uint32_t idx = find(obj, hook);
+				if (idx != NONE) {
+					*replaced = slots_[idx].heapptr;
+					slots_[idx].heapptr = heapptr;
+					slots_[idx].type_info = type_info;
+					slots_[idx].epoch = epoch;
+					return idx;
+				}
+
+				if (free_head_ != NONE) {
+					idx = free_head_;
+					free_head_ = slots_[idx].next;
+				} else {
+					idx = static_cast<uint32_t>(slots_.size());
+					Slot slot = { nullptr, nullptr, nullptr, 0, NONE, 0 };
+					slots_.push_back(slot);
+				}
+
+				Slot& slot = slots_[idx];
+				slot.obj = obj;
+				slot.heapptr = heapptr;
+				slot.type_info = type_info;
+				slot.epoch = epoch;
+
+				// claim the hook if it's unused (or only holds a stale handle from this registry)
+				if (hook != nullptr && (hook->mOwner == nullptr || (hook->mOwner == this && !is_live(*hook)))) {
+					hook->mOwner = this;
+					hook->mIndex = idx;
+					hook->mGeneration = slot.generation;
+					slot.next = HOOKED;
+					hooked_count_++;
+				} else {
+					slot.next = NONE;
+					index_[obj] = idx;
+				}
+
+				return idx;
+			}
+
+			// Finds the slot obj is registered at, for remove().
+			// If obj has a hook but we only have a void*, the hooked slots have to be searched.
+			uint32_t find_for_remove(void* obj, const DukRefHook* hook) const
+			{
+				uint32_t idx = find(obj, hook);
+				if (idx == NONE && hook == nullptr && hooked_count_ > 0) {
+					for (uint32_t i = 0; i < slots_.size(); i++) {
+						if (slots_[i].obj == obj && slots_[i].next == HOOKED)
+							return i;
+					}
+				}
+
+				return idx;
+			}
+
+			// Frees slot idx (which must be in use). Any handle to it becomes stale.
+			void remove(uint32_t idx, DukRefHook* hook)
+			{
+				Slot& slot = slots_[idx];
+
+				if (slot.next == HOOKED) {
+					// release the hook if we know where it is - otherwise (see find_for_remove)
+					// its handle is simply stale now, and will be reclaimed by the next insert
+					if (hook != nullptr && hook->mOwner == this && hook->mIndex == idx)
+						hook->mOwner = nullptr;
+					hooked_count_--;
+				} else {
+					index_.erase(slot.obj);
+				}
+
+				slot.obj = nullptr;
+				slot.heapptr = nullptr;
+				slot.type_info = nullptr;
+				slot.generation++;
+				slot.next = free_head_;
+				free_head_ = idx;
+			}
+
+			// true if slot idx is in use and holds heapptr
+			inline bool holds(uint32_t idx, void* heapptr) const {
+				return idx < slots_.size() && slots_[idx].obj != nullptr && slots_[idx].heapptr == heapptr;
+			}
+
+			inline const Slot& operator[](uint32_t idx) const {
+				return slots_[idx];
+			}
+
+			// number of registered objects
+			inline size_t size() const {
+				return index_.size() + hooked_count_;
+			}
+
+			// number of slots (in use or free), for iterating over every slot
+			inline uint32_t slot_count() const {
+				return static_cast<uint32_t>(slots_.size());
+			}
+
+		private:
+			static const uint32_t HOOKED = 0xFFFFFFFE;
+
+			inline bool is_live(const DukRefHook& hook) const {
+				return hook.mIndex < slots_.size() && slots_[hook.mIndex].generation == hook.mGeneration
+					&& slots_[hook.mIndex].obj != nullptr;
+			}
+
+			std::vector<Slot> slots_;
+			std::unordered_map<void*, uint32_t> index_;
+			uint32_t free_head_;
+			size_t hooked_count_;
+		};
+
+		// Returns the DukRefHook for obj, or NULL if T doesn't have one.
+		template<typename T>
+		inline typename std::enable_if<std::is_base_of<DukRefHook, T>::value, DukRefHook*>::type get_ref_hook(T* obj) {
+			return const_cast<DukRefHook*>(static_cast<const DukRefHook*>(obj));
+		}
+
+		template<typename T>
+		inline typename std::enable_if<!std::is_base_of<DukRefHook, T>::value, DukRefHook*>::type get_ref_hook(T* obj) {
+			return nullptr;
+		}
+	}
+}
@@ -2,7 +2,8 @@
 
 #include <duktape.h>
 
-#include <unordered_map>
+#include "detail_native_header.h"
+#include "detail_context_state.h"
 
 namespace dukglue
 {
@@ -10,25 +11,19 @@ namespace dukglue
 	{
 		// This class handles keeping a map of void* -> script object.
 		// It also prevents script objects from being GC'd until someone
-		// explicitly frees the underlying native object.
+		// explicitly frees the underlying native object - unless the object's class uses
+		// weak refs (see dukglue_set_weak_refs), in which case the script object is only
+		// remembered while something else keeps it alive.
 
-		// Implemented by keeping an array of script objects in the heap stash.
-		// An std::unordered_map maps pointer -> array index.
-		// Thanks to std::unordered_map, lookup time is O(1) on average.
+		// Implemented by keeping an array of script objects in the heap stash (ref_array),
+		// indexed by the slots of a native generational slot map (RefRegistry, in ContextState).
+		// Each slot also caches its script object's heap pointer (and type, for dukglue_invalidate_class),
+		// so pushing a registered object is a hash lookup plus duk_push_heapptr, with no property access
+		// at all, and invalidating one is a single lookup of its native header.
+		// Objects that inherit from DukRefHook skip the hash lookup too (see dukrefhook.h).
 
-		// Using std::unordered_map has some memory overhead (~32 bytes per object),
-		// which could be removed by using a different data structure:
-
-		// 1. Use no data structure. Blindly scan through the reference registry,
-		//    checking \xFFobj_ptr on every object until you find yours.
-		//    Performance when returning native objects from functions when a lot
-		//    of native objects are registered will suffer.
-
-		// 2. Implement a self-balancing binary tree on top of a Duktape array
-		//    for the registry. Still fast - O(log(N)) - and no memory overhead.
-
-		// 3. A sorted list would work too, though insertion speed might be worse
-		//    than a binary tree.
+		// Memory overhead is one slot (40 bytes) per object, plus an std::unordered_map node
+		// (~32 bytes) for objects without a DukRefHook.
 
 		struct RefManager
 		{
@@ -36,163 +31,213 @@ namespace dukglue
 
 			// Find the script object corresponding to obj_ptr and push it.
 			// Returns true if successful, false if obj_ptr has not been registered.
+			// hook is obj_ptr's DukRefHook, if it has one (see get_ref_hook).
 			// Stack: ... -> ...              (if object has been registered before)
 			//        ... -> ... [object]     (if object has not been registered)
-			static bool find_and_push_native_object(duk_context* ctx, void* obj_ptr)
+			static bool find_and_push_native_object(duk_context* ctx, void* obj_ptr, const DukRefHook* hook = NULL)
 			{
-				RefMap* ref_map = get_ref_map(ctx);
-
-				const auto it = ref_map->find(obj_ptr);
+				ContextState* state = ContextState::get(ctx);
 
-				if (it == ref_map->end()) {
+				const uint32_t idx = state->refs.find(obj_ptr, hook);
+				if (idx == RefRegistry::NONE)
 					return false;
-				} else {
-					push_ref_array(ctx);
-					duk_get_prop_index(ctx, -1, it->second);
-					duk_remove(ctx, -2);
-					return true;
-				}
+
+				duk_push_heapptr(ctx, state->refs[idx].heapptr);
+				return true;
 			}
 
 			// Takes a script object and adds it to the registry, associating
 			// it with obj_ptr. unregistered_object is not modified.
 			// If obj_ptr has already been registered with another object,
-			// the old registry entry will be overidden.
+			// the old registry entry will be overidden (and the old object invalidated:
+			// a new object can only be registered at the address of a dead one).
 			// Does nothing if obj_ptr is NULL.
+			// header is the object's native header; if its type uses weak refs, the object
+			// is registered weakly (see release_native_header).
 			// Stack: ... [object]  ->  ... [object]
-			static void register_native_object(duk_context* ctx, void* obj_ptr)
+			static void register_native_object(duk_context* ctx, void* obj_ptr, DukRefHook* hook = NULL, NativeHeader* header = NULL)
 			{
 				if (obj_ptr == NULL)
 					return;
 
-				RefMap* ref_map = get_ref_map(ctx);
-
-				push_ref_array(ctx);
-
-				// find next free index
-				// free indices are kept in a linked list, starting at ref_array[0]
-				duk_get_prop_index(ctx, -1, 0);
-				duk_uarridx_t next_free_idx = duk_get_uint(ctx, -1);
-				duk_pop(ctx);
-
-				if (next_free_idx == 0) {
-					// no free spots in the array, make a new one at arr.length
-					next_free_idx = duk_get_length(ctx, -1);
-				} else {
-					// free spot found, need to remove it from the free list
-					// ref_array[0] = ref_array[next_free_idx]
-					duk_get_prop_index(ctx, -1, next_free_idx);
-					duk_put_prop_index(ctx, -2, 0);
-				}
-
-				// std::cout << "putting reference at ref_array[" << next_free_idx << "]" << std::endl;
-				(*ref_map)[obj_ptr] = next_free_idx;
-
-				duk_dup(ctx, -2);  // put object on top
-
-				// ... [object] [ref_array] [object]
-				duk_put_prop_index(ctx, -2, next_free_idx);
-
+				if (header == NULL)
+					header = NativeHeader::get(ctx, -1);
+
+				ContextState* state = ContextState::get(ctx);
+				bool weak;
+				const uint32_t idx = insert(ctx, state, obj_ptr, hook, header, &weak);
+
+				// ref_array[idx] = object (keeps it alive), or undefined for weak objects
+				// (in case the slot still held a strong reference to a previous object for obj_ptr)
+				duk_push_heapptr(ctx, state->ref_array);
+				if (weak)
+					duk_push_undefined(ctx);
+				else
+					duk_dup(ctx, -2);
+				duk_put_prop_index(ctx, -2, idx);
 				duk_pop(ctx);  // pop ref_array
 			}
 
+			// Same as register_native_object, for registering many objects in a row: state and
+			// the ref array (at ref_array_idx, which must not be relative to the top) are already
+			// looked up, and header must not be NULL.
+			// Stack: ... [object]  ->  ... [object]
+			static void register_native_object(duk_context* ctx, ContextState* state, duk_idx_t ref_array_idx, void* obj_ptr, DukRefHook* hook, NativeHeader* header)
+			{
+				bool weak;
+				const uint32_t idx = insert(ctx, state, obj_ptr, hook, header, &weak);
+
+				if (weak)
+					duk_push_undefined(ctx);
+				else
+					duk_dup_top(ctx);
+				duk_put_prop_index(ctx, ref_array_idx, idx);
+			}
+
+
 			// Remove the object associated with obj_ptr from the registry
 			// and invalidate the object's internal native pointer (by setting it to undefined).
 			// Does nothing if obj_ptr if object was never registered or obj_ptr is NULL.
 			// Does not affect the stack.
-			static void find_and_invalidate_native_object(duk_context* ctx, void* obj_ptr)
+			static void find_and_invalidate_native_object(duk_context* ctx, void* obj_ptr, DukRefHook* hook = NULL)
 			{
 				if (obj_ptr == NULL)
 					return;
 
-				RefMap* ref_map = get_ref_map(ctx);
-				auto it = ref_map->find(obj_ptr);
-				if (it == ref_map->end())  // was never registered
+				// (may be called from finalizers while the heap is being destroyed,
+				// so don't create the state if it's already gone)
+				ContextState* state = ContextState::find(ctx);
+				if (state == NULL)
 					return;
 
-				push_ref_array(ctx);
-				duk_get_prop_index(ctx, -1, it->second);
-
-				// invalidate internal pointer
-				duk_push_undefined(ctx);
-				duk_put_prop_string(ctx, -2, "\xFF" "obj_ptr");
-				duk_pop(ctx);  // pop object
-
-				// remove from references array and add the space it was in to free list
-				// (refs[0] -> tail) -> (refs[0] -> old_obj_idx -> tail)
-
-				// refs[old_obj_idx] = refs[0]
-				duk_get_prop_index(ctx, -1, 0);
-				duk_put_prop_index(ctx, -2, it->second);
-
-				// refs[0] = old_obj_idx
-				duk_push_uint(ctx, it->second);
-				duk_put_prop_index(ctx, -2, 0);
+				const uint32_t idx = state->refs.find_for_remove(obj_ptr, hook);
+				if (idx == RefRegistry::NONE)  // was never registered
+					return;
 
+				duk_push_heapptr(ctx, state->ref_array);
+				invalidate_slot(ctx, state, idx, hook);
 				duk_pop(ctx);  // pop ref_array
-
-				// also remove from map
-				// std::cout << "Freeing ref_array[" << it->second << "]" << std::endl;
-				ref_map->erase(it);
 			}
 
-		private:
-			typedef std::unordered_map<void*, duk_uarridx_t> RefMap;
-
-			static RefMap* get_ref_map(duk_context* ctx)
+			// Invalidates every registered object for which pred(slot) returns true (see RefRegistry::Slot),
+			// in one pass over the registry. Returns the number of objects invalidated.
+			// Does not affect the stack.
+			template<typename Pred>
+			static size_t invalidate_matching(duk_context* ctx, Pred pred)
 			{
-				static const char* DUKGLUE_REF_MAP = "dukglue_ref_map";
-				static const char* PTR = "ptr";
+				ContextState* state = ContextState::find(ctx);
+				if (state == NULL)
+					return 0;
+
+				size_t count = 0;
+				duk_push_heapptr(ctx, state->ref_array);
+
+				const uint32_t slot_count = state->refs.slot_count();
+				for (uint32_t idx = 0; idx < slot_count; idx++) {
+					const RefRegistry::Slot& slot = state->refs[idx];
+					if (slot.obj != NULL && pred(slot)) {
+						invalidate_slot(ctx, state, idx, NULL);
+						count++;
+					}
+				}
 
-				duk_push_heap_stash(ctx);
+				duk_pop(ctx);  // pop ref_array
+				return count;
+			}
 
-				if (!duk_has_prop_string(ctx, -1, DUKGLUE_REF_MAP)) {
-					// doesn't exist yet, need to create it
-					duk_push_object(ctx);
+			// Finalizer for the prototypes of classes that use weak refs (see dukglue_set_weak_refs)
+			// and for embedded field wrappers: frees the object's native header (see release_native_header).
+			static duk_ret_t native_object_finalizer(duk_context* ctx)
+			{
+				NativeHeaderExt* ext = NULL;
+				NativeHeader* header = NativeHeader::get_own(ctx, 0, &ext);
+				release_native_header(ctx, 0, header, ext);
+				return 0;
+			}
 
-					duk_push_pointer(ctx, new RefMap());
-					duk_put_prop_string(ctx, -2, PTR);
+			// Frees the native header of the script object at idx (header is NativeHeader::get_own(ctx, idx, &ext),
+			// NULL for objects without one), which must be being finalized. Weakly registered objects
+			// are unregistered first, so the next push creates a new script object. (Pushing the object
+			// again before its finalizer runs rescues it instead - duk_push_heapptr cancels a pending
+			// finalizer - so identity is kept for as long as the object exists.)
+			// Finalizers of wrappers that own their object free it first, then call this.
+			static void release_native_header(duk_context* ctx, duk_idx_t idx, NativeHeader* header, NativeHeaderExt* ext)
+			{
+				if (header == NULL)
+					return;
 
-					duk_push_c_function(ctx, ref_map_finalizer, 1);
-					duk_set_finalizer(ctx, -2);
+				if (ext != NULL && (ext->flags & NativeHeader::WEAK)) {
+					// (the state is gone if the heap is being destroyed)
+					ContextState* state = ContextState::find(ctx);
 
-					duk_put_prop_string(ctx, -2, DUKGLUE_REF_MAP);
+					// the slot may have been invalidated (and reused) since this object was registered
+					if (state != NULL && state->refs.holds(ext->ref_slot, duk_get_heapptr(ctx, idx)))
+						state->refs.remove(ext->ref_slot, NULL);
 				}
 
-				duk_get_prop_string(ctx, -1, DUKGLUE_REF_MAP);
-				duk_get_prop_string(ctx, -1, PTR);
-				RefMap* map = static_cast<RefMap*>(duk_require_pointer(ctx, -1));
-				duk_pop_3(ctx);
-
-				return map;
+				NativeHeader::release(ctx, idx, header, ext);
 			}
 
-			static duk_ret_t ref_map_finalizer(duk_context* ctx)
+			// Pushes native_object_finalizer. The function object is made once per heap
+			// (it is kept alive by the heap stash), so this is cheap enough to call for every
+			// script object that needs its own finalizer.
+			static void push_native_object_finalizer(duk_context* ctx)
 			{
-				duk_get_prop_string(ctx, 0, "ptr");
-				RefMap* map = static_cast<RefMap*>(duk_require_pointer(ctx, -1));
-				delete map;
+				ContextState* state = ContextState::get(ctx);
+				if (state->native_finalizer == NULL) {
+					duk_push_heap_stash(ctx);
+					duk_push_c_function(ctx, native_object_finalizer, 1);
+					state->native_finalizer = duk_get_heapptr(ctx, -1);
+					duk_put_prop_string(ctx, -2, "dukglue_native_finalizer");
+					duk_pop(ctx);  // pop heap stash
+				}
 
-				return 0;
+				duk_push_heapptr(ctx, state->native_finalizer);
 			}
 
-			static void push_ref_array(duk_context* ctx)
+		private:
+			// Adds the object on top of the stack to the registry, and marks weak objects as such.
+			// Returns the slot index; the caller puts the object (or undefined, if *weak) in ref_array[idx].
+			static uint32_t insert(duk_context* ctx, ContextState* state, void* obj_ptr, DukRefHook* hook, NativeHeader* header, bool* weak)
 			{
-				static const char* DUKGLUE_REF_ARRAY = "dukglue_ref_array";
-				duk_push_heap_stash(ctx);
+				void* heapptr = duk_get_heapptr(ctx, -1);
+				void* replaced;
+				const uint32_t idx = state->refs.insert(obj_ptr, heapptr, header != NULL ? header->type_info : NULL, state->epoch, hook, &replaced);
+
+				// (nothing would free the old object's header after this)
+				if (replaced != NULL && replaced != heapptr) {
+					duk_push_heapptr(ctx, replaced);
+					NativeHeader::invalidate(ctx, state, -1);
+					duk_pop(ctx);
+				}
 
-				if (!duk_has_prop_string(ctx, -1, DUKGLUE_REF_ARRAY)) {
-					duk_push_array(ctx);
+				// (headers of classes that use weak refs are always NativeHeaderExts, see NativeHeader::create)
+				NativeHeaderExt* ext = (header != NULL && header->type_info->weak_refs()) ? NativeHeaderExt::get(ctx, -1) : NULL;
+				*weak = (ext != NULL);
+				if (*weak) {
+					ext->flags |= NativeHeader::WEAK;
+					ext->ref_slot = idx;
+				}
 
-					// ref_array[0] = 0 (initialize free list as empty)
-					duk_push_int(ctx, 0);
-					duk_put_prop_index(ctx, -2, 0);
+				return idx;
+			}
 
-					duk_put_prop_string(ctx, -2, DUKGLUE_REF_ARRAY);
-				}
+			// Invalidates the object in slot idx (which must be in use) and frees the slot.
+			// Stack: ... [ref_array]  ->  ... [ref_array]
+			static void invalidate_slot(duk_context* ctx, ContextState* state, uint32_t idx, DukRefHook* hook)
+			{
+				// invalidate internal pointer
+				// (the header is looked up through the script object: while the heap is being destroyed,
+				// a registered object may already have been finalized, which frees its header)
+				duk_push_heapptr(ctx, state->refs[idx].heapptr);
+				NativeHeader::invalidate(ctx, state, -1);
+				duk_pop(ctx);
+
+				// release our reference: ref_array[idx] = undefined
+				duk_push_undefined(ctx);
+				duk_put_prop_index(ctx, -2, idx);
 
-				duk_get_prop_string(ctx, -1, DUKGLUE_REF_ARRAY);
-				duk_remove(ctx, -2); // pop heap stash
+				state->refs.remove(idx, hook);
 			}
 		};
 	}
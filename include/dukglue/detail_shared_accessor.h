@@ -0,0 +1,132 @@
+#pragma once
+
+#include <duktape.h>
+
+#include "detail_magic_table.h"
+
+#include <functional>
+#include <string.h>
+
+// Duktape passes the property key to getters and setters as an extra argument
+// (getter: key; setter: value, key) unless these are disabled in duk_config.h.
+#if defined(DUK_USE_NONSTD_GETTER_KEY_ARGUMENT) && defined(DUK_USE_NONSTD_SETTER_KEY_ARGUMENT)
+#define DUKGLUE_SHARED_ACCESSORS 1
+#endif
+
+namespace dukglue
+{
+	namespace detail
+	{
+		// Accessor functions shared by every property of a prototype that has the same accessor signature
+		// (see dukglue_register_property_shared). The shared function tells the properties apart by the
+		// key argument: its "\xFF" "accessor_slots" buffer maps key (heap pointer of the interned key
+		// string, kept alive by the property itself) -> magic value of the accessor method, sorted by key.
+		// So each property costs a table entry per accessor instead of two function objects, two MethodHolders
+		// and two finalizers. (If script deletes the property, its entry stays behind. That is harmless, since
+		// the function can only be called for keys it is installed under.)
+
+		// Without the key argument (DUKGLUE_SHARED_ACCESSORS not defined) every property gets its own
+		// function with the magic value set on it, which still skips the MethodHolder and finalizer.
+		struct SharedAccessor
+		{
+			struct Slot {
+				void* key;
+				duk_int_t magic;
+			};
+
+			// Returns the magic value for the property being accessed by the current (shared) function.
+			// key_idx is the index of the key argument.
+			static duk_int_t current_magic(duk_context* ctx, duk_idx_t key_idx)
+			{
+#ifdef DUKGLUE_SHARED_ACCESSORS
+				void* key = duk_get_heapptr(ctx, key_idx);
+
+				duk_push_current_function(ctx);
+				duk_get_prop_string(ctx, -1, "\xFF" "accessor_slots");
+				duk_size_t size = 0;
+				const Slot* slots = static_cast<const Slot*>(duk_get_buffer(ctx, -1, &size));
+				duk_pop_2(ctx);
+
+				const size_t count = size / sizeof(Slot);
+				const size_t idx = lower_bound(slots, count, key);
+				if (key == nullptr || idx == count || slots[idx].key != key)
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Shared accessor called for an unknown property");
+
+				return slots[idx].magic;
+#else
+				return duk_get_current_magic(ctx);
+#endif
+			}
+
+			// Stack: ... [key] -> ... [key] [func]
+			// Pushes the accessor function to use for the property key (on top of the stack) on the
+			// prototype at proto_idx, and maps key -> magic for it. func is created at most once per
+			// prototype, and kept as a hidden property of the prototype.
+			// If magic_used is false, func doesn't look up magic (it just throws, for example) and is only shared.
+			static void push(duk_context* ctx, duk_idx_t proto_idx, duk_c_function func, duk_idx_t nargs, duk_int_t magic, bool magic_used = true)
+			{
+				proto_idx = duk_normalize_index(ctx, proto_idx);
+
+#ifdef DUKGLUE_SHARED_ACCESSORS
+				// one hidden property per distinct func
+				const int func_id = static_cast<int>(MagicTable<duk_c_function>::intern(ctx, func));
+				duk_push_sprintf(ctx, "\xFF" "shared_accessor_%d", func_id);
+				if (!duk_get_prop(ctx, proto_idx)) {
+					duk_pop(ctx);
+
+					duk_push_c_function(ctx, func, nargs);
+					duk_push_dynamic_buffer(ctx, 0);
+					duk_put_prop_string(ctx, -2, "\xFF" "accessor_slots");
+
+					duk_push_sprintf(ctx, "\xFF" "shared_accessor_%d", func_id);
+					duk_dup(ctx, -2);
+					duk_put_prop(ctx, proto_idx);
+				}
+
+				if (magic_used) {
+					duk_get_prop_string(ctx, -1, "\xFF" "accessor_slots");
+					set_slot(ctx, -1, duk_get_heapptr(ctx, -3), magic);
+					duk_pop(ctx);
+				}
+#else
+				duk_push_c_function(ctx, func, nargs);
+				duk_set_magic(ctx, -1, magic);
+#endif
+			}
+
+		private:
+			// first slot with slot.key >= key
+			static inline size_t lower_bound(const Slot* slots, size_t count, void* key)
+			{
+				size_t lo = 0, hi = count;
+				while (lo < hi) {
+					const size_t mid = lo + (hi - lo) / 2;
+					if (std::less<void*>()(slots[mid].key, key))
+						lo = mid + 1;
+					else
+						hi = mid;
+				}
+				return lo;
+			}
+
+			// adds or replaces key's slot in the dynamic buffer at buf_idx
+			static void set_slot(duk_context* ctx, duk_idx_t buf_idx, void* key, duk_int_t magic)
+			{
+				duk_size_t size = 0;
+				Slot* slots = static_cast<Slot*>(duk_get_buffer(ctx, buf_idx, &size));
+				size_t count = size / sizeof(Slot);
+				const size_t idx = lower_bound(slots, count, key);
+
+				if (idx < count && slots[idx].key == key) {
+					slots[idx].magic = magic;
+					return;
+				}
+
+				slots = static_cast<Slot*>(duk_resize_buffer(ctx, buf_idx, (count + 1) * sizeof(Slot)));
+				memmove(&slots[idx + 1], &slots[idx], (count - idx) * sizeof(Slot));
+				slots[idx].key = key;
+				slots[idx].magic = magic;
+			}
+		};
+	}
+}
@@ -7,8 +7,27 @@
 
 #include <duktape.h>
 
+#include <tuple>
+#include <type_traits>
+
 namespace dukglue
 {
+	// Default values for the last sizeof...(Ts) arguments of a function or method,
+	// see dukglue_register_function / dukglue_register_method. Make one with dukglue::defaults(...).
+	template<typename... Ts>
+	struct Defaults
+	{
+		std::tuple<Ts...> values;
+	};
+
+	//   dukglue_register_function(ctx, &drawText, "drawText", dukglue::defaults(12, std::string("sans")));
+	// lets script call drawText("hi"), drawText("hi", 14) or drawText("hi", undefined, "serif").
+	template<typename... Ts>
+	inline Defaults<typename std::decay<Ts>::type...> defaults(Ts&&... values)
+	{
+		return Defaults<typename std::decay<Ts>::type...>{ std::tuple<typename std::decay<Ts>::type...>(std::forward<Ts>(values)...) };
+	}
+
 	namespace detail
 	{
 		// Helper to get the argument tuple type, with correct storage types.
@@ -23,12 +42,14 @@ namespace dukglue
 		// A concrete example:
 		//   get_values<int, bool>(duktape_context)
 		//     get_values_helper<{int, bool}, {0, 1}>(ctx, ignored)
-		//       std::make_tuple<int, bool>(read<int>(ctx, 0), read<bool>(ctx, 1))
+		//       std::tuple<int, bool>{ read<int>(ctx, 0), read<bool>(ctx, 1) }
+		// Each value is moved from read()'s return value into the tuple (no copies),
+		// and the braced initializer guarantees arguments are read left to right.
 		template<typename... Args, size_t... Indexes>
 		typename ArgsTuple<Args...>::type get_stack_values_helper(duk_context* ctx, dukglue::detail::index_tuple<Indexes...>)
 		{
 			using namespace dukglue::types;
-			return std::forward_as_tuple(DukType<typename Bare<Args>::type>::template read<typename ArgStorage<Args>::type>(ctx, Indexes)...);
+			return typename ArgsTuple<Args...>::type{ ArgReader<Args>::read(ctx, Indexes)... };
 		}
 
 		// Returns an std::tuple of the values asked for in the template parameters.
@@ -47,5 +68,58 @@ namespace dukglue
 			auto indices = typename dukglue::detail::make_indexes<Args...>::type();
 			return get_stack_values_helper<Args...>(ctx, indices);
 		}
+
+		// Reads argument Index, which has no default value.
+		template<typename Arg, size_t Index, size_t FirstDefault, bool HasDefault = (Index >= FirstDefault)>
+		struct ArgOrDefault
+		{
+			typedef typename dukglue::types::ArgStorage<Arg>::type StorageType;
+
+			template<typename DefaultsTuple>
+			static inline StorageType read(duk_context* ctx, const DefaultsTuple& defaults)
+			{
+				return dukglue::types::ArgReader<Arg>::read(ctx, Index);
+			}
+		};
+
+		// Reads argument Index, or copies its default value if the argument is undefined.
+		// (Missing arguments are undefined too: Duktape pads the stack up to the function's nargs,
+		// so this costs one type check and no extra stack operations.)
+		template<typename Arg, size_t Index, size_t FirstDefault>
+		struct ArgOrDefault<Arg, Index, FirstDefault, true>
+		{
+			typedef typename dukglue::types::ArgStorage<Arg>::type StorageType;
+
+			template<typename DefaultsTuple>
+			static inline StorageType read(duk_context* ctx, const DefaultsTuple& defaults)
+			{
+				typedef typename std::tuple_element<Index - FirstDefault, DefaultsTuple>::type DefaultType;
+				static_assert(std::is_convertible<const DefaultType&, StorageType>::value,
+					"Default value can't be converted to the argument type");
+
+				if (duk_is_undefined(ctx, Index))
+					return StorageType(std::get<Index - FirstDefault>(defaults));
+
+				return ArgOrDefault<Arg, Index, FirstDefault, false>::read(ctx, defaults);
+			}
+		};
+
+		template<typename... Args, typename... DefaultTs, size_t... Indexes>
+		typename ArgsTuple<Args...>::type get_stack_values_helper(duk_context* ctx, const std::tuple<DefaultTs...>& defaults, dukglue::detail::index_tuple<Indexes...>)
+		{
+			return typename ArgsTuple<Args...>::type{
+				ArgOrDefault<Args, Indexes, sizeof...(Args) - sizeof...(DefaultTs)>::read(ctx, defaults)... };
+		}
+
+		// Same as get_stack_values, but the last sizeof...(DefaultTs) arguments are optional:
+		// an undefined (or missing) argument is replaced with its value from defaults.
+		template<typename... Args, typename... DefaultTs>
+		typename ArgsTuple<Args...>::type get_stack_values(duk_context* ctx, const std::tuple<DefaultTs...>& defaults)
+		{
+			static_assert(sizeof...(DefaultTs) <= sizeof...(Args), "More default values than arguments");
+
+			auto indices = typename dukglue::detail::make_indexes<Args...>::type();
+			return get_stack_values_helper<Args...>(ctx, defaults, indices);
+		}
 	}
 }
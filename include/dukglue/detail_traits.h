@@ -50,6 +50,10 @@ namespace dukglue
         // This mess is used to use function arugments stored in an std::tuple to an
         // std::function, function pointer, or method.
 
+        // The tuple is taken by rvalue reference and each element is forwarded straight
+        // into the call, so by-value arguments (std::string, std::vector, DukValue...)
+        // are moved out of the tuple rather than copied.
+
         // std::function
         template<class Ret, class... Args, size_t... Indexes >
         Ret apply_helper(std::function<Ret(Args...)> pf, index_tuple< Indexes... >, std::tuple<Args...>&& tup)
@@ -58,9 +62,9 @@ namespace dukglue
         }
 
         template<class Ret, class ... Args>
-        Ret apply(std::function<Ret(Args...)> pf, const std::tuple<Args...>&  tup)
+        Ret apply(std::function<Ret(Args...)> pf, std::tuple<Args...>&& tup)
         {
-            return apply_helper(pf, typename make_indexes<Args...>::type(), std::tuple<Args...>(tup));
+            return apply_helper(pf, typename make_indexes<Args...>::type(), std::move(tup));
         }
 
         // function pointer
@@ -71,9 +75,9 @@ namespace dukglue
         }
 
         template<class Ret, class ... Args, class ... BakedArgs>
-        Ret apply_fp(Ret(*pf)(Args...), const std::tuple<BakedArgs...>&  tup)
+        Ret apply_fp(Ret(*pf)(Args...), std::tuple<BakedArgs...>&& tup)
         {
-            return apply_fp_helper(pf, typename make_indexes<BakedArgs...>::type(), std::tuple<BakedArgs...>(tup));
+            return apply_fp_helper(pf, typename make_indexes<BakedArgs...>::type(), std::move(tup));
         }
 
         // method pointer
@@ -84,9 +88,9 @@ namespace dukglue
         }
 
         template<class Cls, class Ret, class ... Args, class... BakedArgs>
-        Ret apply_method(Ret(Cls::*pf)(Args...), Cls* obj, const std::tuple<BakedArgs...>& tup)
+        Ret apply_method(Ret(Cls::*pf)(Args...), Cls* obj, std::tuple<BakedArgs...>&& tup)
         {
-            return apply_method_helper(pf, typename make_indexes<Args...>::type(), obj, std::tuple<BakedArgs...>(tup));
+            return apply_method_helper(pf, typename make_indexes<Args...>::type(), obj, std::move(tup));
         }
 
         // const method pointer
@@ -97,22 +101,22 @@ namespace dukglue
         }
 
         template<class Cls, class Ret, class ... Args, class... BakedArgs>
-        Ret apply_method(Ret(Cls::*pf)(Args...) const, Cls* obj, const std::tuple<BakedArgs...>& tup)
+        Ret apply_method(Ret(Cls::*pf)(Args...) const, Cls* obj, std::tuple<BakedArgs...>&& tup)
         {
-            return apply_method_helper(pf, typename make_indexes<Args...>::type(), obj, std::tuple<BakedArgs...>(tup));
+            return apply_method_helper(pf, typename make_indexes<Args...>::type(), obj, std::move(tup));
         }
 
-        // constructor
-        template<class Cls, typename... Args, size_t... Indexes >
-        Cls* apply_constructor_helper(index_tuple< Indexes... >, std::tuple<Args...>&& tup)
+        // constructor (through an allocator policy, see allocators.h)
+        template<class Cls, class Allocator, typename... Args, size_t... Indexes >
+        Cls* apply_constructor_helper(void* alloc_data, void** owner, index_tuple< Indexes... >, std::tuple<Args...>&& tup)
         {
-            return new Cls(std::forward<Args>(std::get<Indexes>(tup))...);
+            return Allocator::template create<Cls>(alloc_data, owner, std::forward<Args>(std::get<Indexes>(tup))...);
         }
 
-        template<class Cls, typename... Args>
-        Cls* apply_constructor(const std::tuple<Args...>& tup)
+        template<class Cls, class Allocator, typename... Args>
+        Cls* apply_constructor(void* alloc_data, void** owner, std::tuple<Args...>&& tup)
         {
-            return apply_constructor_helper<Cls>(typename make_indexes<Args...>::type(), std::tuple<Args...>(tup));
+            return apply_constructor_helper<Cls, Allocator>(alloc_data, owner, typename make_indexes<Args...>::type(), std::move(tup));
         }
 
         //////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <duktape.h>
+
+#include "detail_context_state.h"
+
+#include <stdint.h>  // for uintptr_t
+#include <string.h>  // for memcpy, strcmp
+#include <type_traits>
+
+namespace dukglue
+{
+	namespace detail
+	{
+		// true if Object.prototype.toString gives "[object <class_name>]" for the object at idx.
+		// Duktape takes that name from the object's internal class, so unlike instanceof (or the
+		// constructor property) script can't change it: an Int32Array stays an Int32Array after
+		// Object.setPrototypeOf or replacing the global Float32Array. The function is the one
+		// cached when the context's state was created, so replacing it later doesn't matter either.
+		inline bool has_class_name(duk_context* ctx, duk_idx_t idx, const char* class_name)
+		{
+			ContextState* state = ContextState::get(ctx);
+			if (state->object_to_string == NULL)
+				return false;
+
+			idx = duk_normalize_index(ctx, idx);
+			duk_push_heapptr(ctx, state->object_to_string);
+			duk_dup(ctx, idx);
+			duk_call_method(ctx, 0);
+
+			const char* tag = duk_get_string(ctx, -1);
+			const size_t len = strlen(class_name);
+			const bool matches = tag != NULL && strncmp(tag, "[object ", 8) == 0
+				&& strncmp(tag + 8, class_name, len) == 0 && strcmp(tag + 8 + len, "]") == 0;
+			duk_pop(ctx);
+			return matches;
+		}
+
+		// The TypedArray that holds elements of type T, for numeric vectors (see DukType<std::vector<T>>).
+		// Vectors of these types are pushed as a TypedArray filled with one memcpy, and read from a
+		// matching TypedArray with one memcpy. Other element types (bool, 64-bit integers,
+		// which have no TypedArray in Duktape) use plain arrays.
+		// Define DUKGLUE_NO_TYPED_ARRAYS to push every vector as a plain array.
+		template<typename T, typename Enable = void>
+		struct TypedArray {
+			typedef std::false_type Supported;
+		};
+
+		template<typename T>
+		struct TypedArray<T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>::type>
+		{
+		private:
+			static const bool isFloat = std::is_floating_point<T>::value;
+			static const bool isSigned = std::is_signed<T>::value;
+
+		public:
+			static const duk_uint_t flags =
+				isFloat ? (sizeof(T) == 4 ? DUK_BUFOBJ_FLOAT32ARRAY : DUK_BUFOBJ_FLOAT64ARRAY)
+				: sizeof(T) == 1 ? (isSigned ? DUK_BUFOBJ_INT8ARRAY : DUK_BUFOBJ_UINT8ARRAY)
+				: sizeof(T) == 2 ? (isSigned ? DUK_BUFOBJ_INT16ARRAY : DUK_BUFOBJ_UINT16ARRAY)
+				: (isSigned ? DUK_BUFOBJ_INT32ARRAY : DUK_BUFOBJ_UINT32ARRAY);
+
+			typedef std::integral_constant<bool, isFloat ? (sizeof(T) == 4 || sizeof(T) == 8)
+				: (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4)> Supported;
+
+			// name of the global constructor, for checking the type of an argument
+			static const char* constructor_name()
+			{
+				switch (flags) {
+				case DUK_BUFOBJ_INT8ARRAY: return "Int8Array";
+				case DUK_BUFOBJ_UINT8ARRAY: return "Uint8Array";
+				case DUK_BUFOBJ_INT16ARRAY: return "Int16Array";
+				case DUK_BUFOBJ_UINT16ARRAY: return "Uint16Array";
+				case DUK_BUFOBJ_INT32ARRAY: return "Int32Array";
+				case DUK_BUFOBJ_UINT32ARRAY: return "Uint32Array";
+				case DUK_BUFOBJ_FLOAT32ARRAY: return "Float32Array";
+				default: return "Float64Array";
+				}
+			}
+
+			// true if the value at idx is a TypedArray with elements of type T
+			// (other TypedArrays, and anything indexable, can still be read element by element)
+			static bool is_typed_array(duk_context* ctx, duk_idx_t idx)
+			{
+				if (!duk_is_buffer_data(ctx, idx) || !duk_is_object(ctx, idx))
+					return false;
+
+				return has_class_name(ctx, idx, constructor_name());
+			}
+
+			// true if data (from duk_get_buffer_data on a TypedArray) can be used as a T*:
+			// byteOffset is a multiple of the element size, but the buffer itself
+			// (e.g. an external buffer, or the .buffer of a byte view) may not be aligned for T
+			static bool is_aligned(const void* data)
+			{
+				return reinterpret_cast<uintptr_t>(data) % std::alignment_of<T>::value == 0;
+			}
+
+			// pushes a new TypedArray holding a copy of count elements from data
+			static void push_copy(duk_context* ctx, const T* data, size_t count)
+			{
+				const duk_size_t size = count * sizeof(T);
+				void* buf = duk_push_fixed_buffer(ctx, size);
+				if (size > 0)
+					memcpy(buf, data, size);
+
+				duk_push_buffer_object(ctx, -1, 0, size, flags);
+				duk_remove(ctx, -2);  // plain buffer, now referenced by the TypedArray
+			}
+		};
+	}
+}
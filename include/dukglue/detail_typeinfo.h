@@ -1,6 +1,13 @@
 #pragma once
 
 #include <typeindex>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstddef>
+#include <stdint.h>
 
 namespace dukglue
 {
@@ -27,25 +34,105 @@ namespace dukglue
 				return "unknown";
 		}
 
+		// A small number for each C++ type, handed out in order of first use (by TypeInfo, or as a cast target),
+		// so cast tables can be searched by comparing integers instead of std::type_index.
+		inline uint32_t type_id(const std::type_index& type)
+		{
+			static std::mutex mutex;
+			static std::unordered_map<std::type_index, uint32_t> ids;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = ids.find(type);
+			if (it != ids.end())
+				return it->second;
+
+			const uint32_t id = static_cast<uint32_t>(ids.size());
+			ids.emplace(type, id);
+			return id;
+		}
+
+		// type_id(typeid(T)), looked up once per T
+		template<typename T>
+		struct TypeId {
+			static inline uint32_t get() {
+				static const uint32_t id = type_id(typeid(T));
+				return id;
+			}
+		};
+
+		// Runtime type information for a registered class.
+		// Each TypeInfo keeps a flattened cast table: one entry for the type itself, plus one entry
+		// for every (direct or indirect) base class registered with dukglue_set_base_class, holding
+		// the pointer adjustment from this type to that base. The table is sorted by type_id, so a
+		// cast is one binary search over this type's own entries (usually just one), with no recursion
+		// through the hierarchy, and its size doesn't depend on how many types exist. It's also
+		// correct for multiple inheritance, where a base class subobject may not start at the same
+		// address as the derived object.
+		// The table is rebuilt (for this type and everything derived from it) when a base is added,
+		// which only happens during registration.
 		class TypeInfo
 		{
 		public:
-			TypeInfo(std::type_index&& idx) : index_(idx), base_(nullptr) {}
-			TypeInfo(const TypeInfo& rhs) : index_(rhs.index_), base_(rhs.base_) {}
+			TypeInfo(std::type_index&& idx) : index_(idx), id_(type_id(idx)), weak_refs_(false) {
+				CastEntry self = { id_, 0 };
+				casts_.push_back(self);
+			}
+
+			// other TypeInfos point to this one (see add_base), so it can't be copied
+			TypeInfo(const TypeInfo& rhs) = delete;
+			TypeInfo& operator=(const TypeInfo& rhs) = delete;
+
+			// Registers base as a base class of this type. A pointer to this type plus
+			// offset (in bytes) gives a pointer to the base class subobject.
+			void add_base(TypeInfo* base, std::ptrdiff_t offset) {
+				for (BaseEntry& entry : bases_) {
+					if (entry.info == base) {
+						entry.offset = offset;
+						rebuild_casts();
+						return;
+					}
+				}
+
+				BaseEntry entry = { base, offset };
+				bases_.push_back(entry);
+				base->derived_.push_back(this);
+				rebuild_casts();
+			}
 
-			inline void set_base(TypeInfo* base) {
-				base_ = base;
+			// true if a base class has been registered for this type
+			inline bool has_base() const {
+				return !bases_.empty();
 			}
 
+			// if true, script objects for this (run-time) type are not kept alive by the
+			// native object registry (see dukglue_set_weak_refs)
+			inline bool weak_refs() const {
+				return weak_refs_;
+			}
+
+			inline void set_weak_refs(bool weak) {
+				weak_refs_ = weak;
+			}
+
+			template<typename T>
+			inline bool can_cast() const {
+				return find_offset(TypeId<T>::get()) != nullptr;
+			}
+
+			// Converts obj (which must point to an object of exactly this type)
+			// to a T*, adjusting the pointer if necessary.
+			// Returns NULL if obj is NULL or this type can't be cast to T.
 			template<typename T>
-			bool can_cast() const {
-				if (index_ == typeid(T))
-					return true;
+			inline T* cast(void* obj) const {
+				const std::ptrdiff_t* offset = find_offset(TypeId<T>::get());
+				if (obj == nullptr || offset == nullptr)
+					return nullptr;
 
-				if (base_)
-					return base_->can_cast<T>();
+				return static_cast<T*>(static_cast<void*>(static_cast<char*>(obj) + *offset));
+			}
 
-				return false;
+			inline const std::type_index& index() const {
+				return index_;
 			}
 
 			inline bool operator<(const TypeInfo& rhs) const { return index_ < rhs.index_; }
@@ -56,8 +143,104 @@ namespace dukglue
 			inline bool operator!=(const TypeInfo& rhs) const { return index_ != rhs.index_; }
 
 		private:
+			struct CastEntry {
+				uint32_t id;  // type_id of the target type
+				std::ptrdiff_t offset;
+			};
+
+			struct BaseEntry {
+				TypeInfo* info;
+				std::ptrdiff_t offset;
+			};
+
+			static inline bool id_less(const CastEntry& entry, uint32_t id) {
+				return entry.id < id;
+			}
+
+			inline const std::ptrdiff_t* find_offset(uint32_t id) const {
+				auto it = std::lower_bound(casts_.begin(), casts_.end(), id, id_less);
+				if (it == casts_.end() || it->id != id)
+					return nullptr;
+				return &it->offset;
+			}
+
+			void rebuild_casts() {
+				casts_.clear();
+				CastEntry self = { id_, 0 };
+				casts_.push_back(self);
+
+				// bases registered first take priority if a (non-virtual) base appears twice
+				for (const BaseEntry& base : bases_) {
+					for (const CastEntry& base_cast : base.info->casts_) {
+						if (!has_cast(base_cast.id)) {
+							CastEntry entry = { base_cast.id, base.offset + base_cast.offset };
+							casts_.push_back(entry);
+						}
+					}
+				}
+
+				std::sort(casts_.begin(), casts_.end(), [](const CastEntry& a, const CastEntry& b) {
+					return a.id < b.id;
+				});
+
+				for (TypeInfo* derived : derived_)
+					derived->rebuild_casts();
+			}
+
+			// (while rebuilding, before casts_ is sorted)
+			bool has_cast(uint32_t id) const {
+				for (const CastEntry& entry : casts_) {
+					if (entry.id == id)
+						return true;
+				}
+				return false;
+			}
+
 			std::type_index index_;
-			TypeInfo* base_;
+			uint32_t id_;
+			std::vector<CastEntry> casts_;  // sorted by id, one entry per type (including this one)
+			std::vector<BaseEntry> bases_;
+			std::vector<TypeInfo*> derived_;  // types that list this type as a base
+			bool weak_refs_;
 		};
+
+		// Pointer adjustment from Derived* to Base* (see TypeInfo::add_base).
+		// Only valid for non-virtual bases, where the adjustment is a constant: static_cast only does
+		// arithmetic on the pointer and never touches the object, so any suitably aligned non-null
+		// address works (and no Derived has to be allocated, on the stack or anywhere else).
+		template<class Base, class Derived>
+		std::ptrdiff_t base_class_offset() {
+			Derived* derived = reinterpret_cast<Derived*>(static_cast<uintptr_t>(alignof(Derived)) * 4096);
+			Base* base = static_cast<Base*>(derived);
+			return reinterpret_cast<char*>(base) - reinterpret_cast<char*>(derived);
+		}
+
+		// Base is a non-virtual, unambiguous base of Derived if we can static_cast from Base* to Derived*.
+		template<class Base, class Derived>
+		struct is_static_base_of {
+		private:
+			template<class B, class D>
+			static auto test(int) -> decltype(static_cast<D*>(std::declval<B*>()), std::true_type());
+
+			template<class, class>
+			static std::false_type test(...);
+
+		public:
+			static const bool value = decltype(test<Base, Derived>(0))::value;
+		};
+
+		// Returns a pointer to the most-derived object obj is part of.
+		// The reference registry and native headers always store this pointer, so an object
+		// pushed through pointers to different base classes still maps to the same script object.
+		// (For non-polymorphic types we can't know the real type, so this is just obj.)
+		template<typename T>
+		inline typename std::enable_if<std::is_polymorphic<T>::value, void*>::type most_derived_ptr(T* obj) {
+			return const_cast<void*>(dynamic_cast<const void*>(obj));
+		}
+
+		template<typename T>
+		inline typename std::enable_if<!std::is_polymorphic<T>::value, void*>::type most_derived_ptr(T* obj) {
+			return const_cast<void*>(static_cast<const void*>(obj));
+		}
 	}
 }
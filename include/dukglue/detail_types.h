@@ -1,11 +1,19 @@
 #pragma once
 
 #include <type_traits>
+#include <string>
+#include <vector>
+#include <map>
 
 #include "detail_refs.h"
 #include "detail_typeinfo.h"
 #include "detail_class_proto.h"
 
+// C++17 library types (std::string_view, ...) get DukType specializations when available
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define DUKGLUE_HAS_CXX17 1
+#endif
+
 // TODO try adding a using namespace std in here if I can scope it to just this file
 
 namespace dukglue {
@@ -29,9 +37,10 @@ namespace dukglue {
 		// There are two kinds of DukTypes:
 		//   1. "Native" DukTypes. This is the default.
 		//      These types use an underlying native object allocated on the heap.
-		//      A pointer to the object (of type T*) is expected at script_object.\xFFobj_ptr.
+		//      A pointer to the object (of type T*) is expected in the script object's native header
+		//      (script_object.\xFFnative, see detail_native_header.h).
 		//      "Native" DukTypes can return a value (returns a copy-constructed T from the native object),
-		//      a pointer (just returns script_object.\xFFobj_ptr), or a reference (dereferences script_object.\xFFobj_ptr if it is not null).
+		//      a pointer (just returns the header's obj), or a reference (dereferences the header's obj if it is not null).
 
 		//   2. "Value" DukTypes. These are implemented through template specialization.
 		//      This is how primitive types are implemented (int, float, const char*).
@@ -60,24 +69,23 @@ namespace dukglue {
 					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected native object, got %s", arg_idx, get_type_name(type_idx));
 				}
 
-				duk_get_prop_string(ctx, arg_idx, "\xFF" "type_info");
-				if (!duk_is_pointer(ctx, -1))  // missing type_info, must not be a native object
-					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected native object (missing type_info)", arg_idx);
-
-				// make sure this object can be safely returned as a T*
-				TypeInfo* info = static_cast<TypeInfo*>(duk_get_pointer(ctx, -1));
-				if (!info->can_cast<T>())
-					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: wrong type of native object", arg_idx);
+				NativeHeader* header = NativeHeader::get(ctx, arg_idx);
+				if (header == nullptr) {
+					// (invalidating a plain object frees its header, see NativeHeader::invalidate)
+					if (duk_has_prop_string(ctx, arg_idx, "\xFF" "native"))
+						duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: invalid native object.", arg_idx);
 
-				duk_pop(ctx);  // pop type_info
+					// missing native header, must not be a native object
+					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: expected native object (missing native header)", arg_idx);
+				}
 
-				duk_get_prop_string(ctx, arg_idx, "\xFF" "obj_ptr");
-				if (!duk_is_pointer(ctx, -1))
+				if (header->obj == nullptr)
 					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: invalid native object.", arg_idx);
 
-				T* obj = static_cast<T*>(duk_get_pointer(ctx, -1));
-
-				duk_pop(ctx);  // pop obj_ptr
+				// make sure this object can be safely returned as a T* (adjusting the pointer if needed)
+				T* obj = header->type_info->cast<T>(header->obj);
+				if (obj == nullptr)
+					duk_error(ctx, DUK_RET_TYPE_ERROR, "Argument %d: wrong type of native object", arg_idx);
 
 				return obj;
 			}
@@ -109,10 +117,14 @@ namespace dukglue {
 			static void push(duk_context* ctx, T& value) {
 				using namespace dukglue::detail;
 
-				if (!RefManager::find_and_push_native_object(ctx, &value)) {
+				// objects are registered by their most-derived address, so pushing the same
+				// object through different base class pointers gives the same script object
+				void* obj_ptr = most_derived_ptr(&value);
+				DukRefHook* hook = get_ref_hook(&value);
+				if (!RefManager::find_and_push_native_object(ctx, obj_ptr, hook)) {
 					// need to create new script object
-					ProtoManager::make_script_object<T>(ctx, &value);
-					RefManager::register_native_object(ctx, &value);
+					NativeHeader* header = ProtoManager::make_script_object<T>(ctx, &value);
+					RefManager::register_native_object(ctx, obj_ptr, hook, header);
 				}
 			}
 
@@ -134,11 +146,30 @@ namespace dukglue {
 			}*/
 		};
 
+		// Containers a native function can take by non-const reference, to be refilled in place
+		// (with DukReadInto) instead of built from scratch on every call: see ScratchArg.
+		template<typename T>
+		struct IsScratchContainer : std::false_type {};
+
+		template<>
+		struct IsScratchContainer<std::string> : std::true_type {};
+
+		template<typename T>
+		struct IsScratchContainer< std::vector<T> > : std::true_type {};
+
+		template<typename T>
+		struct IsScratchContainer< std::map<std::string, T> > : std::true_type {};
+
+		template<typename T>
+		class ScratchArg;  // (see detail_primitive_types.h)
+
 		// Figure out what the type for an argument should be inside the tuple.
 		// If a function expects a reference to a value type, we need temporary storage for the value.
 		// For example, a reference to a value type (const int&) will need to be temporarily
 		// stored in the tuple, so ArgStorage<const int&>::type == int.
 		// Native objects are already allocated on the heap, so there's no problem storing, say, const Dog& in the tuple.
+		// Non-const references to containers that can be refilled in place (see IsScratchContainer)
+		// are stored as a ScratchArg.
 		template<typename T>
 		struct ArgStorage {
 		private:
@@ -146,15 +177,74 @@ namespace dukglue {
 			//typedef DukType<BareType> ThisDukType;
 			typedef typename DukType<BareType>::IsValueType IsValueType;
 
+			typedef std::integral_constant<bool, std::is_lvalue_reference<T>::value
+				&& !std::is_const<typename std::remove_reference<T>::type>::value
+				&& IsScratchContainer<BareType>::value> IsScratch;
+
 			static_assert(!IsValueType::value || !std::is_pointer<T>::value, "Cannot return pointer to value type.");
-			static_assert(!IsValueType::value ||
+			static_assert(!IsValueType::value || IsScratch::value ||
 				(!std::is_reference<T>::value || std::is_const<typename std::remove_reference<T>::type>::value),
 				"Value types can only be returned as const references.");
 
 		public:
-			typedef typename std::conditional<IsValueType::value, BareType, T>::type type;
+			typedef typename std::conditional<IsScratch::value, ScratchArg<BareType>,
+				typename std::conditional<IsValueType::value, BareType, T>::type>::type type;
+		};
+
+		// Reads argument arg_idx as Arg's storage type (see ArgStorage).
+		template<typename Arg, typename Storage = typename ArgStorage<Arg>::type>
+		struct ArgReader {
+			static inline Storage read(duk_context* ctx, duk_idx_t arg_idx) {
+				return DukType<typename Bare<Arg>::type>::template read<Storage>(ctx, arg_idx);
+			}
+		};
+
+		template<typename Arg, typename T>
+		struct ArgReader< Arg, ScratchArg<T> > {
+			static inline ScratchArg<T> read(duk_context* ctx, duk_idx_t arg_idx) {
+				return ScratchArg<T>::read(ctx, arg_idx);
+			}
 		};
 	}
+
+	namespace detail {
+		// Pushes an array of the script objects for objs[0..count), the same as pushing each one
+		// with DukType<Cls>::push<Cls*> (null pointers become null). For long vectors of native objects:
+		// the context state and ref array are looked up once instead of per object, and the prototype
+		// for new script objects only when the run-time type differs from the previous object's.
+		template<typename Cls>
+		void push_native_array(duk_context* ctx, Cls* const* objs, size_t count)
+		{
+			ContextState* state = ContextState::get(ctx);
+
+			const duk_idx_t arr_idx = duk_push_array(ctx);
+			duk_push_heapptr(ctx, state->ref_array);
+			const duk_idx_t ref_array_idx = arr_idx + 1;
+
+			ProtoManager::ProtoHint hint;
+			for (size_t i = 0; i < count; i++) {
+				Cls* obj = objs[i];
+				if (obj == nullptr) {
+					duk_push_null(ctx);
+				} else {
+					void* obj_ptr = most_derived_ptr(obj);
+					DukRefHook* hook = get_ref_hook(obj);
+
+					const uint32_t slot = state->refs.find(obj_ptr, hook);
+					if (slot != RefRegistry::NONE) {
+						duk_push_heapptr(ctx, state->refs[slot].heapptr);
+					} else {
+						NativeHeader* header = ProtoManager::make_script_object<Cls>(ctx, obj, hint);
+						RefManager::register_native_object(ctx, state, ref_array_idx, obj_ptr, hook, header);
+					}
+				}
+
+				duk_put_prop_index(ctx, arr_idx, static_cast<duk_uarridx_t>(i));
+			}
+
+			duk_pop(ctx);  // pop ref_array
+		}
+	}
 }
 
 #include "detail_primitive_types.h"
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+// A borrowed, non-owning view of the memory behind a script buffer (a plain buffer, ArrayBuffer,
+// TypedArray, DataView or Node.js Buffer). Works like a minimal std::span.
+
+// Reading a DukSpan<T> argument does not copy anything: it points directly into the buffer's
+// backing store, so a native function can read and write the script's bytes in place.
+// The buffer stays on the value stack (and so stays alive) for the duration of the native call.
+// Don't hold on to the span after your function returns.
+//   - DukSpan<uint8_t> / DukSpan<char> (1-byte elements) accept any buffer, as raw bytes
+//   - other element types need the matching TypedArray (DukSpan<float> needs a Float32Array, ...)
+// Pushing a DukSpan copies the elements into a new TypedArray (like std::vector).
+template<typename T>
+class DukSpan
+{
+public:
+	typedef T* iterator;
+	typedef T* const_iterator;
+
+	DukSpan() : mData(nullptr), mSize(0) {}
+	DukSpan(T* data, size_t size) : mData(data), mSize(size) {}
+
+	inline T* data() const { return mData; }
+	inline size_t size() const { return mSize; }
+	inline size_t size_bytes() const { return mSize * sizeof(T); }
+	inline bool empty() const { return mSize == 0; }
+
+	inline T& operator[](size_t i) const { return mData[i]; }
+
+	inline iterator begin() const { return mData; }
+	inline iterator end() const { return mData + mSize; }
+
+private:
+	T* mData;
+	size_t mSize;
+};
+
+// Native memory shared with script without copying. Pushing a DukSharedBuffer<T> creates a TypedArray
+// of T (Float32Array for float, Uint8Array for uint8_t, ...) over an external buffer that points at data(),
+// and keeps a copy of owner() until that TypedArray is garbage collected.
+// So data() must stay valid (and must not move) for as long as owner() is alive:
+//   std::shared_ptr<Frame> frame = decoder.next();
+//   return DukSharedBuffer<uint8_t>(frame->pixels, frame->size, frame);
+
+// Script can't be given a read-only view, so a DukSharedBuffer<const T> is pushed as a copy (like DukSpan).
+
+// Only the pushed TypedArray holds on to the owner. Objects that script creates from it (its .buffer,
+// subarray(), new Uint8Array(pixels.buffer), ...) share the memory but can't keep it alive, so when the
+// TypedArray is collected they are detached from the memory before the owner is released: their elements
+// read as 0 and writes are ignored. Keep the TypedArray itself for as long as script needs the data.
+
+// Reading a DukSharedBuffer<T> from a TypedArray that was pushed as one gives back the same memory
+// and owner. Any other buffer is copied into a new std::vector<T> (which becomes the owner).
+template<typename T>
+class DukSharedBuffer
+{
+public:
+	DukSharedBuffer() : mData(nullptr), mSize(0) {}
+	DukSharedBuffer(T* data, size_t size, std::shared_ptr<const void> owner)
+		: mData(data), mSize(size), mOwner(std::move(owner)) {}
+
+	// shares the vector's elements (don't resize the vector while script can see them)
+	DukSharedBuffer(const std::shared_ptr< std::vector<T> >& vec)
+		: mData(vec ? vec->data() : nullptr), mSize(vec ? vec->size() : 0), mOwner(vec) {}
+
+	inline T* data() const { return mData; }
+	inline size_t size() const { return mSize; }
+	inline size_t size_bytes() const { return mSize * sizeof(T); }
+	inline const std::shared_ptr<const void>& owner() const { return mOwner; }
+
+	inline DukSpan<T> span() const { return DukSpan<T>(mData, mSize); }
+
+private:
+	T* mData;
+	size_t mSize;
+	std::shared_ptr<const void> mOwner;
+};
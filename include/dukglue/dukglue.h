@@ -4,4 +4,8 @@
 #include "register_class.h"
 #include "register_property.h"
 #include "public_util.h"
-#include "dukvalue.h"
\ No newline at end of file
+#include "dukvalue.h"
+#include "dukstringview.h"
+#include "dukrefhook.h"
+#include "dukstruct.h"
+#include "dukpreparedcall.h"
\ No newline at end of file
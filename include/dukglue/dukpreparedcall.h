@@ -0,0 +1,153 @@
+#pragma once
+
+#include "dukvalue.h"
+#include "dukexception.h"
+#include "public_util.h"
+
+#include <tuple>
+#include <type_traits>
+
+namespace dukglue
+{
+	// A script function resolved once, for calling it many times from C++:
+	//   dukglue::PreparedCall<int(float, const std::string&)> onHit(ctx, "onHit");  // a global function
+	//   int damage = onHit(0.5f, "sword");
+
+	// Calling it works like dukglue_pcall<RetT>(ctx, func, args...): script errors (and a result
+	// that can't be read as RetT) are thrown as DukErrorException, and the result is popped.
+	// But each call is cheaper:
+	//   - the function is pinned once (by a DukValue) and pushed with duk_push_heapptr,
+	//     instead of going through the heap stash and the DukValue ref array every time
+	//   - arguments are pushed straight from the caller's references, as the types in the signature,
+	//     instead of being copied into a std::tuple first
+
+	// A PreparedCall can be copied (the copies share the pinned function), and must not outlive its heap.
+	template<typename Signature>
+	class PreparedCall;
+
+	template<typename RetT, typename... ArgTs>
+	class PreparedCall<RetT(ArgTs...)>
+	{
+	public:
+		// empty, calling it throws
+		PreparedCall() : mContext(nullptr), mFuncPtr(nullptr) {}
+
+		// func must be callable (throws DukException otherwise)
+		PreparedCall(duk_context* ctx, const DukValue& func) : mContext(ctx), mFuncPtr(nullptr)
+		{
+			func.push();
+			resolve();
+		}
+
+		// the global function called name (resolved now - replacing the global later doesn't affect this)
+		PreparedCall(duk_context* ctx, const char* name) : mContext(ctx), mFuncPtr(nullptr)
+		{
+			duk_get_global_string(ctx, name);
+			resolve();
+		}
+
+		inline bool valid() const {
+			return mContext != nullptr;
+		}
+
+		inline duk_context* context() const {
+			return mContext;
+		}
+
+		RetT operator()(const ArgTs&... args) const
+		{
+			if (mContext == nullptr)
+				throw DukException() << "Called an empty PreparedCall";
+
+			return call(std::is_void<RetT>(), args...);
+		}
+
+	private:
+		duk_context* mContext;
+		DukValue mFunc;  // keeps the function alive
+		void* mFuncPtr;  // the function's heap pointer, or NULL for lightfuncs (which are pushed from mFunc)
+
+		// Stack: ... [func]  ->  ...
+		void resolve()
+		{
+			if (!duk_is_callable(mContext, -1)) {
+				duk_pop(mContext);
+				mContext = nullptr;
+				throw DukException() << "PreparedCall: value is not callable";
+			}
+
+			mFuncPtr = duk_get_heapptr(mContext, -1);
+			mFunc = DukValue::take_from_stack(mContext);
+		}
+
+		struct CallData {
+			const PreparedCall* self;
+			std::tuple<const ArgTs&...> args;  // references to the caller's arguments, nothing is copied
+			RetT* out;
+		};
+
+		void call(std::true_type, const ArgTs&... args) const
+		{
+			CallData data{ this, std::tuple<const ArgTs&...>(args...), nullptr };
+
+			duk_int_t rc = duk_safe_call(mContext, &call_safe, (void*) &data, 0, 1);
+			if (rc != 0)
+				throw DukErrorException(mContext, rc);
+
+			duk_pop(mContext);  // remove result from stack
+		}
+
+		RetT call(std::false_type, const ArgTs&... args) const
+		{
+			// ArgStorage has some static_asserts in it that validate value types,
+			// so we typedef it to force ArgStorage<RetType> to compile and run the asserts
+			typedef typename dukglue::types::ArgStorage<RetT>::type ValidateReturnType;
+			typedef typename dukglue::types::ValidateOwnedResult<RetT>::type ValidateResultOwned;
+
+			RetT result;
+			CallData data{ this, std::tuple<const ArgTs&...>(args...), &result };
+
+			duk_int_t rc = duk_safe_call(mContext, &call_safe, (void*) &data, 0, 1);
+			if (rc != 0)
+				throw DukErrorException(mContext, rc);
+
+			duk_pop(mContext);  // remove result from stack
+			return result;
+		}
+
+		// leaves result on stack
+		// (the result is read in here, since reading it can throw a Duktape error)
+		static duk_ret_t call_safe(duk_context* ctx, void* udata)
+		{
+			CallData* data = static_cast<CallData*>(udata);
+
+			duk_require_stack(ctx, sizeof...(ArgTs) + 1);
+
+			if (data->self->mFuncPtr != nullptr)
+				duk_push_heapptr(ctx, data->self->mFuncPtr);
+			else
+				data->self->mFunc.push();
+
+			push_args(ctx, data->args, typename dukglue::detail::make_indexes<ArgTs...>::type());
+			duk_call(ctx, sizeof...(ArgTs));
+
+			read_result(ctx, data->out);
+			return 1;
+		}
+
+		template<size_t... Indexes>
+		static void push_args(duk_context* ctx, const std::tuple<const ArgTs&...>& args, dukglue::detail::index_tuple<Indexes...>)
+		{
+			int unused[] = { 0, (dukglue::types::DukType<typename dukglue::types::Bare<ArgTs>::type>::template push<ArgTs>(ctx, std::get<Indexes>(args)), 0)... };
+			(void) unused;
+		}
+
+		static void read_result(duk_context* ctx, void* out) {}
+
+		template<typename T>
+		static void read_result(duk_context* ctx, T* out)
+		{
+			dukglue_read(ctx, -1, out);
+		}
+	};
+}
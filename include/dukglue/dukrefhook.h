@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace dukglue {
+	namespace detail {
+		struct RefRegistry;
+	}
+}
+
+// Optional intrusive hook for native classes that are pushed to script a lot.
+// Inherit from DukRefHook and dukglue stores the object's registry handle (slot index + generation)
+// inside the object itself, so finding its script object does not need a hash lookup:
+
+//   class Entity : public DukRefHook { ... };
+
+// A hook holds one registration at a time. If the same object is pushed into several contexts,
+// the first one uses the hook and the others fall back to the hash map, which is always correct,
+// just slower. Copying an object does not copy its registration.
+
+// Objects with a hook should be invalidated through a typed pointer (dukglue_invalidate_object(ctx, this)
+// from a member function, for example). Invalidating through a void* still works, but has to
+// search the registry.
+class DukRefHook
+{
+public:
+	DukRefHook() : mOwner(nullptr), mIndex(0), mGeneration(0) {}
+	DukRefHook(const DukRefHook&) : mOwner(nullptr), mIndex(0), mGeneration(0) {}
+	DukRefHook& operator=(const DukRefHook&) { return *this; }
+
+private:
+	friend struct dukglue::detail::RefRegistry;
+
+	const dukglue::detail::RefRegistry* mOwner;
+	uint32_t mIndex;
+	uint32_t mGeneration;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <duktape.h>
+
+#include <string>
+#include <cstring>
+#include <ostream>
+
+// A borrowed, non-owning view of a script string (pointer + length).
+// Works like a minimal std::string_view, but is available in C++11.
+
+// Reading a DukStringView argument does not allocate or copy anything: it points
+// directly into the Duktape string, which stays on the value stack (and so stays alive)
+// for the duration of the native call. Don't hold on to it after your function returns -
+// copy it into a std::string (str()) if you need to keep it.
+// Pushing a DukStringView copies the characters into a new script string.
+class DukStringView
+{
+public:
+	typedef const char* const_iterator;
+
+	DukStringView() : mData(""), mSize(0) {}
+	DukStringView(const char* data, size_t size) : mData(data), mSize(size) {}
+	DukStringView(const char* str) : mData(str), mSize(strlen(str)) {}
+	DukStringView(const std::string& str) : mData(str.data()), mSize(str.size()) {}
+
+	inline const char* data() const { return mData; }
+	inline size_t size() const { return mSize; }
+	inline size_t length() const { return mSize; }
+	inline bool empty() const { return mSize == 0; }
+
+	inline char operator[](size_t i) const { return mData[i]; }
+
+	inline const_iterator begin() const { return mData; }
+	inline const_iterator end() const { return mData + mSize; }
+
+	// copies the viewed characters
+	inline std::string str() const { return std::string(mData, mSize); }
+
+	bool operator==(const DukStringView& rhs) const {
+		return mSize == rhs.mSize && (mSize == 0 || memcmp(mData, rhs.mData, mSize) == 0);
+	}
+
+	bool operator!=(const DukStringView& rhs) const {
+		return !(*this == rhs);
+	}
+
+private:
+	const char* mData;
+	size_t mSize;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const DukStringView& view)
+{
+	return os.write(view.data(), view.size());
+}
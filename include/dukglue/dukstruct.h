@@ -0,0 +1,208 @@
+#pragma once
+
+#include "detail_overloads.h"
+#include "detail_context_state.h"
+
+#include <atomic>
+#include <tuple>
+#include <vector>
+
+// Plain-data structs as value types, marshalled to and from plain script objects:
+//   struct Vec3 { float x, y, z; };
+//   DUKGLUE_STRUCT(Vec3, x, y, z)
+//
+//   Vec3 normalize(const Vec3& v);  // normalize({ x: 1, y: 2, z: 3 }) returns { x: ..., y: ..., z: ... }
+
+// DUKGLUE_STRUCT must be used at global scope, after the struct is defined, and lists the fields
+// (up to 16) that are copied. The struct must be default constructible. Fields can be any value type,
+// including other DUKGLUE_STRUCTs. Reading an object that is missing a field is an error
+// (unless the field's type accepts undefined, like std::optional).
+
+// The property names are interned once per Duktape heap and kept as heap pointers, so reading
+// or pushing a field is a duk_push_heapptr and a property get/put, with no string hashing.
+#define DUKGLUE_STRUCT(TYPE, ...) \
+	namespace dukglue { \
+		namespace types { \
+			template<> \
+			struct StructFields<TYPE> { \
+				typedef TYPE Type; \
+				\
+				static const char* const* names() { \
+					static const char* const field_names[] = { DUKGLUE_PP_FOR_EACH(DUKGLUE_STRUCT_FIELD_NAME, __VA_ARGS__) }; \
+					return field_names; \
+				} \
+				\
+				static auto members() -> decltype(std::make_tuple(DUKGLUE_PP_FOR_EACH(DUKGLUE_STRUCT_FIELD_MEMBER, __VA_ARGS__))) { \
+					return std::make_tuple(DUKGLUE_PP_FOR_EACH(DUKGLUE_STRUCT_FIELD_MEMBER, __VA_ARGS__)); \
+				} \
+			}; \
+			\
+			template<> \
+			struct DukType<TYPE> : detail::StructType<TYPE> {}; \
+			\
+			template<> \
+			struct DukTypeMask<TYPE> { \
+				static const duk_uint_t value = DUK_TYPE_MASK_OBJECT; \
+			}; \
+		} \
+	}
+
+#define DUKGLUE_STRUCT_FIELD_NAME(FIELD) #FIELD
+#define DUKGLUE_STRUCT_FIELD_MEMBER(FIELD) &Type::FIELD
+
+// DUKGLUE_PP_FOR_EACH(M, a, b, c) -> M(a), M(b), M(c)
+// (DUKGLUE_PP_EXPAND is for MSVC, which passes __VA_ARGS__ on as a single argument otherwise)
+#define DUKGLUE_PP_EXPAND(x) x
+#define DUKGLUE_PP_CAT(a, b) DUKGLUE_PP_CAT_(a, b)
+#define DUKGLUE_PP_CAT_(a, b) a##b
+#define DUKGLUE_PP_NARGS(...) DUKGLUE_PP_EXPAND(DUKGLUE_PP_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define DUKGLUE_PP_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define DUKGLUE_PP_FOR_EACH(M, ...) DUKGLUE_PP_EXPAND(DUKGLUE_PP_CAT(DUKGLUE_PP_FOR_EACH_, DUKGLUE_PP_NARGS(__VA_ARGS__))(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_1(M, a) M(a)
+#define DUKGLUE_PP_FOR_EACH_2(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_1(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_3(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_2(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_4(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_3(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_5(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_4(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_6(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_5(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_7(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_6(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_8(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_7(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_9(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_8(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_10(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_9(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_11(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_10(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_12(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_11(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_13(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_12(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_14(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_13(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_15(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_14(M, __VA_ARGS__))
+#define DUKGLUE_PP_FOR_EACH_16(M, a, ...) M(a), DUKGLUE_PP_EXPAND(DUKGLUE_PP_FOR_EACH_15(M, __VA_ARGS__))
+
+namespace dukglue
+{
+	namespace types
+	{
+		// Specialized by DUKGLUE_STRUCT: the field names and member pointers of T.
+		template<typename T>
+		struct StructFields;
+	}
+
+	namespace detail
+	{
+		// Each DUKGLUE_STRUCT type gets an index into ContextState::struct_keys.
+		inline size_t next_struct_id()
+		{
+			static std::atomic<size_t> next(0);
+			return next++;
+		}
+
+		template<typename T>
+		struct StructId
+		{
+			static size_t get()
+			{
+				static const size_t id = next_struct_id();
+				return id;
+			}
+		};
+
+		// Returns heap pointers to the interned names[0..count) for struct_id in ctx's heap,
+		// interning them the first time. The strings are kept alive by the heap stash.
+		inline void* const* interned_keys(duk_context* ctx, size_t struct_id, const char* const* names, size_t count)
+		{
+			ContextState* state = ContextState::get(ctx);
+			if (state->struct_keys.size() <= struct_id)
+				state->struct_keys.resize(struct_id + 1);
+
+			std::vector<void*>& keys = state->struct_keys[struct_id];
+			if (keys.empty()) {
+				duk_push_heapptr(ctx, state->interned_keys_array);
+				duk_uarridx_t next_idx = static_cast<duk_uarridx_t>(duk_get_length(ctx, -1));
+
+				keys.reserve(count);
+				for (size_t i = 0; i < count; i++) {
+					duk_push_string(ctx, names[i]);
+					keys.push_back(duk_get_heapptr(ctx, -1));
+					duk_put_prop_index(ctx, -2, next_idx++);
+				}
+				duk_pop(ctx);
+			}
+
+			return keys.data();
+		}
+
+		// The DukType for DUKGLUE_STRUCT types.
+		template<typename T>
+		struct StructType
+		{
+			typedef std::true_type IsValueType;
+
+			template<typename FullT>
+			static T read(duk_context* ctx, duk_idx_t arg_idx)
+			{
+				if (!duk_is_object(ctx, arg_idx)) {
+					duk_int_t type_idx = duk_get_type(ctx, arg_idx);
+					duk_error(ctx, DUK_ERR_TYPE_ERROR, "Argument %d: expected object, got %s", arg_idx, get_type_name(type_idx));
+				}
+
+				T value;
+				read_fields(ctx, duk_normalize_index(ctx, arg_idx), keys(ctx), value, Fields::members(), typename Indexes<Members>::type());
+				return value;
+			}
+
+			template<typename FullT>
+			static void push(duk_context* ctx, const T& value)
+			{
+				void* const* field_keys = keys(ctx);
+				duk_idx_t obj_idx = duk_push_object(ctx);
+				push_fields(ctx, obj_idx, field_keys, value, Fields::members(), typename Indexes<Members>::type());
+			}
+
+		private:
+			typedef dukglue::types::StructFields<T> Fields;
+			typedef decltype(Fields::members()) Members;
+
+			template<typename Tuple>
+			struct Indexes;
+
+			template<typename... Ms>
+			struct Indexes< std::tuple<Ms...> > {
+				typedef typename make_indexes<Ms...>::type type;
+			};
+
+			static void* const* keys(duk_context* ctx)
+			{
+				return interned_keys(ctx, StructId<T>::get(), Fields::names(), std::tuple_size<Members>::value);
+			}
+
+			// (C can be a base class of T)
+			template<typename M, typename C>
+			static void read_field(duk_context* ctx, duk_idx_t obj_idx, void* key, T& value, M C::* member)
+			{
+				duk_push_heapptr(ctx, key);
+				duk_get_prop(ctx, obj_idx);
+				value.*member = dukglue::types::DukType<typename dukglue::types::Bare<M>::type>::template read<M>(ctx, -1);
+				duk_pop(ctx);
+			}
+
+			template<typename M, typename C>
+			static void push_field(duk_context* ctx, duk_idx_t obj_idx, void* key, const T& value, M C::* member)
+			{
+				duk_push_heapptr(ctx, key);
+				dukglue::types::DukType<typename dukglue::types::Bare<M>::type>::template push<M>(ctx, value.*member);
+				duk_put_prop(ctx, obj_idx);
+			}
+
+			template<size_t... Is>
+			static void read_fields(duk_context* ctx, duk_idx_t obj_idx, void* const* field_keys, T& value, const Members& members, index_tuple<Is...>)
+			{
+				int unused[] = { 0, (read_field(ctx, obj_idx, field_keys[Is], value, std::get<Is>(members)), 0)... };
+				(void) unused;
+			}
+
+			template<size_t... Is>
+			static void push_fields(duk_context* ctx, duk_idx_t obj_idx, void* const* field_keys, const T& value, const Members& members, index_tuple<Is...>)
+			{
+				int unused[] = { 0, (push_field(ctx, obj_idx, field_keys[Is], value, std::get<Is>(members)), 0)... };
+				(void) unused;
+			}
+		};
+	}
+}
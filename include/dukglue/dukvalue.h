@@ -4,8 +4,10 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <string.h>  // for memcpy
 
 #include "dukexception.h"
+#include "detail_context_state.h"
 
 // A variant class for Duktape values.
 // This class is not really dependant on the rest of dukglue, but the rest of dukglue is integrated to support it.
@@ -36,7 +38,7 @@ public:
 		NUMBER = DUK_TYPE_NUMBER,
 		STRING = DUK_TYPE_STRING,
 		OBJECT = DUK_TYPE_OBJECT,
-		BUFFER = DUK_TYPE_BUFFER,  // not implemented
+		BUFFER = DUK_TYPE_BUFFER,  // plain buffers (buffer objects like Uint8Array are OBJECT)
 		POINTER = DUK_TYPE_POINTER,
 		LIGHTFUNC = DUK_TYPE_LIGHTFUNC  // not implemented
 	};
@@ -75,7 +77,7 @@ public:
 		if (mType == STRING)
 			mString = rhs.mString;
 
-		if (mType == OBJECT)
+		if (is_ref_type())
 		{
 			// ref counting increment
 			if (rhs.mRefCount == NULL) {
@@ -115,6 +117,7 @@ public:
 			return mString == rhs.mString;
 
 		case OBJECT:
+		case BUFFER:
 		{
 			// this could be optimized to only push ref_array once...
 			this->push();
@@ -127,7 +130,6 @@ public:
 		case POINTER:
 			return mPOD.pointer == rhs.mPOD.pointer;
 
-		case BUFFER:
 		case LIGHTFUNC:
 		default:
 			throw DukException() << "operator== not implemented (" << type_name() << ")";
@@ -168,6 +170,7 @@ public:
 		}
 
 		case OBJECT:
+		case BUFFER:
 			value.mPOD.ref_array_idx = stash_ref(ctx, idx);
 			break;
 
@@ -175,7 +178,6 @@ public:
 			value.mPOD.pointer = duk_require_pointer(ctx, idx);
 			break;
 
-		case BUFFER:
 		case LIGHTFUNC:
 		default:
 			throw DukException() << "Cannot turn type into DukValue (" << value.type_name() << ")";
@@ -259,6 +261,22 @@ public:
 			break;
 		}
 
+		case BUFFER:
+		{
+			if (data_len < sizeof(uint32_t))
+				throw DukException() << "Malformed buffer data (no length)";
+			uint32_t buf_len = *((uint32_t*)data_ptr);
+
+			if (data_len < sizeof(uint32_t) + buf_len)
+				throw DukException() << "Malformed buffer data (appears truncated)";
+
+			void* buf = duk_push_fixed_buffer(ctx, buf_len);
+			memcpy(buf, data_ptr + sizeof(uint32_t), buf_len);
+			v.mPOD.ref_array_idx = stash_ref(ctx, -1);
+			duk_pop(ctx);
+			break;
+		}
+
 		default:
 			throw DukException() << "not implemented";
 		}
@@ -298,6 +316,7 @@ public:
 			break;
 
 		case OBJECT:
+		case BUFFER:
 			push_ref_array(ctx);
 			duk_get_prop_index(ctx, -1, mPOD.ref_array_idx);
 			duk_remove(ctx, -2);
@@ -307,7 +326,6 @@ public:
 			duk_push_pointer(ctx, mPOD.pointer);
 			break;
 
-		case BUFFER:
 		case LIGHTFUNC:
 		default:
 			throw DukException() << "DukValue.push() not implemented for type (" << type_name() << ")";
@@ -363,6 +381,19 @@ public:
 		return mString.data();
 	}
 
+	// Plain buffers are kept alive (like objects) for as long as the DukValue is, so the pointer
+	// stays valid until then - unless the buffer is dynamic and gets resized, or is external
+	// and gets reconfigured (duk_resize_buffer, duk_config_buffer).
+	inline void* as_buffer(duk_size_t* out_size = NULL) const {
+		if (mType != BUFFER)
+			throw DukException() << "Expected buffer, got " << type_name();
+
+		push();
+		void* data = duk_get_buffer(mContext, -1, out_size);
+		duk_pop(mContext);
+		return data;
+	}
+
 	inline Type type() const {
 		return mType;
 	}
@@ -461,6 +492,24 @@ public:
 			break;
 		}
 
+		case BUFFER:
+		{
+			duk_size_t size = 0;
+			const void* data = as_buffer(&size);
+			if (size > static_cast<size_t>(UINT32_MAX))
+				throw DukException() << "Buffer size larger than uint32_t max";
+
+			uint32_t len = static_cast<uint32_t>(size);
+			buff.resize(buff.size() + sizeof(uint32_t) + len);
+
+			uint32_t* len_ptr = (uint32_t*)(buff.data() + sizeof(Type));
+			*len_ptr = len;
+
+			if (len > 0)
+				memcpy(buff.data() + sizeof(Type) + sizeof(uint32_t), data, len);
+			break;
+		}
+
 		default:
 			throw DukException() << "Type not implemented for serialization.";
 		}
@@ -476,21 +525,7 @@ private:
 	// (since we don't need the std::map here).
 	static void push_ref_array(duk_context* ctx)
 	{
-		static const char* DUKVALUE_REF_ARRAY = "dukglue_dukvalue_refs";
-		duk_push_heap_stash(ctx);
-
-		if (!duk_has_prop_string(ctx, -1, DUKVALUE_REF_ARRAY)) {
-			duk_push_array(ctx);
-
-			// ref_array[0] = 0 (initialize free list as empty)
-			duk_push_int(ctx, 0);
-			duk_put_prop_index(ctx, -2, 0);
-
-			duk_put_prop_string(ctx, -2, DUKVALUE_REF_ARRAY);
-		}
-
-		duk_get_prop_string(ctx, -1, DUKVALUE_REF_ARRAY);
-		duk_remove(ctx, -2); // pop heap stash
+		duk_push_heapptr(ctx, dukglue::detail::ContextState::get(ctx)->dukvalue_ref_array);
 	}
 
 	// put a new reference into the ref array and return its index in the array
@@ -528,7 +563,13 @@ private:
 	// remove ref_array_idx from the ref array and add its spot to the free list (at refs[0])
 	static void free_ref(duk_context* ctx, duk_uarridx_t ref_array_idx)
 	{
-		push_ref_array(ctx);
+		// (DukValues may be destroyed by finalizers while the heap is being destroyed,
+		// after dukglue's state is gone - in that case there's nothing left to free)
+		dukglue::detail::ContextState* state = dukglue::detail::ContextState::find(ctx);
+		if (state == NULL)
+			return;
+
+		duk_push_heapptr(ctx, state->dukvalue_ref_array);
 
 		// add this spot to the free list
 		// refs[old_obj_idx] = refs[0] (implicitly gives up our reference)
@@ -549,7 +590,7 @@ private:
 	// of a previously shared reference, so we can free it.
 	void release_ref_count()
 	{
-		if (mType == OBJECT)
+		if (is_ref_type())
 		{
 			if (mRefCount != NULL)
 			{
@@ -572,6 +613,11 @@ private:
 		}
 	}
 
+	// objects and plain buffers live in the ref array
+	inline bool is_ref_type() const {
+		return mType == OBJECT || mType == BUFFER;
+	}
+
 	duk_context* mContext;
 	Type mType;  // our type - one of the standard Duktape DUK_TYPE_* values
 
@@ -586,5 +632,5 @@ private:
 	} mPOD;
 
 	std::string mString;  // if it's a string, we store it with std::string
-	int* mRefCount;  // if mType == OBJECT and we're sharing, this will point to our ref counter
+	int* mRefCount;  // if mType == OBJECT (or BUFFER) and we're sharing, this will point to our ref counter
 };
\ No newline at end of file
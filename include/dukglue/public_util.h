@@ -55,6 +55,25 @@ void dukglue_read(duk_context* ctx, duk_idx_t arg_idx, RetT* out)
 }
 
 
+/**
+ * @brief      Like dukglue_read, but reads into an existing value, reusing its storage.
+ *
+ * std::string, std::vector and std::map are cleared and refilled in place without giving up their
+ * capacity (elements and map values are reused the same way), so reading the same shape of result
+ * every frame into one long-lived container is allocation-free once it has grown large enough.
+ * Other types are simply assigned.
+ *
+ * WARNING: THIS IS NOT "PROTECTED." (see dukglue_read)
+ */
+template <typename T>
+void dukglue_read_into(duk_context* ctx, duk_idx_t arg_idx, T& out)
+{
+	typedef typename dukglue::types::ArgStorage<T>::type ValidateReturnType;
+
+	dukglue::types::DukReadInto<T>::read(ctx, arg_idx, out);
+}
+
+
 // methods
 
 // leaves return value on stack
@@ -136,6 +155,8 @@ typename std::enable_if<std::is_void<RetT>::value, RetT>::type dukglue_pcall_met
 template <typename RetT, typename ObjT, typename... ArgTs>
 typename std::enable_if<!std::is_void<RetT>::value, RetT>::type dukglue_pcall_method(duk_context* ctx, const ObjT& obj, const char* method_name, ArgTs... args)
 {
+	typedef typename dukglue::types::ValidateOwnedResult<RetT>::type ValidateResultOwned;
+
 	RetT out;
 	dukglue::detail::SafeMethodCallData<RetT, ObjT, ArgTs...> data {
 		&obj, method_name, std::tuple<ArgTs...>(args...), &out
@@ -230,6 +251,8 @@ typename std::enable_if<std::is_void<RetT>::value, RetT>::type dukglue_pcall(duk
 template <typename RetT, typename ObjT, typename... ArgTs>
 typename std::enable_if<!std::is_void<RetT>::value, RetT>::type dukglue_pcall(duk_context* ctx, const ObjT& obj, ArgTs... args)
 {
+	typedef typename dukglue::types::ValidateOwnedResult<RetT>::type ValidateResultOwned;
+
 	RetT result;
 	dukglue::detail::SafeCallData<RetT, ObjT, ArgTs...> data{
 		&obj, std::tuple<ArgTs...>(args...), &result
@@ -294,6 +317,8 @@ typename std::enable_if<!std::is_void<RetT>::value, RetT>::type dukglue_peval(du
 {
 	int prev_top = duk_get_top(ctx);
 
+	typedef typename dukglue::types::ValidateOwnedResult<RetT>::type ValidateResultOwned;
+
 	RetT ret;
 	dukglue::detail::SafeEvalData<RetT> data{
 		str, &ret
@@ -3,12 +3,13 @@
 #include "detail_class_proto.h"
 #include "detail_constructor.h"
 #include "detail_method.h"
+#include "detail_overloads.h"
 
 // Set the constructor for the given type.
 template<class Cls, typename... Ts>
 void dukglue_register_constructor(duk_context* ctx, const char* name)
 {
-	duk_c_function constructor_func = dukglue::detail::call_native_constructor<false, Cls, Ts...>;
+	duk_c_function constructor_func = dukglue::detail::call_native_constructor<false, Cls, dukglue::HeapAllocator, Ts...>;
 
 	duk_push_c_function(ctx, constructor_func, sizeof...(Ts));
 
@@ -20,11 +21,15 @@ void dukglue_register_constructor(duk_context* ctx, const char* name)
 	duk_put_global_string(ctx, name);
 }
 
-template<class Cls, typename... Ts>
-void dukglue_register_constructor_managed(duk_context* ctx, const char* name)
+// Objects created by a managed constructor belong to their script object, and are destroyed by its finalizer.
+// They are created with an allocator policy (see allocators.h), new / delete by default.
+// To pool small objects that scripts create and drop a lot, pass dukglue::PoolAllocator():
+//   dukglue_register_constructor_managed<Vec3, float, float, float>(ctx, "Vec3", dukglue::PoolAllocator());
+template<class Cls, typename... Ts, typename Allocator>
+void dukglue_register_constructor_managed(duk_context* ctx, const char* name, Allocator)
 {
-	duk_c_function constructor_func = dukglue::detail::call_native_constructor<true, Cls, Ts...>;
-	duk_c_function finalizer_func = dukglue::detail::managed_finalizer<Cls>;
+	duk_c_function constructor_func = dukglue::detail::call_native_constructor<true, Cls, Allocator, Ts...>;
+	duk_c_function finalizer_func = dukglue::detail::managed_finalizer<Cls, Allocator>;
 
 	duk_push_c_function(ctx, constructor_func, sizeof...(Ts));
 
@@ -37,9 +42,16 @@ void dukglue_register_constructor_managed(duk_context* ctx, const char* name)
 
 	// hook prototype with finalizer up to real class prototype
 	// must use duk_set_prototype, not set the .prototype property
-	dukglue::detail::ProtoManager::push_prototype<Cls>(ctx);
+	const dukglue::detail::TypeInfo* info = dukglue::detail::ProtoManager::push_prototype<Cls>(ctx);
 	duk_set_prototype(ctx, -2);
 
+	// what the constructor needs, in one place
+	dukglue::detail::ManagedConstructorData* data = static_cast<dukglue::detail::ManagedConstructorData*>(
+		duk_push_fixed_buffer(ctx, sizeof(dukglue::detail::ManagedConstructorData)));
+	data->info = info;
+	data->alloc_data = Allocator::prepare(ctx);
+	duk_put_prop_string(ctx, -2, "\xFF" "managed");
+
 	// set constructor_func.prototype to the prototype with the finalizer
 	duk_put_prop_string(ctx, -2, "prototype");
 
@@ -47,33 +59,67 @@ void dukglue_register_constructor_managed(duk_context* ctx, const char* name)
 	duk_put_global_string(ctx, name);
 }
 
+template<class Cls, typename... Ts>
+void dukglue_register_constructor_managed(duk_context* ctx, const char* name)
+{
+	dukglue_register_constructor_managed<Cls, Ts...>(ctx, name, dukglue::HeapAllocator());
+}
+
+// Opt-in for classes with many short-lived objects: script objects created for native Cls
+// objects are not kept alive by dukglue. Once script no longer references one, it can be
+// garbage collected (dropping any properties added to it from script), and the next push
+// of the native object creates a new one. While it is alive, pushing the native object
+// still gives the same script object.
+// Applies to objects whose run-time type is Cls (derived classes need their own call).
+// Objects created with a managed constructor are not registered, so are not affected.
+template<class Cls>
+void dukglue_set_weak_refs(duk_context* ctx, bool weak = true)
+{
+	using namespace dukglue::detail;
+
+	TypeInfo* info = ProtoManager::push_prototype<Cls>(ctx);
+	info->set_weak_refs(weak);
+
+	// the finalizer is inherited by every script object using this prototype, and only unregisters
+	// objects that were registered weakly, so it can stay even if weak refs are turned off again
+	// (see RefManager::release_native_header)
+	if (weak) {
+		duk_push_c_function(ctx, RefManager::native_object_finalizer, 1);
+		duk_set_finalizer(ctx, -2);
+	}
+
+	duk_pop(ctx);
+}
+
+// Multiple inheritance is supported: call this once per base class.
+// The first base class registered for Derived becomes the next link in Derived's prototype chain.
+// Methods and properties of any additional base classes (and their registered bases) are copied
+// onto Derived's prototype, so register them on the base classes before calling this.
+// Virtual base classes are not supported.
 template<class Base, class Derived>
 void dukglue_set_base_class(duk_context* ctx)
 {
 	static_assert(!std::is_pointer<Base>::value && !std::is_pointer<Derived>::value
 		&& !std::is_const<Base>::value && !std::is_const<Derived>::value, "Use bare class names.");
-	static_assert(std::is_base_of<Base, Derived>::value, "Invalid class hierarchy!");
+	static_assert(std::is_base_of<Base, Derived>::value && !std::is_same<Base, Derived>::value, "Invalid class hierarchy!");
+	static_assert(dukglue::detail::is_static_base_of<Base, Derived>::value, "Base must be a non-virtual, unambiguous base class of Derived.");
 
   using namespace dukglue::detail;
 
-	// Derived.type_info->set_base(Base.type_info)
-	ProtoManager::push_prototype<Derived>(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "type_info");
-	TypeInfo* derived_type_info = static_cast<TypeInfo*>(duk_require_pointer(ctx, -1));
-	duk_pop_2(ctx);
+	TypeInfo* derived_type_info = ProtoManager::push_prototype<Derived>(ctx);
+	TypeInfo* base_type_info = ProtoManager::push_prototype<Base>(ctx);
+	const bool is_primary_base = !derived_type_info->has_base();
 
-	ProtoManager::push_prototype<Base>(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "type_info");
-	TypeInfo* base_type_info = static_cast<TypeInfo*>(duk_require_pointer(ctx, -1));
-	duk_pop_2(ctx);
-
-	derived_type_info->set_base(base_type_info);
+	derived_type_info->add_base(base_type_info, base_class_offset<Base, Derived>());
 
 	// also set up the prototype chain
-	ProtoManager::push_prototype<Derived>(ctx);
-	ProtoManager::push_prototype<Base>(ctx);
-	duk_set_prototype(ctx, -2);
-	duk_pop(ctx);
+	if (is_primary_base) {
+		duk_set_prototype(ctx, -2);
+		duk_pop(ctx);
+	} else {
+		ProtoManager::copy_prototype_chain(ctx, -1, -2);
+		duk_pop_2(ctx);
+	}
 }
 
 // methods
@@ -145,6 +191,99 @@ void dukglue_register_method(duk_context* ctx, typename std::conditional<isConst
 	duk_pop(ctx); // pop prototype
 }
 
+// Same as dukglue_register_method, but the method pointer is kept in a native table
+// indexed by the function's magic value (see detail_magic_table.h).
+// Calls skip the method_holder property lookup, and no MethodHolder or finalizer
+// is created per method. Limited to 65536 different methods per class + signature.
+template<class Cls, typename RetType, typename... Ts>
+void dukglue_register_method_magic(duk_context* ctx, RetType(Cls::*method)(Ts...), const char* name)
+{
+	dukglue_register_method_magic<false, Cls, RetType, Ts...>(ctx, method, name);
+}
+
+template<class Cls, typename RetType, typename... Ts>
+void dukglue_register_method_magic(duk_context* ctx, RetType(Cls::*method)(Ts...) const, const char* name)
+{
+	dukglue_register_method_magic<true, Cls, RetType, Ts...>(ctx, method, name);
+}
+
+template<bool isConst, typename Cls, typename RetType, typename... Ts>
+void dukglue_register_method_magic(duk_context* ctx, typename std::conditional<isConst, RetType(Cls::*)(Ts...) const, RetType(Cls::*)(Ts...)>::type method, const char* name)
+{
+	using namespace dukglue::detail;
+	typedef MethodInfo<isConst, Cls, RetType, Ts...> MethodInfo;
+
+	duk_c_function method_func = MethodInfo::MethodMagic::call_native_method;
+	duk_int_t magic = MagicTable<typename MethodInfo::MethodType>::intern(ctx, method);
+
+	ProtoManager::push_prototype<Cls>(ctx);
+
+	duk_push_c_function(ctx, method_func, sizeof...(Ts));
+	duk_set_magic(ctx, -1, magic);
+	duk_put_prop_string(ctx, -2, name); // consumes method function
+
+	duk_pop(ctx); // pop prototype
+}
+
+// Same as dukglue_register_method, but the last arguments are optional
+// (see dukglue_register_function with dukglue::defaults):
+//   dukglue_register_method(ctx, &Window::resize, "resize", dukglue::defaults(true));
+template<class Cls, typename RetType, typename... Ts, typename... DefaultTs>
+void dukglue_register_method(duk_context* ctx, RetType(Cls::*method)(Ts...), const char* name, const dukglue::Defaults<DefaultTs...>& defaults)
+{
+	dukglue_register_method<false, Cls, RetType, Ts...>(ctx, method, name, defaults);
+}
+
+template<class Cls, typename RetType, typename... Ts, typename... DefaultTs>
+void dukglue_register_method(duk_context* ctx, RetType(Cls::*method)(Ts...) const, const char* name, const dukglue::Defaults<DefaultTs...>& defaults)
+{
+	dukglue_register_method<true, Cls, RetType, Ts...>(ctx, method, name, defaults);
+}
+
+template<bool isConst, typename Cls, typename RetType, typename... Ts, typename... DefaultTs>
+void dukglue_register_method(duk_context* ctx, typename std::conditional<isConst, RetType(Cls::*)(Ts...) const, RetType(Cls::*)(Ts...)>::type method,
+	const char* name, const dukglue::Defaults<DefaultTs...>& defaults)
+{
+	using namespace dukglue::detail;
+	typedef typename MethodInfo<isConst, Cls, RetType, Ts...>::template MethodDefaults<DefaultTs...> MethodDefaults;
+
+	static_assert(sizeof...(DefaultTs) <= sizeof...(Ts), "More default values than arguments");
+
+	duk_int_t magic = MagicTable<typename MethodDefaults::Bound>::intern(ctx, typename MethodDefaults::Bound(method, defaults.values));
+
+	ProtoManager::push_prototype<Cls>(ctx);
+
+	duk_push_c_function(ctx, MethodDefaults::call_native_method, sizeof...(Ts));
+	duk_set_magic(ctx, -1, magic);
+	duk_put_prop_string(ctx, -2, name); // consumes method function
+
+	duk_pop(ctx); // pop prototype
+}
+
+// Register several methods under one name (see dukglue_register_function with dukglue::overloads):
+//   dukglue_register_method(ctx, dukglue::overloads(&Vec::scaleBy, &Vec::scaleByVec), "scale");
+// Const and non-const methods can be mixed. They must all be methods of the same class.
+template<typename F, typename... Fs>
+void dukglue_register_method(duk_context* ctx, const dukglue::Overloads<F, Fs...>& overloads, const char* name)
+{
+	using namespace dukglue::detail;
+	typedef OverloadSet<F, Fs...> OverloadSet;
+	typedef typename OverloadCandidate<F>::Class Cls;
+
+	static_assert(std::is_same<std::tuple<Cls, typename OverloadCandidate<Fs>::Class...>,
+		std::tuple<typename OverloadCandidate<Fs>::Class..., Cls> >::value, "All overloads must be methods of the same class");
+
+	duk_int_t magic = MagicTable<typename OverloadSet::Funcs>::intern(ctx, overloads.funcs);
+
+	ProtoManager::push_prototype<Cls>(ctx);
+
+	duk_push_c_function(ctx, OverloadSet::call_native_function, DUK_VARARGS);
+	duk_set_magic(ctx, -1, magic);
+	duk_put_prop_string(ctx, -2, name); // consumes method function
+
+	duk_pop(ctx); // pop prototype
+}
+
 // methods with a variable number of (script) arguments
 template<class Cls>
 inline void dukglue_register_method_varargs(duk_context* ctx, duk_ret_t(Cls::*method)(duk_context*), const char* name)
@@ -184,11 +323,108 @@ void dukglue_register_method_varargs(duk_context* ctx,
 	duk_pop(ctx); // pop prototype
 }
 
+template<class Cls>
+inline void dukglue_register_method_varargs_magic(duk_context* ctx, duk_ret_t(Cls::*method)(duk_context*), const char* name)
+{
+	dukglue_register_method_varargs_magic<false, Cls>(ctx, method, name);
+}
+
+template<class Cls>
+inline void dukglue_register_method_varargs_magic(duk_context* ctx, duk_ret_t(Cls::*method)(duk_context*) const, const char* name)
+{
+	dukglue_register_method_varargs_magic<true, Cls>(ctx, method, name);
+}
+
+template<bool isConst, typename Cls>
+void dukglue_register_method_varargs_magic(duk_context* ctx,
+	typename std::conditional<isConst, duk_ret_t(Cls::*)(duk_context*) const, duk_ret_t(Cls::*)(duk_context*)>::type method,
+	const char* name)
+{
+	using namespace dukglue::detail;
+	typedef MethodVariadicRuntime<isConst, Cls> MethodVariadicInfo;
+
+	duk_c_function method_func = MethodVariadicInfo::call_native_method_magic;
+	duk_int_t magic = MagicTable<typename MethodVariadicInfo::MethodInfoVariadic::MethodType>::intern(ctx, method);
+
+	ProtoManager::push_prototype<Cls>(ctx);
+
+	duk_push_c_function(ctx, method_func, DUK_VARARGS);
+	duk_set_magic(ctx, -1, magic);
+	duk_put_prop_string(ctx, -2, name); // consumes method function
+
+	duk_pop(ctx); // pop prototype
+}
+
 inline void dukglue_invalidate_object(duk_context* ctx, void* obj_ptr)
 {
 	dukglue::detail::RefManager::find_and_invalidate_native_object(ctx, obj_ptr);
 }
 
+// With a typed pointer, polymorphic objects can be invalidated through any base class pointer
+// (objects are registered by their most-derived address), and objects with a DukRefHook
+// can be found without searching the registry.
+template<typename T>
+void dukglue_invalidate_object(duk_context* ctx, T* obj_ptr)
+{
+	using namespace dukglue::detail;
+	RefManager::find_and_invalidate_native_object(ctx, most_derived_ptr(obj_ptr), get_ref_hook(obj_ptr));
+}
+
+// Bulk invalidation. Each of these is one pass over the registry (no per-object lookups),
+// so it's much faster than calling dukglue_invalidate_object in a loop when tearing down
+// many objects at once. They return the number of objects invalidated.
+
+// Invalidates every registered object whose address is in [begin, end).
+// (Polymorphic objects are registered by their most-derived address.)
+inline size_t dukglue_invalidate_range(duk_context* ctx, const void* begin, const void* end)
+{
+	const char* const first = static_cast<const char*>(begin);
+	const char* const last = static_cast<const char*>(end);
+
+	return dukglue::detail::RefManager::invalidate_matching(ctx, [first, last](const dukglue::detail::RefRegistry::Slot& slot) {
+		const char* const obj = static_cast<const char*>(slot.obj);
+		return obj >= first && obj < last;
+	});
+}
+
+// Invalidates the objects in objs[0] to objs[count - 1] (e.g. the contents of a std::vector<T>).
+template<typename T>
+size_t dukglue_invalidate_objects(duk_context* ctx, T* objs, size_t count)
+{
+	return dukglue_invalidate_range(ctx, objs, objs + count);
+}
+
+// Invalidates every registered object that can be used as a Cls
+// (objects of type Cls, and of classes registered as derived from Cls with dukglue_set_base_class).
+template<typename Cls>
+size_t dukglue_invalidate_class(duk_context* ctx)
+{
+	return dukglue::detail::RefManager::invalidate_matching(ctx, [](const dukglue::detail::RefRegistry::Slot& slot) {
+		return slot.type_info != NULL && slot.type_info->can_cast<Cls>();
+	});
+}
+
+// Sets the epoch for ctx: a tag that is recorded for every native object that gets a new script object
+// from now on (the default is 0). Pushing an object that already has a script object doesn't change its epoch.
+// For example, set a new epoch when loading a level, and invalidate it with dukglue_invalidate_epoch on unload.
+inline void dukglue_set_epoch(duk_context* ctx, uint32_t epoch)
+{
+	dukglue::detail::ContextState::get(ctx)->epoch = epoch;
+}
+
+inline uint32_t dukglue_get_epoch(duk_context* ctx)
+{
+	return dukglue::detail::ContextState::get(ctx)->epoch;
+}
+
+// Invalidates every registered object that was registered while epoch was the current epoch.
+inline size_t dukglue_invalidate_epoch(duk_context* ctx, uint32_t epoch)
+{
+	return dukglue::detail::RefManager::invalidate_matching(ctx, [epoch](const dukglue::detail::RefRegistry::Slot& slot) {
+		return slot.epoch == epoch;
+	});
+}
+
 // register a deleter
 template<typename Cls>
 void dukglue_register_delete(duk_context* ctx)
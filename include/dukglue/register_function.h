@@ -1,6 +1,7 @@
 #pragma once
 
 #include "detail_function.h"
+#include "detail_overloads.h"
 
 // Register a function, embedding the function address at compile time.
 // According to benchmarks, there's really not much reason to do this
@@ -13,7 +14,7 @@ void dukglue_register_function_compiletime(duk_context* ctx, RetType(*)(Ts...),
 		"Mismatching function pointer template parameter and function pointer argument types. "
 		"Try: dukglue_register_function<decltype(func), func>(ctx, \"funcName\", func)");
 
-	duk_c_function evalFunc = dukglue::detail::FuncInfoHolder<RetType, Ts...>::template FuncActual<Value>::call_native_function;
+	duk_c_function evalFunc = dukglue::detail::FuncInfoHolder<RetType, Ts...>::template FuncCompiletime<Value>::call_native_function;
 
 	duk_push_c_function(ctx, evalFunc, sizeof...(Ts));
 	duk_put_global_string(ctx, name);
@@ -33,3 +34,63 @@ void dukglue_register_function(duk_context* ctx, RetType(*funcToCall)(Ts...), co
 
 	duk_put_global_string(ctx, name);
 }
+
+// Register a function, storing the function pointer in a native table indexed by the
+// Duktape function's "magic" value instead of in a hidden property.
+// Calls skip the duk_push_current_function + property lookup that dukglue_register_function does,
+// which is noticeable for very small functions called very often.
+// Limited to 65536 distinct functions per signature (registering the same function twice,
+// even into different contexts, only uses one slot).
+template<typename RetType, typename... Ts>
+void dukglue_register_function_magic(duk_context* ctx, RetType(*funcToCall)(Ts...), const char* name)
+{
+	typedef dukglue::detail::FuncInfoHolder<RetType, Ts...> FuncInfo;
+
+	duk_c_function evalFunc = FuncInfo::FuncMagic::call_native_function;
+	duk_int_t magic = dukglue::detail::MagicTable<typename FuncInfo::FuncType>::intern(ctx, funcToCall);
+
+	duk_push_c_function(ctx, evalFunc, sizeof...(Ts));
+	duk_set_magic(ctx, -1, magic);
+
+	duk_put_global_string(ctx, name);
+}
+
+// Register a function whose last arguments are optional. An undefined or missing argument
+// is replaced with its default value, like a script default parameter:
+//   void drawText(const std::string& text, int size, const std::string& font);
+//   dukglue_register_function(ctx, &drawText, "drawText", dukglue::defaults(12, std::string("sans")));
+// The defaults are stored with the function pointer in a magic table (see dukglue_register_function_magic),
+// so they must be copyable and comparable with ==. The last sizeof...(DefaultTs) arguments get defaults.
+template<typename RetType, typename... Ts, typename... DefaultTs>
+void dukglue_register_function(duk_context* ctx, RetType(*funcToCall)(Ts...), const char* name, const dukglue::Defaults<DefaultTs...>& defaults)
+{
+	static_assert(sizeof...(DefaultTs) <= sizeof...(Ts), "More default values than arguments");
+
+	typedef typename dukglue::detail::FuncInfoHolder<RetType, Ts...>::template FuncDefaults<DefaultTs...> FuncDefaults;
+
+	duk_int_t magic = dukglue::detail::MagicTable<typename FuncDefaults::Bound>::intern(ctx,
+		typename FuncDefaults::Bound(funcToCall, defaults.values));
+
+	duk_push_c_function(ctx, FuncDefaults::call_native_function, sizeof...(Ts));
+	duk_set_magic(ctx, -1, magic);
+
+	duk_put_global_string(ctx, name);
+}
+
+// Register several functions under one name. Each call picks the first function whose
+// number of arguments matches, and whose argument types accept the script arguments
+// (see detail_overloads.h), so put more specific overloads first:
+//   dukglue_register_function(ctx, dukglue::overloads(&setColorRGB, &setColorName, &setColorHex), "setColor");
+// A varargs function (duk_ret_t(*)(duk_context*)) matches anything, so can be the last fallback.
+template<typename... Fs>
+void dukglue_register_function(duk_context* ctx, const dukglue::Overloads<Fs...>& overloads, const char* name)
+{
+	typedef dukglue::detail::OverloadSet<Fs...> OverloadSet;
+
+	duk_int_t magic = dukglue::detail::MagicTable<typename OverloadSet::Funcs>::intern(ctx, overloads.funcs);
+
+	duk_push_c_function(ctx, OverloadSet::call_native_function, DUK_VARARGS);
+	duk_set_magic(ctx, -1, magic);
+
+	duk_put_global_string(ctx, name);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "detail_method.h"
+#include "detail_field.h"
 
 // const getter, setter
 template <typename Cls, typename RetT, typename ArgT>
@@ -121,3 +122,157 @@ void dukglue_register_property(duk_context* ctx,
 	duk_def_prop(ctx, -4, flags);
 	duk_pop(ctx);  // pop prototype
 }
+
+// Same as dukglue_register_property, but all the properties of a class with the same getter (or setter)
+// signature share one getter (or setter) function, which finds the method to call from the property key
+// (see detail_shared_accessor.h). Each property costs a table entry instead of two function objects
+// with a heap-allocated MethodHolder and finalizer each, which adds up for classes with many properties
+// in many contexts. Accessing a shared property costs about the same as a regular one.
+
+// const getter, setter
+template <typename Cls, typename RetT, typename ArgT>
+void dukglue_register_property_shared(duk_context* ctx,
+	RetT(Cls::*getter)() const,
+	void(Cls::*setter)(ArgT),
+	const char* name)
+{
+	dukglue_register_property_shared<true, Cls, RetT, ArgT>(ctx, getter, setter, name);
+}
+
+// const getter, no setter
+template <typename Cls, typename RetT>
+void dukglue_register_property_shared(duk_context* ctx,
+	RetT(Cls::*getter)() const,
+	std::nullptr_t setter,
+	const char* name)
+{
+	dukglue_register_property_shared<true, Cls, RetT, RetT>(ctx, getter, setter, name);
+}
+
+// non-const getter, setter
+template <typename Cls, typename RetT, typename ArgT>
+void dukglue_register_property_shared(duk_context* ctx,
+	RetT(Cls::*getter)(),
+	void(Cls::*setter)(ArgT),
+	const char* name)
+{
+	dukglue_register_property_shared<false, Cls, RetT, ArgT>(ctx, getter, setter, name);
+}
+
+// non-const getter, no setter
+template <typename Cls, typename RetT>
+void dukglue_register_property_shared(duk_context* ctx,
+	RetT(Cls::*getter)(),
+	std::nullptr_t setter,
+	const char* name)
+{
+	dukglue_register_property_shared<false, Cls, RetT, RetT>(ctx, getter, setter, name);
+}
+
+// no getter, setter
+template <typename Cls, typename ArgT>
+void dukglue_register_property_shared(duk_context* ctx,
+	std::nullptr_t getter,
+	void(Cls::*setter)(ArgT),
+	const char* name)
+{
+	dukglue_register_property_shared<false, Cls, ArgT, ArgT>(ctx, getter, setter, name);
+}
+
+template <bool isConstGetter, typename Cls, typename RetT, typename ArgT>
+void dukglue_register_property_shared(duk_context* ctx,
+	typename std::conditional<isConstGetter, RetT(Cls::*)() const, RetT(Cls::*)()>::type getter,
+	void(Cls::*setter)(ArgT),
+	const char* name)
+{
+	using namespace dukglue::detail;
+	typedef MethodInfo<isConstGetter, Cls, RetT> GetterMethodInfo;
+	typedef MethodInfo<false, Cls, void, ArgT> SetterMethodInfo;
+
+	ProtoManager::push_prototype<Cls>(ctx);
+
+	// push key
+	duk_push_string(ctx, name);
+
+	// push getter (+1 argument for the key)
+	if (getter != nullptr) {
+		duk_int_t magic = MagicTable<typename GetterMethodInfo::MethodType>::intern(ctx, getter);
+		SharedAccessor::push(ctx, -2, GetterMethodInfo::MethodShared::call_native_method, 1, magic);
+	} else {
+		SharedAccessor::push(ctx, -2, dukglue_throw_error, 1, 0, false);
+	}
+
+	// push setter, keeping the key on top for SharedAccessor::push
+	duk_dup(ctx, -2);
+	if (setter != nullptr) {
+		duk_int_t magic = MagicTable<typename SetterMethodInfo::MethodType>::intern(ctx, setter);
+		SharedAccessor::push(ctx, -4, SetterMethodInfo::MethodShared::call_native_method, 2, magic);
+	} else {
+		SharedAccessor::push(ctx, -4, dukglue_throw_error, 2, 0, false);
+	}
+	duk_remove(ctx, -2);  // remove the key copy
+
+	duk_uint_t flags = DUK_DEFPROP_HAVE_GETTER
+		| DUK_DEFPROP_HAVE_SETTER
+		| DUK_DEFPROP_HAVE_CONFIGURABLE /* set not configurable (from JS) */
+		| DUK_DEFPROP_FORCE /* allow overriding built-ins and previously defined properties */;
+
+	duk_def_prop(ctx, -4, flags);
+	duk_pop(ctx);  // pop prototype
+}
+
+// Data members, without getter / setter methods:
+//   dukglue_register_field(ctx, &Point::x, "x");
+// const members are always read-only. See detail_field.h for how different field types behave.
+// The member pointer is kept in a native table indexed by magic (like dukglue_register_method_magic),
+// so nothing is allocated per field.
+template <class Cls, typename FieldT>
+void dukglue_register_field(duk_context* ctx, FieldT Cls::*field, const char* name)
+{
+	dukglue_register_field<false, Cls, FieldT>(ctx, field, name);
+}
+
+template <class Cls, typename FieldT>
+void dukglue_register_field_readonly(duk_context* ctx, FieldT Cls::*field, const char* name)
+{
+	dukglue_register_field<true, Cls, FieldT>(ctx, field, name);
+}
+
+template <bool readOnly, class Cls, typename FieldT>
+void dukglue_register_field(duk_context* ctx, FieldT Cls::*field, const char* name)
+{
+	using namespace dukglue::detail;
+	typedef FieldInfo<Cls, FieldT> FieldInfo;
+
+	duk_int_t magic = MagicTable<typename FieldInfo::FieldType>::intern(ctx, field);
+
+	ProtoManager::push_prototype<Cls>(ctx);
+	FieldInfo::template define_property<typename FieldInfo::FieldMagic, readOnly>(ctx, -1, name, magic);
+	duk_pop(ctx);  // pop prototype
+}
+
+// Same as dukglue_register_field, but the member pointer is a template argument,
+// so the accessors are compiled for that member's offset:
+//   dukglue_register_field_compiletime<decltype(&Point::x), &Point::x>(ctx, "x");
+template <typename T, T Value>
+void dukglue_register_field_compiletime(duk_context* ctx, const char* name)
+{
+	dukglue_register_field_compiletime<false, T, Value>(ctx, name);
+}
+
+template <typename T, T Value>
+void dukglue_register_field_readonly_compiletime(duk_context* ctx, const char* name)
+{
+	dukglue_register_field_compiletime<true, T, Value>(ctx, name);
+}
+
+template <bool readOnly, typename T, T Value>
+void dukglue_register_field_compiletime(duk_context* ctx, const char* name)
+{
+	using namespace dukglue::detail;
+	typedef FieldInfo<typename FieldPointer<T>::Cls, typename FieldPointer<T>::FieldT> FieldInfo;
+
+	ProtoManager::push_prototype<typename FieldPointer<T>::Cls>(ctx);
+	FieldInfo::template define_property<typename FieldInfo::template FieldCompiletime<Value>, readOnly>(ctx, -1, name, 0);
+	duk_pop(ctx);  // pop prototype
+}
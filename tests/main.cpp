@@ -7,6 +7,9 @@ void test_inheritance();
 void test_multiple_contexts();
 void test_properties();
 void test_dukvalue();
+void test_allocations();
+void test_refs();
+void test_overloads();
 
 int main() {
 	test_framework();
@@ -16,6 +19,9 @@ int main() {
 	test_multiple_contexts();
 	test_properties();
 	test_dukvalue();
+	test_allocations();
+	test_refs();
+	test_overloads();
 
 	std::cout << "All tests passed!" << std::endl;
 
@@ -0,0 +1,178 @@
+#include "test_assert.h"
+#include <dukglue/dukglue.h>
+
+#include <iostream>
+#include <new>
+#include <stdlib.h>
+
+// Counts calls to the global operator new while counting is enabled,
+// so we can check how many times arguments get copied on the way into a native call.
+// (Duktape itself allocates with malloc, so it is not counted.)
+static bool sCountAllocs = false;
+static int sAllocCount = 0;
+
+void* operator new(std::size_t size)
+{
+	if (sCountAllocs)
+		sAllocCount++;
+
+	void* ptr = malloc(size ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	free(ptr);
+}
+
+static int count_allocs(duk_context* ctx, const char* code)
+{
+	sAllocCount = 0;
+	sCountAllocs = true;
+	test_eval(ctx, code);
+	sCountAllocs = false;
+	duk_pop(ctx);
+	return sAllocCount;
+}
+
+static size_t sLastSize = 0;
+
+void take_vector(std::vector<double> vec) {
+	sLastSize = vec.size();
+}
+
+void take_const_ref_vector(const std::vector<double>& vec) {
+	sLastSize = vec.size();
+}
+
+void take_dukvalue(DukValue value) {
+	sLastSize = (value.type() == DukValue::OBJECT) ? 1 : 0;
+}
+
+void take_string(const std::string& str) {
+	sLastSize = str.size();
+}
+
+void take_string_view(DukStringView str) {
+	sLastSize = str.size();
+}
+
+class VectorHolder {
+public:
+	VectorHolder(std::vector<double> vec) : vec_(std::move(vec)) {}
+
+	void set(std::vector<double> vec) {
+		vec_ = std::move(vec);
+	}
+
+private:
+	std::vector<double> vec_;
+};
+
+class Color {
+public:
+	Color(int r, int g, int b) : r_(r), g_(g), b_(b) { sLive++; }
+	~Color() { sLive--; }
+
+	int sum() const { return r_ + g_ + b_; }
+
+	static int sLive;
+
+private:
+	int r_, g_, b_;
+};
+
+int Color::sLive = 0;
+
+// managed constructors with dukglue::PoolAllocator / dukglue::InlineStorage
+template <typename Allocator>
+static void test_managed_allocator()
+{
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_constructor_managed<Color, int, int, int>(ctx, "Color", Allocator());
+	dukglue_register_method(ctx, &Color::sum, "sum");
+	dukglue_register_delete<Color>(ctx);
+
+	test_eval_expect(ctx, "new Color(1, 2, 3).sum()", 6);
+	test_assert(Color::sLive == 0);
+
+	// creating and dropping objects doesn't allocate (once the pool has a chunk)
+	test_assert(count_allocs(ctx, "for (var i = 0; i < 1000; i++) { new Color(i, i, i); }") == 0);
+	test_assert(Color::sLive == 0);
+
+	// objects that are still referenced stay alive, and their memory is not reused
+	test_eval(ctx, "var kept = []; for (var i = 0; i < 100; i++) { kept.push(new Color(i, 0, 0)); new Color(0, 0, 0); }");
+	duk_pop(ctx);
+	test_assert(Color::sLive == 100);
+	test_eval_expect(ctx, "kept.reduce(function(acc, c) { return acc + c.sum(); }, 0)", 4950);
+
+	// delete() goes through the allocator too
+	test_eval(ctx, "kept[0].delete(); kept[1].delete();");
+	duk_pop(ctx);
+	test_assert(Color::sLive == 98);
+	test_eval_expect_error(ctx, "kept[0].sum()");
+	test_eval(ctx, "kept.shift(); kept.shift();");
+	duk_pop(ctx);
+	test_assert(Color::sLive == 98);
+
+	// objects still alive when the heap is destroyed are finalized, possibly after dukglue's
+	// per-heap state (and so the pool's owner) is gone
+	test_assert(duk_get_top(ctx) == 0);
+	duk_destroy_heap(ctx);
+	test_assert(Color::sLive == 0);
+}
+
+void test_allocations()
+{
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_function(ctx, take_vector, "take_vector");
+	dukglue_register_function(ctx, take_const_ref_vector, "take_const_ref_vector");
+	dukglue_register_function(ctx, take_dukvalue, "take_dukvalue");
+	dukglue_register_function(ctx, take_string, "take_string");
+	dukglue_register_function(ctx, take_string_view, "take_string_view");
+	dukglue_register_constructor_managed<VectorHolder, std::vector<double>>(ctx, "VectorHolder");
+	dukglue_register_method(ctx, &VectorHolder::set, "set");
+
+	test_eval(ctx, "var arr = [1, 2, 3, 4]; var longStr = new Array(1000).join('x'); var holder = new VectorHolder([]);");
+	duk_pop(ctx);
+
+	// reading the argument allocates the vector once, which is then moved all the way into the call
+	test_assert(count_allocs(ctx, "take_vector(arr)") == 1);
+	test_assert(sLastSize == 4);
+
+	test_assert(count_allocs(ctx, "take_const_ref_vector(arr)") == 1);
+	test_assert(sLastSize == 4);
+
+	test_assert(count_allocs(ctx, "holder.set(arr)") == 1);
+
+	// new VectorHolder: one vector + the VectorHolder itself
+	test_assert(count_allocs(ctx, "new VectorHolder(arr)") == 2);
+
+	// moving a DukValue does not allocate a reference count
+	test_assert(count_allocs(ctx, "take_dukvalue(arr)") == 0);
+	test_assert(sLastSize == 1);
+
+	// std::string copies the script string, views borrow it
+	test_assert(count_allocs(ctx, "take_string(longStr)") == 1);
+	test_assert(sLastSize == 999);
+
+	test_assert(count_allocs(ctx, "take_string_view(longStr)") == 0);
+	test_assert(sLastSize == 999);
+
+	test_assert(duk_get_top(ctx) == 0);
+	duk_destroy_heap(ctx);
+
+	test_managed_allocator<dukglue::PoolAllocator>();
+	test_managed_allocator<dukglue::InlineStorage>();
+
+	std::cout << "Allocations tested OK" << std::endl;
+}
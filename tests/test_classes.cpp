@@ -32,6 +32,12 @@ public:
 		return bark_count_;
 	}
 
+	// test varargs method
+	duk_ret_t barkTimes(duk_context* ctx) {
+		bark_count_ += duk_get_top(ctx);
+		return 0;
+	}
+
 private:
 	std::string name_;
 	int bark_count_;
@@ -70,6 +76,18 @@ void test_classes() {
 	duk_pop(ctx);
 	test_eval_expect(ctx, "test.getName();", "Archie");
 
+	// - test methods registered by magic value
+	dukglue_register_method_magic(ctx, &Dog::getName, "getNameMagic");
+	dukglue_register_method_magic(ctx, &Dog::rename, "renameMagic");
+	dukglue_register_method_varargs_magic(ctx, &Dog::barkTimes, "barkTimesMagic");
+	test_eval(ctx, "var magicDog = new Dog('Rex'); magicDog.renameMagic('Zoey');");
+	duk_pop(ctx);
+	test_eval_expect(ctx, "magicDog.getNameMagic();", "Zoey");
+	test_eval_expect_error(ctx, "magicDog.renameMagic(42);");
+	test_eval(ctx, "magicDog.barkTimesMagic(1, 2, 3);");
+	duk_pop(ctx);
+	test_eval_expect(ctx, "magicDog.getBarkCount();", 3);
+
 	// - test native objects as arguments to native functions
 	dukglue_register_function(ctx, pokeWithStick, "pokeWithStick");
 	test_eval(ctx, "pokeWithStick(test);");
@@ -112,7 +130,7 @@ void test_classes() {
 	test_eval_expect_error(ctx, "myPuppy.bark();");
 	test_eval_expect_error(ctx, "pokeWithStick(myPuppy);");
 	test_eval_expect_error(ctx, "myPuppy.delete();");
-	test_eval(ctx, "test.delete()");
+	test_eval(ctx, "test.delete(); magicDog.delete();");
 	duk_pop(ctx);
 
 	// std::vector<Cls*>
@@ -156,6 +156,30 @@ void test_dukvalue()
 		duk_pop_3(ctx);
 	}
 
+	// plain buffer (read/push/copy/serialize)
+	{
+		unsigned char* data = static_cast<unsigned char*>(duk_push_fixed_buffer(ctx, 3));
+		data[0] = 1; data[1] = 0; data[2] = 255;
+		DukValue buf = DukValue::take_from_stack(ctx);
+		test_assert(buf.type() == DukValue::BUFFER);
+
+		duk_size_t size = 0;
+		test_assert(buf.as_buffer(&size) == data && size == 3);
+
+		DukValue copy = buf;
+		test_assert(copy == buf);
+		copy.push();
+		test_assert(duk_get_buffer(ctx, -1, NULL) == data);
+		duk_pop(ctx);
+
+		std::vector<char> bytes = buf.serialize();
+		DukValue v = DukValue::deserialize(ctx, bytes.data(), bytes.size());
+		test_assert(v.type() == DukValue::BUFFER);
+		test_assert(v != buf);  // a new buffer
+		const unsigned char* out = static_cast<const unsigned char*>(v.as_buffer(&size));
+		test_assert(size == 3 && out[0] == 1 && out[1] == 0 && out[2] == 255);
+	}
+
 	// std::vector<DukValue>
 	{
 		std::vector<DukValue> arr = dukglue_peval< std::vector<DukValue> >(ctx, "[1, true, 2.34, null, 'asdf']");
@@ -231,6 +255,71 @@ void test_dukvalue()
 		}
 	}
 
+	// prepared calls
+	{
+		test_eval(ctx, "var hits = 0; function onHit(damage, weapon) { hits++; return damage * 2 + weapon.length; }; onHit;");
+		DukValue func = DukValue::take_from_stack(ctx);
+
+		dukglue::PreparedCall<int(int, const std::string&)> on_hit(ctx, func);
+		test_assert(on_hit.valid());
+		test_assert(on_hit(3, "sword") == 11);
+		test_assert(on_hit(1, std::string("axe")) == 5);
+		test_assert(duk_get_top(ctx) == 0);
+
+		// by global name, ignoring the result
+		dukglue::PreparedCall<void(int, const char*)> on_hit_global(ctx, "onHit");
+		on_hit_global(1, "bow");
+		test_eval_expect(ctx, "hits", 3);
+
+		// copies share the function
+		dukglue::PreparedCall<DukValue(int, std::string)> copy;
+		test_assert(!copy.valid());
+		copy = dukglue::PreparedCall<DukValue(int, std::string)>(ctx, func);
+		func = DukValue();
+		test_eval(ctx, "onHit = null;");
+		duk_pop(ctx);
+		duk_gc(ctx, 0);
+		test_assert(copy(2, "club").as_int() == 8);
+
+		// these shouldn't compile (borrowed results would dangle once the result is popped)
+		//dukglue::PreparedCall<DukStringView()> view(ctx, "onHit");
+		//dukglue_pcall<const char*>(ctx, func);
+		//dukglue_peval< std::vector<DukStringView> >(ctx, "['a']");
+
+		// script errors and unreadable results are thrown
+		test_eval(ctx, "function fails() { throw new Error('nope'); }; function five() { return 5; }");
+		duk_pop(ctx);
+
+		dukglue::PreparedCall<void()> fails(ctx, "fails");
+		try {
+			fails();
+			test_assert(false);
+		} catch (DukErrorException&) {
+		}
+
+		dukglue::PreparedCall<std::string()> five(ctx, "five");
+		try {
+			five();
+			test_assert(false);
+		} catch (DukErrorException&) {
+		}
+
+		try {
+			dukglue::PreparedCall<void()> not_callable(ctx, "hits");
+			test_assert(false);
+		} catch (DukException&) {
+		}
+
+		try {
+			dukglue::PreparedCall<void()> empty;
+			empty();
+			test_assert(false);
+		} catch (DukException&) {
+		}
+
+		test_assert(duk_get_top(ctx) == 0);
+	}
+
 	// test calling a method
 	{
 		test_eval(ctx, "var testObj = new Object(); testObj.thingDo = function(v) { return v*v; }; testObj;");
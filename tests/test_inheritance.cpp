@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <memory>
 
 class Shape {
 public:
@@ -74,6 +75,12 @@ void praiseCircle(Circle* circ) {
 	std::cout << "Even rounder than my belly" << std::endl;
 }
 
+std::vector<Shape*> sShapes;
+
+std::vector<Shape*> getShapes() {
+	return sShapes;
+}
+
 void praiseShape(Shape* shape) {
 	std::cout << "This one is going right on the fridge" << std::endl;
 }
@@ -88,6 +95,180 @@ Shape* makeShape(const std::string& name)
 		return NULL;
 }
 
+// multiple inheritance - Named is not the first base, so a Named* is not
+// at the same address as the Entity* it belongs to
+class Positioned {
+public:
+	Positioned() : pos_(7) {}
+	virtual ~Positioned() {}
+
+	int pos() const { return pos_; }
+
+private:
+	int pos_;
+};
+
+class Named {
+public:
+	Named(const std::string& name) : name_(name) {}
+	virtual ~Named() {}
+
+	const std::string& name() const { return name_; }
+
+private:
+	std::string name_;
+};
+
+class Entity : public Positioned, public Named {
+public:
+	Entity(const std::string& name) : Named(name), id_(42) {}
+
+	int id() const { return id_; }
+
+private:
+	int id_;
+};
+
+// too big for the stack (never instantiated)
+class HugeEntity : public Positioned, public Named {
+public:
+	char blob[64 * 1024 * 1024];
+};
+
+static Entity* sEntity = NULL;
+
+Entity* getEntity() {
+	return sEntity;
+}
+
+Named* getEntityAsNamed() {
+	return sEntity;
+}
+
+bool isTheNamedEntity(Named* named) {
+	return named == static_cast<Named*>(sEntity);
+}
+
+std::string nameOfShared(std::shared_ptr<Named> named) {
+	return named->name();
+}
+
+std::vector<Named*> getNamedList() {
+	return std::vector<Named*>{ sEntity, nullptr, sEntity };
+}
+
+std::shared_ptr<Entity> makeSharedEntity(const std::string& name) {
+	return std::make_shared<Entity>(name);
+}
+
+// deep hierarchy
+template <int N>
+class Level : public Level<N - 1> {
+public:
+	virtual int depth() const override { return N; }
+};
+
+template <>
+class Level<0> {
+public:
+	virtual ~Level() {}
+	virtual int depth() const { return 0; }
+};
+
+template <int N>
+struct RegisterLevels {
+	static void run(duk_context* ctx) {
+		dukglue_set_base_class<Level<N - 1>, Level<N> >(ctx);
+		RegisterLevels<N - 1>::run(ctx);
+	}
+};
+
+template <>
+struct RegisterLevels<0> {
+	static void run(duk_context* ctx) {}
+};
+
+int rootDepth(Level<0>* level) {
+	return level->depth();
+}
+
+int middleDepth(Level<4>* level) {
+	return level->depth();
+}
+
+Level<0>* makeLevel8() {
+	static Level<8> level;
+	return &level;
+}
+
+void test_multiple_inheritance(duk_context* ctx)
+{
+	Entity entity("Bob");
+	sEntity = &entity;
+	test_assert(static_cast<void*>(static_cast<Named*>(&entity)) != static_cast<void*>(&entity));
+
+	// register base methods first, so they get copied onto Entity's prototype
+	dukglue_register_method(ctx, &Positioned::pos, "pos");
+	dukglue_register_method(ctx, &Named::name, "name");
+	dukglue_register_method(ctx, &Entity::id, "id");
+	dukglue_set_base_class<Positioned, Entity>(ctx);
+	dukglue_set_base_class<Named, Entity>(ctx);
+
+	dukglue_register_function(ctx, getEntity, "getEntity");
+	dukglue_register_function(ctx, getEntityAsNamed, "getEntityAsNamed");
+	dukglue_register_function(ctx, isTheNamedEntity, "isTheNamedEntity");
+
+	test_eval_expect(ctx, "getEntity().id()", 42);
+	test_eval_expect(ctx, "getEntity().pos()", 7);
+	test_eval_expect(ctx, "getEntity().name()", "Bob");
+
+	// the pointer is adjusted when passing an Entity as a Named*
+	test_eval_expect(ctx, "isTheNamedEntity(getEntity()) ? 1 : 0", 1);
+
+	// the same object pushed through a different base class pointer is the same script object
+	test_eval_expect(ctx, "getEntity() === getEntityAsNamed() ? 1 : 0", 1);
+
+	// vectors of base class pointers give the same script objects too
+	dukglue_register_function(ctx, getNamedList, "getNamedList");
+	test_eval_expect(ctx, "var named = getNamedList(); (named[0] === getEntity() && named[1] === null && named[2] === named[0]) ? 1 : 0", 1);
+
+	// methods from one base can't be called on an unrelated native object
+	dukglue_register_function(ctx, makeShape, "makeShape");
+	test_eval_expect_error(ctx, "var shape = makeShape('circle'); try { getEntity().name.call(shape); } finally { shape.delete(); }");
+
+	// shared_ptr to a secondary base shares ownership with the original
+	dukglue_register_function(ctx, nameOfShared, "nameOfShared");
+	dukglue_register_function(ctx, makeSharedEntity, "makeSharedEntity");
+	test_eval_expect(ctx, "nameOfShared(makeSharedEntity('Alice'))", "Alice");
+
+	// invalidating through a base class pointer invalidates the one script object
+	test_eval(ctx, "var ent = getEntity();");
+	duk_pop(ctx);
+	dukglue_invalidate_object(ctx, static_cast<Named*>(&entity));
+	test_eval_expect_error(ctx, "ent.name()");
+
+	sEntity = NULL;
+
+	// the pointer adjustment is worked out without a Derived object
+	test_assert(dukglue::detail::base_class_offset<Named, Entity>() == static_cast<char*>(static_cast<void*>(static_cast<Named*>(&entity))) - static_cast<char*>(static_cast<void*>(&entity)));
+	dukglue_set_base_class<Named, HugeEntity>(ctx);
+
+	// deep hierarchies
+	RegisterLevels<8>::run(ctx);
+	dukglue_register_method(ctx, &Level<0>::depth, "depth");
+	dukglue_register_function(ctx, rootDepth, "rootDepth");
+	dukglue_register_function(ctx, middleDepth, "middleDepth");
+	dukglue_register_function(ctx, makeLevel8, "makeLevel8");
+
+	test_eval_expect(ctx, "makeLevel8().depth()", 8);
+	test_eval_expect(ctx, "rootDepth(makeLevel8())", 8);
+	test_eval_expect(ctx, "middleDepth(makeLevel8())", 8);
+
+	test_eval(ctx, "var l8 = makeLevel8();");
+	duk_pop(ctx);
+	dukglue_invalidate_object(ctx, makeLevel8());
+}
+
 void test_inheritance() {
 	duk_context* ctx = duk_create_heap_default();
 
@@ -125,6 +306,28 @@ void test_inheritance() {
 	test_eval(ctx, "praiseShape(rect)");
 	duk_pop_2(ctx);
 
+	// vectors of mixed shapes: each gets the prototype of its run-time type,
+	// and objects that are already registered are reused
+	{
+		Circle* circ = new Circle(1, 1, 1);
+		Rectangle* rect = new Rectangle(0, 0, 2, 2);
+		sShapes = { circ, circ, rect, nullptr, new Circle(5, 5, 5) };
+
+		dukglue_register_function(ctx, getShapes, "getShapes");
+		test_eval(ctx, "var shapes = getShapes();");
+		duk_pop(ctx);
+		test_eval_expect(ctx, "shapes.length", 5);
+		test_eval_expect(ctx, "(shapes[0] === shapes[1] && shapes[3] === null && shapes[0] !== shapes[4]) ? 1 : 0", 1);
+		test_eval_expect(ctx, "praiseCircle(shapes[4]); praiseRectangle(shapes[2]); shapes[4].describe()",
+			"A lazily-drawn circle, drawn at 5, 5, with a radius of about 5");
+		test_eval_expect_error(ctx, "praiseCircle(shapes[2])");
+		test_eval_expect(ctx, "getShapes()[2] === shapes[2] ? 1 : 0", 1);
+
+		test_eval(ctx, "shapes[0].delete(); shapes[2].delete(); shapes[4].delete(); shapes = undefined;");
+		duk_pop(ctx);
+		sShapes.clear();
+	}
+
 	test_eval(ctx, "circ.delete()");  // test inherited delete
 	test_eval(ctx, "rect.delete()");
 	duk_pop_2(ctx);
@@ -157,6 +360,8 @@ void test_inheritance() {
 		duk_pop(ctx);
 	}
 
+	test_multiple_inheritance(ctx);
+
 	test_assert(duk_get_top(ctx) == 0);
 	duk_destroy_heap(ctx);
 
@@ -60,5 +60,53 @@ void test_multiple_contexts() {
 	duk_destroy_heap(ctx1);
 	duk_destroy_heap(ctx2);
 
+	// threads share their heap's state
+	{
+		duk_context* ctx = duk_create_heap_default();
+		dukglue_register_method(ctx, &A::getMeaningOfLife, "getMeaningOfLife");
+
+		A a;
+		dukglue_push(ctx, &a);
+		duk_put_global_string(ctx, "a");
+
+		duk_push_thread(ctx);
+		duk_context* thread = duk_get_context(ctx, -1);
+
+		dukglue_push(thread, &a);
+		duk_get_global_string(thread, "a");
+		test_assert(duk_strict_equals(thread, -1, -2) != 0);
+		duk_pop_2(thread);
+
+		{
+			DukValue val = dukglue_peval<DukValue>(thread, "({ x: 1 })");
+			val.push();
+			test_assert(duk_is_object(thread, -1) != 0);
+			duk_pop(thread);
+		}
+
+		dukglue_invalidate_object(thread, &a);
+		test_eval_expect_error(ctx, "a.getMeaningOfLife()");
+
+		duk_pop(ctx);  // pop thread
+		test_assert(duk_get_top(ctx) == 0);
+		duk_destroy_heap(ctx);
+	}
+
+	// destroying and re-creating heaps (possibly at the same address) starts with fresh state
+	for (int i = 0; i < 3; i++) {
+		duk_context* ctx = duk_create_heap_default();
+
+		dukglue_register_constructor_managed<A>(ctx, "TestClass");
+		dukglue_register_method(ctx, &A::getMeaningOfLife, "getMeaningOfLife");
+		test_eval_expect(ctx, "new TestClass().getMeaningOfLife()", 42);
+
+		A a;
+		dukglue_push(ctx, &a);
+		duk_pop(ctx);
+
+		test_assert(duk_get_top(ctx) == 0);
+		duk_destroy_heap(ctx);
+	}
+
 	std::cout << "Multiple contexts tested OK" << std::endl;
 }
@@ -0,0 +1,200 @@
+#include "test_assert.h"
+#include <dukglue/dukglue.h>
+
+#include <iostream>
+#include <string>
+
+namespace {
+
+std::string describe_int(int v) { return "int " + std::to_string(v); }
+std::string describe_string(const std::string& v) { return "string " + v; }
+std::string describe_bool(bool v) { return v ? "bool true" : "bool false"; }
+std::string describe_two(int a, int b) { return "two " + std::to_string(a + b); }
+std::string describe_none() { return "none"; }
+
+duk_ret_t describe_varargs(duk_context* ctx)
+{
+	duk_push_sprintf(ctx, "varargs %d", (int) duk_get_top(ctx));
+	return 1;
+}
+
+int seven(int a, int b, int c, int d, int e, int f, const char* g) { return 7; }
+int seven(int a, int b, int c, int d, int e, int f, int g) { return a + b + c + d + e + f + g; }
+
+class Shape {
+public:
+	Shape() : mScale(1) {}
+	virtual ~Shape() {}
+
+	void scale(int factor) { mScale *= factor; }
+	void scaleBy(const Shape* other) { mScale *= (other != nullptr ? other->mScale : 0); }
+	int getScale() const { return mScale; }
+	int getScaleTimes(int factor) const { return mScale * factor; }
+#ifdef DUKGLUE_HAS_CXX17
+	int getScaleMaybeTimes(std::optional<int> factor) const { return factor ? mScale * *factor : -1; }
+#endif
+
+private:
+	int mScale;
+};
+
+class Other {
+};
+
+std::string draw_text(const std::string& text, int size, const std::string& font)
+{
+	return text + " " + std::to_string(size) + " " + font;
+}
+
+int sum3(int a, int b, int c) { return a + b + c; }
+
+class Window {
+public:
+	Window() : mWidth(0), mHeight(0) {}
+
+	void resize(int width, int height) { mWidth = width; mHeight = height; }
+	int area(int scale) const { return mWidth * mHeight * scale; }
+
+	int mWidth, mHeight;
+};
+
+#ifdef DUKGLUE_HAS_CXX17
+std::string greet(const std::string& name, std::optional<std::string> title)
+{
+	return title ? (*title + " " + name) : name;
+}
+
+std::optional<int> half_if_even(int v)
+{
+	if (v % 2 != 0)
+		return std::nullopt;
+	return v / 2;
+}
+
+int count_shapes(std::optional<Shape*> shape)
+{
+	return shape ? (*shape != nullptr ? 1 : 0) : -1;
+}
+#endif
+
+}
+
+void test_overloads()
+{
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_function(ctx, dukglue::overloads(&describe_int, &describe_string, &describe_bool,
+		&describe_two, &describe_none), "describe");
+
+	test_eval_expect(ctx, "describe(12)", "int 12");
+	test_eval_expect(ctx, "describe('abc')", "string abc");
+	test_eval_expect(ctx, "describe(false)", "bool false");
+	test_eval_expect(ctx, "describe(1, 2)", "two 3");
+	test_eval_expect(ctx, "describe()", "none");
+	test_eval_expect_error(ctx, "describe({})");
+	test_eval_expect_error(ctx, "describe(1, 'b')");
+	test_eval_expect_error(ctx, "describe(1, 2, 3)");
+
+	// varargs catches everything else
+	dukglue_register_function(ctx, dukglue::overloads(&describe_int, &describe_varargs), "describeAny");
+	test_eval_expect(ctx, "describeAny(3)", "int 3");
+	test_eval_expect(ctx, "describeAny('x', 2, 3)", "varargs 3");
+
+	// arguments past the packed mask are checked one by one
+	dukglue_register_function(ctx, dukglue::overloads(
+		static_cast<int(*)(int, int, int, int, int, int, const char*)>(&seven),
+		static_cast<int(*)(int, int, int, int, int, int, int)>(&seven)), "seven");
+	test_eval_expect(ctx, "seven(1, 1, 1, 1, 1, 1, 'a')", 7);
+	test_eval_expect(ctx, "seven(1, 1, 1, 1, 1, 1, 2)", 8);
+	test_eval_expect_error(ctx, "seven(1, 1, 1, 1, 1, 1, true)");
+
+	// methods
+	dukglue_register_constructor<Shape>(ctx, "Shape");
+	dukglue_register_constructor_managed<Other>(ctx, "Other");
+	dukglue_register_method(ctx, dukglue::overloads(&Shape::scale, &Shape::scaleBy), "scale");
+	dukglue_register_method(ctx, dukglue::overloads(&Shape::getScale, &Shape::getScaleTimes), "getScale");
+	dukglue_register_method(ctx, &Shape::getScale, "getScaleOnly");
+
+	Shape shape;
+	dukglue_register_global(ctx, &shape, "shape");
+
+	test_eval(ctx, "shape.scale(3)");
+	duk_pop(ctx);
+	test_assert(shape.getScale() == 3);
+	test_eval(ctx, "shape.scale(shape)");
+	duk_pop(ctx);
+	test_assert(shape.getScale() == 9);
+	test_eval_expect(ctx, "shape.getScale()", 9);
+	test_eval_expect(ctx, "shape.getScale(2)", 18);
+	test_eval(ctx, "shape.scale(null)");
+	duk_pop(ctx);
+	test_assert(shape.getScale() == 0);
+	test_eval_expect_error(ctx, "shape.scale('big')");
+
+	// native objects only match on "object", reading then checks the class
+	test_eval_expect_error(ctx, "shape.scale(new Other())");
+
+	// 'this' must still be a Shape
+	test_eval_expect_error(ctx, "shape.getScale.call(new Other())");
+
+	// default values for missing (or undefined) trailing arguments
+	dukglue_register_function(ctx, &draw_text, "drawText", dukglue::defaults(12, std::string("sans")));
+	test_eval_expect(ctx, "drawText('hi')", "hi 12 sans");
+	test_eval_expect(ctx, "drawText('hi', 14)", "hi 14 sans");
+	test_eval_expect(ctx, "drawText('hi', undefined, 'serif')", "hi 12 serif");
+	test_eval_expect(ctx, "drawText('hi', 1, 'mono', 'ignored')", "hi 1 mono");
+	test_eval_expect_error(ctx, "drawText()");
+	test_eval_expect_error(ctx, "drawText('hi', 'big')");
+
+	dukglue_register_function(ctx, &sum3, "sum3", dukglue::defaults(1, 2, 3));
+	dukglue_register_function(ctx, &sum3, "sum3b", dukglue::defaults(10));
+	test_eval_expect(ctx, "sum3()", 6);
+	test_eval_expect(ctx, "sum3(5)", 10);
+	test_eval_expect(ctx, "sum3b(1, 2)", 13);
+	test_eval_expect_error(ctx, "sum3b(1)");
+
+	Window window;
+	dukglue_register_method(ctx, &Window::resize, "resize", dukglue::defaults(100));
+	dukglue_register_method(ctx, &Window::area, "area", dukglue::defaults(1));
+	dukglue_register_global(ctx, &window, "win");
+	test_eval(ctx, "win.resize(20)");
+	duk_pop(ctx);
+	test_assert(window.mWidth == 20 && window.mHeight == 100);
+	test_eval_expect(ctx, "win.area()", 2000);
+	test_eval_expect(ctx, "win.area(2)", 4000);
+	dukglue_invalidate_object(ctx, &window);
+
+#ifdef DUKGLUE_HAS_CXX17
+	dukglue_register_function(ctx, &greet, "greet");
+	dukglue_register_function(ctx, &half_if_even, "halfIfEven");
+	dukglue_register_function(ctx, &count_shapes, "countShapes");
+	test_eval_expect(ctx, "greet('Ada')", "Ada");
+	test_eval_expect(ctx, "greet('Ada', 'Dr.')", "Dr. Ada");
+	test_eval_expect_error(ctx, "greet('Ada', 5)");
+	test_eval_expect(ctx, "halfIfEven(4)", 2);
+	test_eval_expect(ctx, "halfIfEven(3) === undefined ? 1 : 0", 1);
+	test_eval_expect(ctx, "countShapes()", -1);
+	test_eval_expect(ctx, "countShapes(null)", 0);
+	test_eval_expect(ctx, "countShapes(shape)", 1);
+
+	// trailing std::optional arguments can be left out in an overload set too
+	dukglue_register_function(ctx, dukglue::overloads(&describe_int, &greet), "greetOrDescribe");
+	test_eval_expect(ctx, "greetOrDescribe(3)", "int 3");
+	test_eval_expect(ctx, "greetOrDescribe('Ada')", "Ada");
+	test_eval_expect(ctx, "greetOrDescribe('Ada', 'Dr.')", "Dr. Ada");
+	test_eval_expect(ctx, "greetOrDescribe('Ada', undefined)", "Ada");
+	test_eval_expect_error(ctx, "greetOrDescribe()");
+	test_eval_expect_error(ctx, "greetOrDescribe('Ada', 'Dr.', 'extra')");
+
+	dukglue_register_method(ctx, dukglue::overloads(&Shape::getScaleTimes, &Shape::getScaleMaybeTimes), "getScaleMaybe");
+	test_eval_expect(ctx, "shape.getScaleMaybe(2)", 0);
+	test_eval_expect(ctx, "shape.getScaleMaybe()", -1);
+#endif
+
+	dukglue_invalidate_object(ctx, &shape);
+
+	test_assert(duk_get_top(ctx) == 0);
+	duk_destroy_heap(ctx);
+
+	std::cout << "Overloads tested OK" << std::endl;
+}
@@ -23,6 +23,10 @@ int square(int a) {
 	return a * a;
 }
 
+int cube(int a) {
+	return a * a * a;
+}
+
 // C-style string tests
 const char* get_const_c_string() {
 	return "butts_const";
@@ -38,6 +42,212 @@ const std::string& get_const_ref_cpp_string() {
 	return str;
 }
 
+// non-const references to containers (refilled scratch storage)
+static duk_context* gScratchCtx = nullptr;
+static const int* gScratchData = nullptr;
+
+int sum_scratch(std::vector<int>& values) {
+	gScratchData = values.data();
+
+	int sum = 0;
+	for (int value : values)
+		sum += value;
+
+	values.clear();  // (not written back to script)
+	return sum;
+}
+
+int sum_reentrant(std::vector<int>& values, bool recurse) {
+	if (recurse)
+		duk_eval_string_noresult(gScratchCtx, "sum_reentrant([100, 200, 300], false)");
+
+	int sum = 0;
+	for (int value : values)
+		sum += value;
+	return sum;
+}
+
+std::string join_keys(std::map<std::string, int>& counts, std::string& separator) {
+	std::string joined;
+	for (const auto& entry : counts)
+		joined += (joined.empty() ? "" : separator) + entry.first;
+	return joined;
+}
+
+// borrowed strings
+size_t string_view_length(DukStringView str) {
+	return str.size();
+}
+
+std::string string_view_echo(const DukStringView& str) {
+	return str.str();
+}
+
+DukStringView get_string_view() {
+	static const char str[] = "potato_view";
+	return DukStringView(str);
+}
+
+#ifdef DUKGLUE_HAS_CXX17
+size_t std_string_view_length(std::string_view str) {
+	return str.size();
+}
+
+std::string_view get_std_string_view() {
+	return std::string_view("potato_std_view");
+}
+#endif
+
+// numeric vectors (TypedArrays)
+double sum_floats(const std::vector<float>& values) {
+	double sum = 0;
+	for (float v : values)
+		sum += v;
+	return sum;
+}
+
+std::vector<float> get_floats() {
+	return std::vector<float>{ 0.5f, 1.5f, 2.5f };
+}
+
+std::vector<int64_t> get_int64s() {
+	return std::vector<int64_t>{ 1, 2 };
+}
+
+std::vector<bool> get_bools() {
+	return std::vector<bool>{ true, false };
+}
+
+// buffers
+void brighten(DukSpan<uint8_t> pixels, int amount) {
+	for (uint8_t& p : pixels)
+		p = static_cast<uint8_t>(p + amount);
+}
+
+double sum_float_span(DukSpan<const float> values) {
+	double sum = 0;
+	for (float v : values)
+		sum += v;
+	return sum;
+}
+
+int gOwnerAlive = 0;
+
+struct Samples {
+	Samples() { gOwnerAlive++; data.assign(4, 0.25f); }
+	~Samples() { gOwnerAlive--; }
+	std::vector<float> data;
+};
+
+DukSharedBuffer<float> get_samples() {
+	std::shared_ptr<Samples> samples = std::make_shared<Samples>();
+	return DukSharedBuffer<float>(samples->data.data(), samples->data.size(), samples);
+}
+
+float* gLastSharedData = nullptr;
+long gLastSharedUses = 0;
+
+size_t take_shared(DukSharedBuffer<float> buf) {
+	gLastSharedData = buf.data();
+	gLastSharedUses = buf.owner().use_count();
+	return buf.size();
+}
+
+const float gConstSamples[2] = { 1.0f, 2.0f };
+
+DukSharedBuffer<const float> get_const_samples() {
+	return DukSharedBuffer<const float>(gConstSamples, 2, nullptr);
+}
+
+// containers
+std::unordered_map<std::string, int> get_ages() {
+	return std::unordered_map<std::string, int>{ { "alice", 31 }, { "bob", 42 } };
+}
+
+int sum_ages(const std::unordered_map<std::string, int>& ages) {
+	int sum = 0;
+	for (const auto& kv : ages)
+		sum += kv.second;
+	return sum;
+}
+
+std::unordered_map<int, std::string> invert_ages(const std::unordered_map<std::string, int>& ages) {
+	std::unordered_map<int, std::string> inverted;
+	for (const auto& kv : ages)
+		inverted[kv.second] = kv.first;
+	return inverted;
+}
+
+int count_byte_keys(const std::unordered_map<unsigned char, int>& keys) {
+	return static_cast<int>(keys.size());
+}
+
+int sum_ids(const std::unordered_map<int, int>& ids) {
+	int sum = 0;
+	for (const auto& kv : ids)
+		sum += kv.first * kv.second;
+	return sum;
+}
+
+std::array<float, 3> cross(const std::array<float, 3>& a, const std::array<float, 3>& b) {
+	return std::array<float, 3>{ { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] } };
+}
+
+std::pair<std::string, int> swap_pair(const std::pair<int, std::string>& p) {
+	return std::make_pair(p.second, p.first);
+}
+
+std::tuple<int, std::string, bool> describe_tuple(const std::tuple<int, std::string, bool>& t) {
+	return std::make_tuple(std::get<0>(t) * 2, std::get<1>(t) + "!", !std::get<2>(t));
+}
+
+#ifdef DUKGLUE_HAS_CXX17
+std::string describe_optional(std::optional<int> num) {
+	return num ? std::to_string(*num) : "none";
+}
+
+std::string describe_variant(const std::variant<std::monostate, int, std::string, std::vector<int> >& v) {
+	switch (v.index()) {
+	case 0: return "empty";
+	case 1: return "int " + std::to_string(std::get<1>(v));
+	case 2: return "string " + std::get<2>(v);
+	default: return "vector of " + std::to_string(std::get<3>(v).size());
+	}
+}
+
+std::variant<int, std::string> make_variant(bool str) {
+	if (str)
+		return std::string("text");
+	return 7;
+}
+#endif
+
+// plain-data structs
+struct Vec2 {
+	float x, y;
+};
+
+DUKGLUE_STRUCT(Vec2, x, y)
+
+struct Waypoint {
+	std::string name;
+	Vec2 pos;
+	std::vector<int> tags;
+};
+
+DUKGLUE_STRUCT(Waypoint, name, pos, tags)
+
+Vec2 add_vec2(const Vec2& a, const Vec2& b) {
+	return Vec2{ a.x + b.x, a.y + b.y };
+}
+
+Waypoint move_waypoint(Waypoint wp, const Vec2& delta) {
+	wp.name += "'";
+	wp.pos = add_vec2(wp.pos, delta);
+	wp.tags.push_back(static_cast<int>(wp.tags.size()));
+	return wp;
+}
+
 // should NOT work
 std::string& get_ref_cpp_string() {
 	static std::string str("potato_ref");
@@ -100,6 +310,25 @@ void test_primitives() {
 	test_eval_expect(ctx, "square(4)", 16);
 	test_eval_expect_error(ctx, "square('potato')");
 
+	// functions registered by magic value
+	dukglue_register_function_magic(ctx, square, "square_magic");
+	dukglue_register_function_magic(ctx, cube, "cube_magic");  // same signature, different slot
+	dukglue_register_function_magic(ctx, test_two_args, "test_two_args_magic");
+	test_eval_expect(ctx, "square_magic(5)", 25);
+	test_eval_expect(ctx, "cube_magic(3)", 27);
+	test_eval(ctx, "test_two_args_magic(2, 'butts');");
+	duk_pop(ctx);
+	test_eval_expect_error(ctx, "square_magic('potato')");
+	test_eval_expect_error(ctx, "test_two_args_magic('butts', 2);");
+
+	// re-registering reuses the existing slot
+	dukglue_register_function_magic(ctx, square, "square_magic_again");
+	test_eval_expect(ctx, "square_magic_again(6)", 36);
+
+	// compile-time registration
+	dukglue_register_function_compiletime<decltype(square), square>(ctx, square, "square_compiletime");
+	test_eval_expect(ctx, "square_compiletime(7)", 49);
+
 	dukglue_register_function(ctx, get_const_c_string, "get_const_c_string");
 	test_eval_expect(ctx, "get_const_c_string()", "butts_const");
 
@@ -109,6 +338,24 @@ void test_primitives() {
 	dukglue_register_function(ctx, get_const_ref_cpp_string, "get_const_ref_cpp_string");
 	test_eval_expect(ctx, "get_const_ref_cpp_string()", "potato_const_ref");
 
+	// strings with embedded NULs survive the round-trip
+	dukglue_register_function(ctx, string_view_length, "string_view_length");
+	dukglue_register_function(ctx, string_view_echo, "string_view_echo");
+	dukglue_register_function(ctx, get_string_view, "get_string_view");
+	test_eval_expect(ctx, "string_view_length('abc')", 3);
+	test_eval_expect(ctx, "string_view_length('a\\u0000b')", 3);
+	test_eval_expect(ctx, "string_view_echo('a\\u0000b') === 'a\\u0000b' ? 1 : 0", 1);
+	test_eval_expect(ctx, "get_string_view()", "potato_view");
+	test_eval_expect_error(ctx, "string_view_length(42)");
+
+#ifdef DUKGLUE_HAS_CXX17
+	dukglue_register_function(ctx, std_string_view_length, "std_string_view_length");
+	dukglue_register_function(ctx, get_std_string_view, "get_std_string_view");
+	test_eval_expect(ctx, "std_string_view_length('a\\u0000bc')", 4);
+	test_eval_expect(ctx, "get_std_string_view()", "potato_std_view");
+	test_eval_expect_error(ctx, "std_string_view_length({})");
+#endif
+
 	// this shouldn't compile and give a sane error message ("Value types can only be returned as const references.")
 	//dukglue_register_function(ctx, get_ref_cpp_string, "get_ref_cpp_string");
 
@@ -130,6 +377,322 @@ void test_primitives() {
 		test_assert(nums.at(2) == 3);
 	}
 
+	// numeric vectors are pushed as TypedArrays, and read from TypedArrays or plain arrays
+	{
+		dukglue_register_function(ctx, sum_floats, "sum_floats");
+		dukglue_register_function(ctx, get_floats, "get_floats");
+		dukglue_register_function(ctx, get_int64s, "get_int64s");
+		dukglue_register_function(ctx, get_bools, "get_bools");
+
+		test_eval_expect(ctx, "get_floats() instanceof Float32Array ? 1 : 0", 1);
+		test_eval_expect(ctx, "get_floats()[1] === 1.5 ? 1 : 0", 1);
+		test_eval_expect(ctx, "get_floats().length", 3);
+		test_eval_expect(ctx, "sum_floats(get_floats())", 4);
+		test_eval_expect(ctx, "sum_floats(new Float32Array([1, 2, 3, 4]).subarray(1, 3))", 5);
+		test_eval_expect(ctx, "sum_floats(new Int32Array([1, 2, 3]))", 6);  // converted element by element
+		// the element type comes from the object's real class, not its prototype or the global constructors
+		test_eval_expect(ctx, "sum_floats(Object.setPrototypeOf(new Int32Array([1, 2, 3]), Float32Array.prototype))", 6);
+		test_eval_expect(ctx, "var RealFloat32Array = Float32Array; Float32Array = Int32Array; var sum = sum_floats(new Int32Array([1, 2])); Float32Array = RealFloat32Array; sum", 3);
+		test_eval_expect(ctx, "var realToString = Object.prototype.toString; Object.prototype.toString = function() { return '[object Float32Array]'; };"
+			"var sum = sum_floats(new Int32Array([1, 2])); Object.prototype.toString = realToString; sum", 3);
+		test_eval_expect(ctx, "sum_floats([1, 2, 3])", 6);
+		test_eval_expect(ctx, "sum_floats(new Float32Array(0))", 0);
+		test_eval_expect_error(ctx, "sum_floats('abc')");
+		test_eval_expect_error(ctx, "sum_floats({ length: 2 })");
+
+		// no TypedArray for these
+		test_eval_expect(ctx, "Array.isArray(get_int64s()) ? 1 : 0", 1);
+		test_eval_expect(ctx, "Array.isArray(get_bools()) ? 1 : 0", 1);
+
+		std::vector<uint8_t> bytes = { 1, 200, 3 };
+		dukglue_push(ctx, bytes);
+		test_assert(duk_is_buffer_data(ctx, -1));
+		bytes.clear();
+		dukglue_read(ctx, -1, &bytes);
+		duk_pop(ctx);
+		test_assert(bytes.size() == 3 && bytes[1] == 200);
+
+		std::vector<double> empty;
+		dukglue_push(ctx, empty);
+		empty.push_back(1);
+		dukglue_read(ctx, -1, &empty);
+		duk_pop(ctx);
+		test_assert(empty.empty());
+	}
+
+	// dukglue_read_into refills existing containers without giving up their storage
+	{
+		std::vector<float> floats;
+		test_eval(ctx, "new Float32Array([1, 2, 3, 4])");
+		dukglue_read_into(ctx, -1, floats);
+		duk_pop(ctx);
+		test_assert(floats.size() == 4 && floats[3] == 4);
+
+		const float* floats_data = floats.data();
+		test_eval(ctx, "[5, 6]");
+		dukglue_read_into(ctx, -1, floats);
+		duk_pop(ctx);
+		test_assert(floats.size() == 2 && floats[0] == 5 && floats[1] == 6);
+		test_assert(floats.data() == floats_data && floats.capacity() >= 4);
+
+		std::vector<std::string> names;
+		test_eval(ctx, "['a fairly long name that needs the heap', 'b', 'c']");
+		dukglue_read_into(ctx, -1, names);
+		duk_pop(ctx);
+		const char* name_data = names[0].data();
+		test_eval(ctx, "['another long name, still on the heap', 'd']");
+		dukglue_read_into(ctx, -1, names);
+		duk_pop(ctx);
+		test_assert(names.size() == 2 && names[0] == "another long name, still on the heap" && names[1] == "d");
+		test_assert(names[0].data() == name_data);
+
+		std::vector<bool> flags = { false, false, false };
+		test_eval(ctx, "[true, false]");
+		dukglue_read_into(ctx, -1, flags);
+		duk_pop(ctx);
+		test_assert(flags.size() == 2 && flags[0] && !flags[1]);
+
+		std::map<std::string, std::vector<int> > scores;
+		test_eval(ctx, "({ alice: [1, 2, 3], bob: [4] })");
+		dukglue_read_into(ctx, -1, scores);
+		duk_pop(ctx);
+		const int* alice_data = scores["alice"].data();
+		test_eval(ctx, "({ bob: [5, 6], alice: [7] })");
+		dukglue_read_into(ctx, -1, scores);
+		duk_pop(ctx);
+		test_assert(scores.size() == 2 && scores["alice"].size() == 1 && scores["alice"][0] == 7 && scores["bob"][1] == 6);
+		test_assert(scores["alice"].data() == alice_data);
+
+		// removed keys are removed from the map too
+		test_eval(ctx, "({ carol: [] })");
+		dukglue_read_into(ctx, -1, scores);
+		duk_pop(ctx);
+		test_assert(scores.size() == 1 && scores.count("carol") == 1);
+
+		// reading below the top of the stack
+		test_eval(ctx, "({ dave: [8] })");
+		duk_push_int(ctx, 0);
+		dukglue_read_into(ctx, -2, scores);
+		duk_pop_2(ctx);
+		test_assert(scores.size() == 1 && scores["dave"][0] == 8);
+
+		std::string str = "old";
+		duk_push_string(ctx, "new");
+		dukglue_read_into(ctx, -1, str);
+		duk_pop(ctx);
+		test_assert(str == "new");
+
+		int num = 0;
+		duk_push_int(ctx, 42);
+		dukglue_read_into(ctx, -1, num);
+		duk_pop(ctx);
+		test_assert(num == 42);
+	}
+
+	// ...and so do native functions taking them by non-const reference
+	{
+		gScratchCtx = ctx;
+		dukglue_register_function(ctx, sum_scratch, "sum_scratch");
+		dukglue_register_function(ctx, sum_reentrant, "sum_reentrant");
+		dukglue_register_function(ctx, join_keys, "join_keys");
+
+		test_eval_expect(ctx, "var scratch = [1, 2, 3, 4, 5, 6, 7, 8]; sum_scratch(scratch)", 36);
+		const int* scratch_data = gScratchData;
+		test_eval_expect(ctx, "sum_scratch([9, 10])", 19);
+		test_assert(gScratchData == scratch_data);
+		test_eval_expect(ctx, "scratch.length", 8);
+		test_eval_expect_error(ctx, "sum_scratch('nope')");
+
+		// a recursive call doesn't clobber the outer call's argument
+		test_eval_expect(ctx, "sum_reentrant([1, 2], true)", 3);
+
+		test_eval_expect(ctx, "join_keys({ b: 2, a: 1 }, ', ')", "a, b");
+		gScratchCtx = nullptr;
+	}
+
+	// more containers
+	{
+		dukglue_register_function(ctx, get_ages, "get_ages");
+		dukglue_register_function(ctx, sum_ages, "sum_ages");
+		dukglue_register_function(ctx, invert_ages, "invert_ages");
+		dukglue_register_function(ctx, sum_ids, "sum_ids");
+		dukglue_register_function(ctx, cross, "cross");
+		dukglue_register_function(ctx, swap_pair, "swap_pair");
+		dukglue_register_function(ctx, describe_tuple, "describe_tuple");
+
+		test_eval_expect(ctx, "var ages = get_ages(); ages.alice + ages.bob", 73);
+		test_eval_expect(ctx, "sum_ages({ carol: 5, dave: 6 })", 11);
+		test_eval_expect(ctx, "invert_ages(get_ages())[42]", "bob");
+		test_eval_expect(ctx, "sum_ids({ 2: 10, '-3': 1 })", 17);
+		test_eval_expect_error(ctx, "sum_ids({ 'x': 1 })");
+		test_eval_expect_error(ctx, "sum_ids({ 1.5: 1 })");
+
+		// keys that aren't canonical integers, or don't fit, are rejected instead of colliding
+		dukglue_register_function(ctx, count_byte_keys, "count_byte_keys");
+		test_eval_expect(ctx, "count_byte_keys({ 0: 1, 255: 2 })", 2);
+		test_eval_expect_error(ctx, "count_byte_keys({ '300': 1 })");
+		test_eval_expect_error(ctx, "count_byte_keys({ '-1': 1 })");
+		test_eval_expect_error(ctx, "count_byte_keys({ '': 1 })");
+		test_eval_expect_error(ctx, "count_byte_keys({ '1e20': 1 })");
+		test_eval_expect_error(ctx, "count_byte_keys({ '01': 1 })");
+		test_eval_expect_error(ctx, "count_byte_keys({ 'Infinity': 1 })");
+		test_eval_expect_error(ctx, "count_byte_keys({ '-0': 1 })");
+		test_eval_expect(ctx, "sum_ids({ '2147483647': 0, '-2147483648': 0 })", 0);
+		test_eval_expect_error(ctx, "sum_ids({ '2147483648': 1 })");
+		test_eval_expect_error(ctx, "sum_ids({ '-2147483649': 1 })");
+
+		test_eval_expect(ctx, "cross([1, 0, 0], [0, 1, 0]).join(',')", "0,0,1");
+		test_eval_expect(ctx, "cross(new Float32Array([0, 1, 0]), [0, 0, 1]).join(',')", "1,0,0");
+		test_eval_expect(ctx, "cross(Object.setPrototypeOf(new Int32Array([0, 1, 0]), Float32Array.prototype), [0, 0, 1]).join(',')", "1,0,0");
+		test_eval_expect(ctx, "Array.isArray(cross([1, 0, 0], [0, 1, 0])) ? 1 : 0", 1);
+		test_eval_expect_error(ctx, "cross([1, 0], [0, 1, 0])");
+		test_eval_expect_error(ctx, "cross(new Float32Array(4), [0, 1, 0])");
+
+		test_eval_expect(ctx, "swap_pair([1, 'one']).join(',')", "one,1");
+		test_eval_expect_error(ctx, "swap_pair(['one', 1])");
+		test_eval_expect_error(ctx, "swap_pair([1])");
+		test_eval_expect(ctx, "describe_tuple([2, 'hi', false]).join(',')", "4,hi!,true");
+		test_eval_expect_error(ctx, "describe_tuple([2, 'hi', false, 4])");
+
+#ifdef DUKGLUE_HAS_CXX17
+		dukglue_register_function(ctx, describe_optional, "describe_optional");
+		test_eval_expect(ctx, "describe_optional(3)", "3");
+		test_eval_expect(ctx, "describe_optional(undefined)", "none");
+		test_eval_expect(ctx, "describe_optional(null)", "none");
+		test_eval_expect_error(ctx, "describe_optional('3')");
+
+		dukglue_register_function(ctx, describe_variant, "describe_variant");
+		dukglue_register_function(ctx, make_variant, "make_variant");
+		test_eval_expect(ctx, "describe_variant(5)", "int 5");
+		test_eval_expect(ctx, "describe_variant('abc')", "string abc");
+		test_eval_expect(ctx, "describe_variant([1, 2, 3])", "vector of 3");
+		test_eval_expect(ctx, "describe_variant(null)", "empty");
+		test_eval_expect(ctx, "describe_variant(undefined)", "empty");
+		test_eval_expect_error(ctx, "describe_variant(true)");
+		test_eval_expect(ctx, "make_variant(false)", 7);
+		test_eval_expect(ctx, "make_variant(true)", "text");
+#endif
+	}
+
+	// DUKGLUE_STRUCT types are read from and pushed as plain objects
+	{
+		dukglue_register_function(ctx, add_vec2, "add_vec2");
+		dukglue_register_function(ctx, move_waypoint, "move_waypoint");
+
+		test_eval_expect(ctx, "var v = add_vec2({ x: 1, y: 2 }, { x: 0.5, y: 0.5, z: 9 }); v.x * 10 + v.y", 17);
+		test_eval_expect(ctx, "Object.keys(v).join(',')", "x,y");
+		test_eval_expect_error(ctx, "add_vec2({ x: 1 }, { x: 0, y: 0 })");
+		test_eval_expect_error(ctx, "add_vec2(1, { x: 0, y: 0 })");
+
+		test_eval_expect(ctx, "var wp = move_waypoint({ name: 'home', pos: { x: 1, y: 1 }, tags: [5] }, { x: 2, y: 3 });"
+			"wp.name + ' ' + wp.pos.x + ',' + wp.pos.y + ' ' + wp.tags[0] + '/' + wp.tags[1]", "home' 3,4 5/1");
+
+		Vec2 v = { 0, 0 };
+		test_eval(ctx, "({ x: 4, y: 5 })");
+		dukglue_read(ctx, -1, &v);
+		duk_pop(ctx);
+		test_assert(v.x == 4 && v.y == 5);
+
+		std::vector<Vec2> path = { { 1, 2 }, { 3, 4 } };
+		dukglue_push(ctx, path);
+		duk_put_global_string(ctx, "path");
+		test_eval_expect(ctx, "path[1].x + path[1].y", 7);
+
+		// names are interned per heap
+		duk_context* ctx2 = duk_create_heap_default();
+		dukglue_push(ctx2, Vec2{ 6, 7 });
+		duk_put_global_string(ctx2, "v2");
+		test_eval_expect(ctx2, "v2.x + v2.y", 13);
+		duk_destroy_heap(ctx2);
+		test_eval_expect(ctx, "add_vec2(v, v).y", 5);
+	}
+
+	// DukSpan arguments view script buffers in place
+	{
+		dukglue_register_function(ctx, brighten, "brighten");
+		dukglue_register_function(ctx, sum_float_span, "sum_float_span");
+
+		test_eval_expect(ctx, "var px = new Uint8Array([1, 2, 250]); brighten(px, 10); px[0] + ',' + px[1] + ',' + px[2]", "11,12,4");
+		test_eval_expect(ctx, "var ab = new ArrayBuffer(2); brighten(ab, 3); new Uint8Array(ab)[1]", 3);
+		test_eval_expect(ctx, "var dv = new Uint8Array([5, 6, 7]).subarray(1); brighten(dv, 1); dv[0] * 10 + dv[1]", 78);
+		test_eval_expect(ctx, "sum_float_span(new Float32Array([0.5, 1.5]))", 2);
+		test_eval_expect_error(ctx, "sum_float_span(new Int32Array(2))");
+		test_eval_expect_error(ctx, "sum_float_span(Object.setPrototypeOf(new Int32Array(2), Float32Array.prototype))");
+
+		// a float view of memory that isn't aligned for float
+		static float backing[3] = { 0, 0, 0 };
+		duk_push_external_buffer(ctx);
+		duk_config_buffer(ctx, -1, reinterpret_cast<char*>(backing) + 1, 8);
+		duk_put_global_string(ctx, "unalignedBuf");
+		test_eval_expect(ctx, "new Float32Array(unalignedBuf.buffer).length", 2);
+		test_eval_expect_error(ctx, "sum_float_span(new Float32Array(unalignedBuf.buffer))");
+		test_eval_expect(ctx, "sum_floats(new Float32Array(unalignedBuf.buffer))", 0);  // copied, so alignment doesn't matter
+		test_eval_expect_error(ctx, "brighten([1, 2], 1)");
+
+		// plain buffer
+		unsigned char* plain = static_cast<unsigned char*>(duk_push_fixed_buffer(ctx, 1));
+		duk_put_global_string(ctx, "plainBuf");
+		test_eval(ctx, "brighten(plainBuf, 7)");
+		duk_pop(ctx);
+		test_assert(plain[0] == 7);
+
+		// pushed as a copy
+		float floats[] = { 1.0f, 2.0f };
+		dukglue_push(ctx, DukSpan<float>(floats, 2));
+		floats[0] = 100.0f;
+		test_assert(duk_get_length(ctx, -1) == 2);
+		duk_get_prop_index(ctx, -1, 0);
+		test_assert(duk_get_number(ctx, -1) == 1.0);
+		duk_pop_2(ctx);
+	}
+
+	// DukSharedBuffer return values share native memory, kept alive by the owner
+	{
+		dukglue_register_function(ctx, get_samples, "get_samples");
+		dukglue_register_function(ctx, take_shared, "take_shared");
+
+		test_eval_expect(ctx, "var samples = get_samples(); samples instanceof Float32Array ? samples.length : -1", 4);
+		test_assert(gOwnerAlive == 1);
+		test_eval_expect(ctx, "samples[0] = 2; (samples[0] + samples[1]) * 4", 9);
+
+		// round trip: same memory, shared owner
+		test_eval_expect(ctx, "take_shared(samples)", 4);
+		test_assert(gLastSharedUses == 2);
+		test_assert(gLastSharedData != nullptr && gLastSharedData[0] == 2.0f);
+
+		// other buffers are copied
+		test_eval_expect(ctx, "take_shared([1, 2, 3])", 3);
+		test_assert(gLastSharedUses == 1);
+
+		test_eval(ctx, "samples = undefined");
+		duk_pop(ctx);
+		duk_gc(ctx, 0);
+		test_assert(gOwnerAlive == 0);
+
+		// the owner's properties only count on a buffer that shares its memory
+		test_eval_expect(ctx, "var fakeSamples = Object.setPrototypeOf(new Float32Array(2), get_samples()); take_shared(fakeSamples)", 2);
+		test_assert(gLastSharedUses == 1);
+		test_eval(ctx, "fakeSamples = undefined");
+		duk_pop(ctx);
+		duk_gc(ctx, 0);
+		test_assert(gOwnerAlive == 0);
+
+		// views made from it don't keep the owner alive, and are detached from the memory when it goes
+		test_eval(ctx, "var samples = get_samples(); var samplesBuffer = samples.buffer; var samplesSub = samples.subarray(1); var samplesPlain = Uint8Array.plainOf(samples); samples = undefined;");
+		duk_pop(ctx);
+		duk_gc(ctx, 0);
+		test_assert(gOwnerAlive == 0);
+		test_eval_expect(ctx, "var view = new Uint8Array(samplesBuffer); view[3] = 42; view[3]", 0);
+		test_eval_expect(ctx, "samplesSub[0] = 1; samplesSub[0]", 0);
+		test_eval_expect(ctx, "samplesPlain.length", 0);
+		test_eval_expect(ctx, "take_shared(samplesSub)", 0);
+
+		// const memory is copied, script can't write to it
+		dukglue_register_function(ctx, get_const_samples, "get_const_samples");
+		test_eval_expect(ctx, "var constSamples = get_const_samples(); constSamples[0] = 5; constSamples[0] + constSamples[1]", 7);
+		test_assert(gConstSamples[0] == 1.0f);
+	}
+
 	// std::shared_ptr
 	{
 		test_assert(DogPrimitive::count() == 0);
@@ -22,6 +22,49 @@ private:
 	int mValue;
 };
 
+class SharedProps {
+public:
+	SharedProps() : mA(1), mB(2), mName("shared") {}
+	virtual ~SharedProps() {}
+
+	int getA() const { return mA; }
+	void setA(int v) { mA = v; }
+	int getB() const { return mB; }
+	void setB(int v) { mB = v; }
+	int getSum() { return mA + mB; }
+	std::string getName() const { return mName; }
+	void setName(std::string name) { mName = name; }
+
+private:
+	int mA, mB;
+	std::string mName;
+};
+
+class SharedPropsDerived : public SharedProps {
+};
+
+struct FieldVec {
+	FieldVec() : x(0), y(0) {}
+	float x;
+	float y;
+};
+
+struct FieldEntity {
+	FieldEntity() : position(), id(7), hp(100), name("entity"), label("label"), target(nullptr) { alive++; }
+	~FieldEntity() { alive--; }
+
+	static int alive;
+
+	FieldVec position;  // at offset 0, like its parent
+	const int id;
+	int hp;
+	std::string name;
+	const char* label;
+	FieldEntity* target;
+};
+
+int FieldEntity::alive = 0;
+
 void test_properties()
 {
 	duk_context* ctx = duk_create_heap_default();
@@ -60,6 +103,142 @@ void test_properties()
 	test_eval_expect_error(ctx, "test.value = 256");
 	test_eval_expect(ctx, "test.value", 64);
 
+	// shared accessors
+	dukglue_register_constructor<SharedProps>(ctx, "SharedProps");
+	dukglue_register_property_shared(ctx, &SharedProps::getA, &SharedProps::setA, "a");
+	dukglue_register_property_shared(ctx, &SharedProps::getB, &SharedProps::setB, "b");
+	dukglue_register_property_shared(ctx, &SharedProps::getSum, nullptr, "sum");
+	dukglue_register_property_shared(ctx, &SharedProps::getName, &SharedProps::setName, "name");
+	dukglue_register_property_shared(ctx, nullptr, &SharedProps::setA, "onlyA");
+
+	SharedProps shared;
+	dukglue_register_global(ctx, &shared, "shared");
+
+	test_eval_expect(ctx, "shared.a", 1);
+	test_eval_expect(ctx, "shared.b", 2);
+	test_eval(ctx, "shared.a = 10; shared.b = 20");
+	duk_pop(ctx);
+	test_assert(shared.getA() == 10 && shared.getB() == 20);
+	test_eval_expect(ctx, "shared.sum", 30);
+	test_eval_expect_error(ctx, "shared.sum = 5");
+	test_eval_expect(ctx, "shared.name", "shared");
+	test_eval(ctx, "shared.name = 'renamed'");
+	duk_pop(ctx);
+	test_assert(shared.getName() == "renamed");
+	test_eval(ctx, "shared.onlyA = 11");
+	duk_pop(ctx);
+	test_assert(shared.getA() == 11);
+	test_eval_expect_error(ctx, "shared.onlyA");
+	test_eval_expect_error(ctx, "shared.a = 'food'");
+
+	test_eval(ctx, "var proto = Object.getPrototypeOf(shared)");
+	duk_pop(ctx);
+
+#ifdef DUKGLUE_SHARED_ACCESSORS
+	// properties with the same signature really do share their functions
+	test_eval_expect(ctx, "Object.getOwnPropertyDescriptor(proto, 'a').get === Object.getOwnPropertyDescriptor(proto, 'b').get ? 1 : 0", 1);
+#endif
+
+	// re-defining a shared property
+	dukglue_register_property_shared(ctx, &SharedProps::getB, &SharedProps::setB, "a");
+	test_eval_expect(ctx, "shared.a", 20);
+
+	// inherited shared properties
+	dukglue_set_base_class<SharedProps, SharedPropsDerived>(ctx);
+	SharedPropsDerived derived;
+	dukglue_register_global(ctx, &derived, "derived");
+	test_eval(ctx, "derived.b = 5");
+	duk_pop(ctx);
+	test_assert(derived.getB() == 5);
+	test_eval_expect(ctx, "derived.a + derived.sum", 5 + 6);
+
+	// not a SharedProps
+	test_eval_expect_error(ctx, "Object.getOwnPropertyDescriptor(proto, 'b').get.call(test)");
+
+	dukglue_invalidate_object(ctx, &shared);
+	dukglue_invalidate_object(ctx, &derived);
+
+	// data members
+	dukglue_register_constructor_managed<FieldVec>(ctx, "FieldVec");
+	dukglue_register_field(ctx, &FieldVec::x, "x");
+	dukglue_register_field_compiletime<decltype(&FieldVec::y), &FieldVec::y>(ctx, "y");
+
+	FieldEntity entity;
+	dukglue_register_field(ctx, &FieldEntity::position, "position");
+	dukglue_register_field(ctx, &FieldEntity::id, "id");  // const, so read-only
+	dukglue_register_field(ctx, &FieldEntity::hp, "hp");
+	dukglue_register_field_readonly_compiletime<decltype(&FieldEntity::name), &FieldEntity::name>(ctx, "name");
+	dukglue_register_field_readonly(ctx, &FieldEntity::label, "label");
+	dukglue_register_field(ctx, &FieldEntity::target, "target");
+	dukglue_register_global(ctx, &entity, "entity");
+
+	test_eval_expect(ctx, "entity.id", 7);
+	test_eval_expect_error(ctx, "entity.id = 8");
+	test_assert(entity.id == 7);
+
+	test_eval(ctx, "entity.hp -= 25");
+	duk_pop(ctx);
+	test_assert(entity.hp == 75);
+	test_eval_expect(ctx, "entity.hp", 75);
+	test_eval_expect_error(ctx, "entity.hp = 'lots'");
+	test_assert(entity.hp == 75);
+
+	test_eval_expect(ctx, "entity.name", "entity");
+	test_eval_expect_error(ctx, "entity.name = 'other'");
+	test_eval_expect(ctx, "entity.label", "label");
+	test_eval_expect_error(ctx, "entity.label = 'other'");
+
+	// pointers to native objects
+	test_eval_expect(ctx, "entity.target === null ? 1 : 0", 1);
+	test_eval(ctx, "entity.target = entity");
+	duk_pop(ctx);
+	test_assert(entity.target == &entity);
+	test_eval_expect(ctx, "entity.target === entity ? 1 : 0", 1);
+	test_eval(ctx, "entity.target = null");
+	duk_pop(ctx);
+	test_assert(entity.target == nullptr);
+
+	// embedded native objects are modified in place
+	test_eval(ctx, "entity.position.x = 3; entity.position.y = 4");
+	duk_pop(ctx);
+	test_assert(entity.position.x == 3 && entity.position.y == 4);
+	test_eval_expect(ctx, "entity.position.x + entity.position.y", 7);
+
+	// ...and assigned by copy
+	test_eval(ctx, "var v = new FieldVec(); v.x = 10; entity.position = v; v.x = 11");
+	duk_pop(ctx);
+	test_assert(entity.position.x == 10 && entity.position.y == 0);
+	test_eval_expect_error(ctx, "entity.position = 5");
+
+	// an embedded field keeps a script-owned parent alive
+	dukglue_register_constructor_managed<FieldEntity>(ctx, "FieldEntity");
+	test_eval_expect(ctx, "var pos = new FieldEntity().position; Duktape.gc(); pos.x = 5; pos.x", 5);
+	test_assert(FieldEntity::alive == 2);
+	test_eval(ctx, "pos = undefined");
+	duk_pop(ctx);
+	duk_gc(ctx, 0);
+	test_assert(FieldEntity::alive == 1);
+
+	// fields can't be read from objects of the wrong type
+	test_eval_expect_error(ctx, "Object.getOwnPropertyDescriptor(Object.getPrototypeOf(entity), 'hp').get.call(v)");
+
+	// an embedded field can't be used once its parent is deleted...
+	dukglue_register_delete<FieldEntity>(ctx);
+	test_eval(ctx, "var e = new FieldEntity(); pos = e.position; e.delete()");
+	duk_pop(ctx);
+	test_assert(FieldEntity::alive == 1);
+	test_eval_expect_error(ctx, "pos.x = 5");
+	test_eval_expect_error(ctx, "pos.x");
+	test_eval_expect_error(ctx, "entity.position = pos");
+
+	// ...or invalidated
+	test_eval(ctx, "pos = entity.position");
+	duk_pop(ctx);
+	test_eval_expect(ctx, "pos.x", 10);
+	dukglue_invalidate_object(ctx, &entity);
+	test_eval_expect_error(ctx, "pos.x = 5");
+	test_assert(entity.position.x == 10);
+
 	test_assert(duk_get_top(ctx) == 0);
 	duk_destroy_heap(ctx);
 
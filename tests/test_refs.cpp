@@ -0,0 +1,421 @@
+#include "test_assert.h"
+#include <dukglue/dukglue.h>
+
+#include <iostream>
+#include <vector>
+
+// native object registry (detail_refs.h)
+
+class Plain {
+public:
+	Plain() : value_(1) {}
+	int value() const { return value_; }
+
+private:
+	int value_;
+};
+
+static int plain_value(Plain* plain)
+{
+	return plain->value();
+}
+
+class Hooked : public DukRefHook {
+public:
+	Hooked() : value_(2) {}
+	int value() const { return value_; }
+
+private:
+	int value_;
+};
+
+class Transient {
+public:
+	Transient() : value_(3) {}
+	int value() const { return value_; }
+
+private:
+	int value_;
+};
+
+class HookedTransient : public DukRefHook {
+public:
+	int value() const { return 4; }
+};
+
+class Shape {
+public:
+	virtual ~Shape() {}
+	int sides() const { return 0; }
+};
+
+class Square : public Shape {
+};
+
+static bool same_object(duk_context* ctx, duk_idx_t a, duk_idx_t b)
+{
+	return duk_strict_equals(ctx, a, b) != 0;
+}
+
+template <typename T>
+static void test_identity_and_invalidation(duk_context* ctx)
+{
+	T objs[3];
+
+	// pushing the same object twice gives the same script object
+	dukglue_push(ctx, &objs[0]);
+	dukglue_push(ctx, &objs[0]);
+	test_assert(same_object(ctx, -1, -2));
+	dukglue_push(ctx, &objs[1]);
+	test_assert(!same_object(ctx, -1, -2));
+	duk_pop_3(ctx);
+
+	// invalidate through a typed pointer
+	dukglue_push(ctx, &objs[0]);
+	duk_put_global_string(ctx, "first");
+	test_eval_expect(ctx, "first.value()", objs[0].value());
+
+	dukglue_invalidate_object(ctx, &objs[0]);
+	test_eval_expect_error(ctx, "first.value()");
+
+	// pushing it again after invalidation gives a new script object (in the freed slot)
+	dukglue_push(ctx, &objs[2]);
+	dukglue_push(ctx, &objs[0]);
+	duk_get_global_string(ctx, "first");
+	test_assert(!same_object(ctx, -1, -2));
+	duk_pop(ctx);
+	dukglue_push(ctx, &objs[0]);
+	test_assert(same_object(ctx, -1, -2));
+	duk_pop_3(ctx);
+
+	// invalidate through a void*
+	dukglue_push(ctx, &objs[0]);
+	duk_put_global_string(ctx, "again");
+	dukglue_invalidate_object(ctx, static_cast<void*>(&objs[0]));
+	test_eval_expect_error(ctx, "again.value()");
+
+	dukglue_invalidate_object(ctx, &objs[1]);
+	dukglue_invalidate_object(ctx, &objs[2]);
+
+	// invalidating something that was never registered does nothing
+	dukglue_invalidate_object(ctx, &objs[1]);
+}
+
+static size_t live_refs(duk_context* ctx)
+{
+	return dukglue::detail::ContextState::get(ctx)->refs.size();
+}
+
+// dukglue_set_weak_refs
+template <typename T>
+static void test_weak_refs(duk_context* ctx)
+{
+	dukglue_register_method(ctx, &T::value, "value");
+	dukglue_set_weak_refs<T>(ctx);
+
+	const size_t refs_before = live_refs(ctx);
+	T obj;
+
+	// identity is kept while script references the object
+	dukglue_push(ctx, &obj);
+	duk_put_global_string(ctx, "weak");
+	test_eval(ctx, "weak.tag = 'first';");
+	duk_pop(ctx);
+	dukglue_push(ctx, &obj);
+	duk_get_global_string(ctx, "weak");
+	test_assert(same_object(ctx, -1, -2));
+	duk_pop_2(ctx);
+	duk_gc(ctx, 0);
+	test_eval_expect(ctx, "weak.tag", "first");
+	test_assert(live_refs(ctx) == refs_before + 1);
+
+	// once it's unreachable, it is collected and the next push makes a new one
+	test_eval(ctx, "weak = undefined;");
+	duk_pop(ctx);
+	duk_gc(ctx, 0);
+	test_assert(live_refs(ctx) == refs_before);
+
+	dukglue_push(ctx, &obj);
+	duk_put_global_string(ctx, "weak");
+	test_eval_expect(ctx, "weak.tag === undefined ? 1 : 0", 1);
+	test_eval_expect(ctx, "weak.value()", obj.value());
+
+	// invalidating still works, and the finalizer doesn't touch the freed slot afterwards
+	dukglue_invalidate_object(ctx, &obj);
+	test_eval_expect_error(ctx, "weak.value()");
+	T other;
+	dukglue_push(ctx, &other);
+	duk_put_global_string(ctx, "other");
+	test_eval(ctx, "weak = undefined;");
+	duk_pop(ctx);
+	duk_gc(ctx, 0);
+	dukglue_push(ctx, &other);
+	duk_get_global_string(ctx, "other");
+	test_assert(same_object(ctx, -1, -2));
+	duk_pop_2(ctx);
+	test_eval(ctx, "other = undefined;");
+	duk_pop(ctx);
+
+	// lots of transient objects don't grow the registry
+	{
+		std::vector<T> many(10000);
+		for (T& t : many) {
+			dukglue_push(ctx, &t);
+			duk_pop(ctx);
+		}
+		duk_gc(ctx, 0);
+		test_assert(live_refs(ctx) == refs_before);
+	}
+
+	// a cycle through a script property is collected by mark-and-sweep
+	dukglue_push(ctx, &obj);
+	duk_put_global_string(ctx, "weak");
+	test_eval(ctx, "weak.self = weak; weak = undefined;");
+	duk_pop(ctx);
+	duk_gc(ctx, 0);
+	duk_gc(ctx, 0);
+	test_assert(live_refs(ctx) == refs_before);
+
+	// a weak object still alive when the heap is destroyed is fine too
+	test_eval(ctx, "var keep = keep || [];");
+	duk_pop(ctx);
+	duk_get_global_string(ctx, "keep");
+	dukglue_push(ctx, &obj);
+	duk_put_prop_index(ctx, -2, static_cast<duk_uarridx_t>(duk_get_length(ctx, -2)));
+	duk_pop(ctx);
+	dukglue_invalidate_object(ctx, &obj);
+}
+
+// dukglue_invalidate_range/objects/class/epoch
+static void test_bulk_invalidation(duk_context* ctx)
+{
+	dukglue_register_method(ctx, &Shape::sides, "sides");
+	dukglue_set_base_class<Shape, Square>(ctx);
+
+	const size_t refs_before = live_refs(ctx);
+
+	// by range
+	{
+		Plain plains[10];
+		Hooked hooked[10];
+		for (int i = 0; i < 10; i++) {
+			dukglue_push(ctx, &plains[i]);
+			duk_pop(ctx);
+			dukglue_push(ctx, &hooked[i]);
+			duk_pop(ctx);
+		}
+		dukglue_push(ctx, &plains[5]);
+		duk_put_global_string(ctx, "p5");
+		dukglue_push(ctx, &plains[2]);
+		duk_put_global_string(ctx, "p2");
+
+		test_assert(dukglue_invalidate_range(ctx, &plains[3], &plains[10]) == 7);
+		test_eval_expect_error(ctx, "p5.value()");
+		test_eval_expect(ctx, "p2.value()", 1);
+		test_assert(dukglue_invalidate_objects(ctx, plains, 10) == 3);
+		test_eval_expect_error(ctx, "p2.value()");
+		test_assert(dukglue_invalidate_objects(ctx, plains, 10) == 0);
+
+		// hooked objects are re-registered properly afterwards
+		test_assert(dukglue_invalidate_objects(ctx, hooked, 10) == 10);
+		dukglue_push(ctx, &hooked[0]);
+		dukglue_push(ctx, &hooked[0]);
+		test_assert(same_object(ctx, -1, -2));
+		duk_pop_2(ctx);
+		dukglue_invalidate_object(ctx, &hooked[0]);
+		test_assert(live_refs(ctx) == refs_before);
+	}
+
+	// by class (including derived classes)
+	{
+		Shape shape;
+		Square square;
+		Plain plain;
+		dukglue_push(ctx, &shape);
+		duk_pop(ctx);
+		dukglue_push(ctx, static_cast<Shape*>(&square));
+		duk_put_global_string(ctx, "square");
+		dukglue_push(ctx, &plain);
+		duk_put_global_string(ctx, "plain");
+
+		test_eval_expect(ctx, "square.sides()", 0);
+		test_assert(dukglue_invalidate_class<Square>(ctx) == 1);
+		test_eval_expect_error(ctx, "square.sides()");
+
+		dukglue_push(ctx, &square);
+		duk_pop(ctx);
+		test_assert(dukglue_invalidate_class<Shape>(ctx) == 2);
+		test_eval_expect(ctx, "plain.value()", 1);
+		test_assert(dukglue_invalidate_class<Plain>(ctx) == 1);
+		test_assert(live_refs(ctx) == refs_before);
+	}
+
+	// by epoch
+	{
+		Plain plains[6];
+		test_assert(dukglue_get_epoch(ctx) == 0);
+		for (int i = 0; i < 6; i++) {
+			dukglue_set_epoch(ctx, (i < 4) ? 1 : 2);
+			dukglue_push(ctx, &plains[i]);
+			duk_pop(ctx);
+		}
+
+		// pushing again doesn't change the epoch
+		dukglue_set_epoch(ctx, 3);
+		dukglue_push(ctx, &plains[0]);
+		duk_put_global_string(ctx, "p0");
+
+		test_assert(dukglue_invalidate_epoch(ctx, 1) == 4);
+		test_eval_expect_error(ctx, "p0.value()");
+		test_assert(dukglue_invalidate_epoch(ctx, 1) == 0);
+		test_assert(dukglue_invalidate_epoch(ctx, 2) == 2);
+		test_assert(live_refs(ctx) == refs_before);
+		dukglue_set_epoch(ctx, 0);
+	}
+}
+
+// native headers (detail_native_header.h) are freed with their script objects
+static duk_context* gTeardownCtx = nullptr;
+static Plain gTeardownTarget;
+
+class TeardownGuard {
+public:
+	~TeardownGuard() {
+		// (runs while the heap is being destroyed, possibly after the target's finalizer)
+		dukglue_invalidate_object(gTeardownCtx, &gTeardownTarget);
+	}
+};
+
+static void test_native_headers()
+{
+	duk_context* ctx = duk_create_heap_default();
+	dukglue_register_method(ctx, &Plain::value, "value");
+	dukglue_register_constructor_managed<Plain>(ctx, "Plain");
+	dukglue::detail::ObjectPool* pool = dukglue::detail::ContextState::get(ctx)->object_pool();
+
+	// dropped wrappers give their headers back to the pool, and so do invalidated objects
+	std::vector<Plain> objects(10000);
+	size_t reserved = 0;
+	for (int round = 0; round < 2; round++) {
+		test_eval(ctx, "for (var i = 0; i < 10000; i++) new Plain();");
+		duk_pop(ctx);
+		for (Plain& obj : objects) {
+			dukglue_push(ctx, &obj);
+			duk_pop(ctx);
+		}
+		for (Plain& obj : objects)
+			dukglue_invalidate_object(ctx, &obj);
+		duk_gc(ctx, 0);
+
+		if (round == 0)
+			reserved = pool->reserved_bytes();
+		else
+			test_assert(pool->reserved_bytes() == reserved);
+	}
+
+	// invalidated objects are still recognized as such
+	Plain plain;
+	dukglue_push(ctx, &plain);
+	duk_put_global_string(ctx, "plain");
+	dukglue_invalidate_object(ctx, &plain);
+	test_eval_expect_error(ctx, "plain.value()");
+	dukglue_register_function(ctx, &plain_value, "plainValue");
+	test_eval_expect(ctx, "try { plainValue(plain); } catch (e) { e.message }", "Argument 0: invalid native object.");
+
+	// an object that inherits a finalizer and a header doesn't free them
+	test_eval(ctx, "var managed = new Plain(); (function() { var derived = Object.create(managed); derived.value(); })();");
+	duk_pop(ctx);
+	duk_gc(ctx, 0);
+	test_eval_expect(ctx, "managed.value()", 1);
+
+	// calling the finalizer from script frees the header, but leaves no dangling pointers
+	test_eval(ctx, "Duktape.fin(Object.getPrototypeOf(managed))(managed);");
+	duk_pop(ctx);
+	test_eval_expect_error(ctx, "managed.value()");
+
+	// registered objects that are still alive when the heap is destroyed get their headers freed then
+	Plain survivor;
+	dukglue_push(ctx, &survivor);
+	duk_pop(ctx);
+
+	// objects can be invalidated from finalizers while the heap is being destroyed
+	dukglue_register_constructor_managed<TeardownGuard>(ctx, "TeardownGuard");
+	gTeardownCtx = ctx;
+	dukglue_push(ctx, &gTeardownTarget);
+	duk_put_global_string(ctx, "target");
+	test_eval(ctx, "var guard = new TeardownGuard();");
+	duk_pop(ctx);
+
+	test_assert(duk_get_top(ctx) == 0);
+	duk_destroy_heap(ctx);
+	gTeardownCtx = nullptr;
+}
+
+void test_refs()
+{
+	duk_context* ctx = duk_create_heap_default();
+
+	dukglue_register_method(ctx, &Plain::value, "value");
+	dukglue_register_method(ctx, &Hooked::value, "value");
+
+	test_identity_and_invalidation<Plain>(ctx);
+	test_identity_and_invalidation<Hooked>(ctx);
+	test_bulk_invalidation(ctx);
+	test_native_headers();
+
+	// a hooked object pushed into a second context still works (through the hash map there)
+	{
+		duk_context* ctx2 = duk_create_heap_default();
+		dukglue_register_method(ctx2, &Hooked::value, "value");
+
+		Hooked obj;
+		dukglue_push(ctx, &obj);
+		dukglue_push(ctx2, &obj);
+		dukglue_push(ctx2, &obj);
+		test_assert(same_object(ctx2, -1, -2));
+		duk_pop_2(ctx2);
+
+		// a copy is a different object
+		Hooked copy(obj);
+		dukglue_push(ctx, &copy);
+		test_assert(!same_object(ctx, -1, -2));
+		duk_pop_2(ctx);
+
+		dukglue_invalidate_object(ctx2, &obj);
+		dukglue_push(ctx, &obj);
+		duk_put_global_string(ctx, "hooked");
+		test_eval_expect(ctx, "hooked.value()", 2);
+
+		dukglue_invalidate_object(ctx, &obj);
+		dukglue_invalidate_object(ctx, &copy);
+		test_eval_expect_error(ctx, "hooked.value()");
+
+		test_assert(duk_get_top(ctx2) == 0);
+		duk_destroy_heap(ctx2);
+	}
+
+	// weak refs
+	{
+		duk_context* ctx2 = duk_create_heap_default();
+		test_weak_refs<Transient>(ctx2);
+		test_weak_refs<HookedTransient>(ctx2);
+
+		// strongly registered objects are unaffected
+		Plain plain;
+		dukglue_register_method(ctx2, &Plain::value, "value");
+		const size_t refs_before = live_refs(ctx2);
+		dukglue_push(ctx2, &plain);
+		duk_pop(ctx2);
+		duk_gc(ctx2, 0);
+		test_assert(live_refs(ctx2) == refs_before + 1);
+		dukglue_invalidate_object(ctx2, &plain);
+
+		test_assert(duk_get_top(ctx2) == 0);
+		duk_destroy_heap(ctx2);
+	}
+
+	test_assert(duk_get_top(ctx) == 0);
+	duk_destroy_heap(ctx);
+
+	std::cout << "Refs tested OK" << std::endl;
+}